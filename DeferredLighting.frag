@@ -0,0 +1,194 @@
+#version 430 core
+
+// Deferred Lighting: The Directional Light of Terrain.frag, plus the Point Lights of this Tile.
+
+in vec2 UV;
+
+// Ouput data
+out vec3 color;
+
+#define TILE_SIZE 16
+#define MAX_LIGHTS_PER_TILE 256
+
+struct PointLight
+{
+	vec4 position_radius;
+	vec4 color_intensity;
+};
+
+layout(std430, binding = 0) readonly buffer LightBuffer
+{
+	PointLight lights[];
+};
+
+layout(std430, binding = 1) readonly buffer TileBuffer
+{
+	uint tileData[];
+};
+
+// G-Buffer
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;
+uniform sampler2D gSpecular;
+uniform sampler2D gDepth;
+
+uniform mat4 V;
+uniform mat4 invV;
+uniform mat4 invP;
+uniform vec3 LightPosition_worldspace;
+uniform vec3 ClearColor;
+uniform int tilesX;
+
+// Cascaded Shadow Map of the directional light
+uniform sampler2DArrayShadow ShadowMap;
+uniform mat4 ShadowMatrices[4];
+uniform vec4 CascadeSplits;
+uniform int ShadowsEnabled;
+
+// Atmosphere tables, see Sky.hpp
+uniform sampler2D SkyViewSampler;
+uniform sampler3D AerialPerspectiveSampler;
+uniform vec3 SunDirection;
+uniform float KmPerUnit;
+uniform float AerialDistance;
+uniform int AtmosphereEnabled;
+// Fade distance of the view, 0 for none
+uniform float FadeDistance;
+
+#define PI 3.14159265
+#define AERIAL_SLICES 32.0
+
+// Texture coordinates of a direction in the sky view table, as in Sky.frag
+vec2 skyViewUV(vec3 dir)
+{
+	float elevation = asin(clamp(dir.y, -1.0, 1.0));
+	float v = 0.5 - 0.5 * sign(elevation) * sqrt(abs(elevation) / (0.5 * PI));
+	vec2 h = dir.xz;
+	vec2 s = SunDirection.xz;
+	float cosAzimuth = (dot(h, h) > 1e-8 && dot(s, s) > 1e-8) ? dot(normalize(h), normalize(s)) : 1.0;
+	return vec2(acos(clamp(cosAzimuth, -1.0, 1.0)) / PI, v);
+}
+
+// Haze between the camera and the surface, then the sky where the surface reaches fadeDistance,
+// so the far plane and the level of detail changes out there do not show
+vec3 applyAtmosphere(vec3 surface, vec3 position_worldspace, vec3 camera_worldspace, float fadeDistance)
+{
+	if (AtmosphereEnabled == 0)
+		return surface;
+
+	vec3 toSurface = position_worldspace - camera_worldspace;
+	float distance = length(toSurface);
+	vec2 uv = skyViewUV(toSurface / max(distance, 1e-4));
+
+	// Slice i holds the haze up to the end of the slice: fade it in over the first one
+	float slice = distance * KmPerUnit / AerialDistance * AERIAL_SLICES;
+	vec4 aerial = texture(AerialPerspectiveSampler, vec3(uv, (slice - 0.5) / AERIAL_SLICES));
+	float near = clamp(slice, 0.0, 1.0);
+	vec3 result = surface * mix(1.0, aerial.a, near) + aerial.rgb * near;
+
+	if (fadeDistance > 0.0)
+		result = mix(result, texture(SkyViewSampler, uv).rgb, smoothstep(0.8 * fadeDistance, fadeDistance, distance));
+	return result;
+}
+
+// 1: lit, 0: in shadow
+float computeShadow(vec3 position_worldspace, float viewDepth)
+{
+	if (ShadowsEnabled == 0 || viewDepth > CascadeSplits[3])
+		return 1.0;
+
+	int cascade = 0;
+	while (cascade < 3 && viewDepth > CascadeSplits[cascade])
+		cascade++;
+
+	vec4 p = ShadowMatrices[cascade] * vec4(position_worldspace, 1.0);
+	vec3 coord = p.xyz / p.w * 0.5 + 0.5;
+	return texture(ShadowMap, vec4(coord.xy, float(cascade), coord.z - 0.0005));
+}
+
+vec3 decodeNormal(vec2 f)
+{
+	vec3 n = vec3(f.x, f.y, 1.0 - abs(f.x) - abs(f.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+void main()
+{
+	float depth = texture(gDepth, UV).r;
+	// The scene depth goes to the window too, for the forward passes after this one
+	gl_FragDepth = depth;
+	if (depth == 1.0)
+	{
+		color = ClearColor;
+		return;
+	}
+
+	vec4 clip = invP * vec4(UV * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+	vec3 Position_cameraspace = clip.xyz / clip.w;
+	vec3 Position_worldspace = (invV * vec4(Position_cameraspace, 1.0)).xyz;
+
+	vec4 albedo = texture(gAlbedo, UV);
+	// Unlit surfaces (flowers)
+	if (albedo.a == 0.0)
+	{
+		color = applyAtmosphere(albedo.rgb, Position_worldspace, invV[3].xyz, FadeDistance);
+		return;
+	}
+
+	vec3 MaterialDiffuseColor = albedo.rgb;
+	vec4 specularVisibility = texture(gSpecular, UV);
+	vec3 MaterialSpecularColor = specularVisibility.rgb;
+	vec3 n = decodeNormal(texture(gNormal, UV).rg);
+
+	// Directional light, exactly as Terrain.frag does it
+	vec3 LightColor = vec3(1,1,1);
+	float LightPower = 1.0;
+	float shininess = 1;
+
+	vec3 l = normalize(-(V * vec4(LightPosition_worldspace, 1)).xyz);
+	vec3 e = normalize(-Position_cameraspace);
+
+	float cosTheta = clamp( dot( n,l ), 0,1 );
+	vec3 diffuse = MaterialDiffuseColor * LightColor * LightPower * cosTheta;
+
+	vec3 B = normalize(l + e);
+	float cosB = clamp(dot(n,B),0,1);
+	cosB = clamp(pow(cosB,shininess),0,1);
+	cosB = cosB * cosTheta * (shininess+2)/(2*radians(180.0f));
+	vec3 specular = MaterialSpecularColor *LightPower*cosB;
+
+	float visibility = computeShadow(Position_worldspace, -Position_cameraspace.z);
+	diffuse *= visibility;
+	specular *= visibility;
+
+	// Ambient, darkened by the baked horizon visibility
+	color = vec3(0.2,0.2,0.2) * MaterialDiffuseColor * specularVisibility.a + diffuse + specular;
+
+	// Point lights of this tile, in world space (the terrain normal is a world space normal)
+	vec3 eye_worldspace = normalize(invV[3].xyz - Position_worldspace);
+	ivec2 tile = ivec2(gl_FragCoord.xy) / TILE_SIZE;
+	uint base = uint(tile.y * tilesX + tile.x) * uint(MAX_LIGHTS_PER_TILE + 1);
+	uint count = tileData[base];
+	for (uint i = 0u; i < count; i++)
+	{
+		PointLight light = lights[tileData[base + 1u + i]];
+		vec3 toLight = light.position_radius.xyz - Position_worldspace;
+		float distance = length(toLight);
+		if (distance >= light.position_radius.w)
+			continue;
+
+		// Smooth falloff to zero at the radius
+		float falloff = 1.0 - (distance * distance) / (light.position_radius.w * light.position_radius.w);
+		vec3 radiance = light.color_intensity.rgb * light.color_intensity.a * falloff * falloff;
+
+		vec3 pl = toLight / distance;
+		float pointCos = clamp(dot(n, pl), 0, 1);
+		float pointSpec = clamp(dot(n, normalize(pl + eye_worldspace)), 0, 1) * pointCos * (shininess+2)/(2*radians(180.0f));
+		color += radiance * (MaterialDiffuseColor * pointCos + MaterialSpecularColor * pointSpec);
+	}
+
+	color = applyAtmosphere(color, Position_worldspace, invV[3].xyz, FadeDistance);
+}
\ No newline at end of file
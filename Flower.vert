@@ -13,13 +13,25 @@ out VERT_DATA
 }vertOut;
 
 // Values that stay constant for the whole mesh.
-uniform mat4 MVP;
 uniform mat4 M;
 uniform mat3 MV3x3;
 uniform vec3 LightPosition_worldspace;
 
-uniform mat4 V;
-uniform mat4 P;
+// Cameras of every view of the frame, see Views.hpp
+struct ViewData
+{
+	mat4 V;
+	mat4 P;
+	mat4 VP;
+	vec4 CameraPosition;
+	vec4 Params;
+};
+layout(std140) uniform Views
+{
+	ViewData views[4];
+};
+uniform int ViewIndex;
+
 // Values that stay constant for the whole mesh.
 uniform sampler2D DiffuseTextureSampler;
 
@@ -40,7 +52,7 @@ void main()
 	float real_height = compute_height(heightRGB, y_scale, y_shift);
 
     // gl_Position = MVP * vec4(vertPosition_modelspace.x, real_height, vertPosition_modelspace.z, 1.0f); // Matrix transformations go here
-    vertOut.MVP_Position = MVP * vec4(vertPosition_modelspace.x, real_height, vertPosition_modelspace.z, 1.0f); 
+    vertOut.MVP_Position = views[ViewIndex].VP * vec4(vertPosition_modelspace.x, real_height, vertPosition_modelspace.z, 1.0f); 
     vertOut.heihgtRadio = vec2(0,0);
 
     float upheight = real_height - y_shift;
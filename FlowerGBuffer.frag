@@ -0,0 +1,22 @@
+#version 330 core
+in vec2 fragTexCoords;		// Simply Output UV coordinates for new triangles texture rendering
+in vec2 fragHeihgtRadio;
+
+// Values that stay constant for the whole mesh.
+uniform sampler2D DiffuseTextureSampler;
+
+// Ouput data: G-Buffer targets, see TerrainGBuffer.frag
+layout(location = 0) out vec4 gAlbedo;
+layout(location = 1) out vec2 gNormal;
+layout(location = 2) out vec4 gSpecular;
+
+void main()
+{
+    if(fragHeihgtRadio.x <= 0.1f)
+        discard;
+
+    // Billboards stay unlit like in Flower.frag: alpha 0 tells the lighting pass to skip them
+    gAlbedo = vec4(texture(DiffuseTextureSampler, vec2(fragTexCoords.x, fragTexCoords.y)).rgb * vec3(1.0f,1.0f,0.0f), 0.0f);
+    gNormal = vec2(0.0f, 1.0f);
+    gSpecular = vec4(0.0f);
+}
\ No newline at end of file
@@ -0,0 +1,14 @@
+#version 330 core
+
+in vec2 UV;
+in vec4 Color;
+
+out vec4 color;
+
+// Font atlas, 1 where a glyph pixel is lit
+uniform sampler2D FontSampler;
+
+void main()
+{
+	color = vec4(Color.rgb, Color.a * texture(FontSampler, UV).r);
+}
\ No newline at end of file
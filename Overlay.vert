@@ -0,0 +1,20 @@
+#version 330 core
+
+// Stats Overlay quads, in window pixels from the top left. See StatsOverlay.hpp.
+
+layout(location = 0) in vec2 vertPosition_screenspace;
+layout(location = 1) in vec2 vertUV;
+layout(location = 2) in vec4 vertColor;
+
+out vec2 UV;
+out vec4 Color;
+
+uniform vec2 ScreenSize;
+
+void main()
+{
+	vec2 ndc = vertPosition_screenspace / ScreenSize * 2.0 - 1.0;
+	gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+	UV = vertUV;
+	Color = vertColor;
+}
\ No newline at end of file
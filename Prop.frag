@@ -0,0 +1,83 @@
+#version 330 core
+
+// Instanced Props, lit by the sun and hazed like the terrain. See Props.hpp.
+
+in vec3 Position_worldspace;
+in vec3 Normal_worldspace;
+
+out vec3 color;
+
+uniform vec3 LightPosition_worldspace;
+uniform vec3 PropColor;
+
+// Cameras of every view of the frame, see Views.hpp
+struct ViewData
+{
+	mat4 V;
+	mat4 P;
+	mat4 VP;
+	vec4 CameraPosition;
+	vec4 Params;
+};
+layout(std140) uniform Views
+{
+	ViewData views[4];
+};
+uniform int ViewIndex;
+
+// Atmosphere tables, see Sky.hpp
+uniform sampler2D SkyViewSampler;
+uniform sampler3D AerialPerspectiveSampler;
+uniform vec3 SunDirection;
+uniform float KmPerUnit;
+uniform float AerialDistance;
+uniform int AtmosphereEnabled;
+
+#define PI 3.14159265
+#define AERIAL_SLICES 32.0
+
+// Texture coordinates of a direction in the sky view table, as in Sky.frag
+vec2 skyViewUV(vec3 dir)
+{
+	float elevation = asin(clamp(dir.y, -1.0, 1.0));
+	float v = 0.5 - 0.5 * sign(elevation) * sqrt(abs(elevation) / (0.5 * PI));
+	vec2 h = dir.xz;
+	vec2 s = SunDirection.xz;
+	float cosAzimuth = (dot(h, h) > 1e-8 && dot(s, s) > 1e-8) ? dot(normalize(h), normalize(s)) : 1.0;
+	return vec2(acos(clamp(cosAzimuth, -1.0, 1.0)) / PI, v);
+}
+
+// Haze between the camera and the surface, then the sky where the surface reaches fadeDistance,
+// so the far plane and the level of detail changes out there do not show
+vec3 applyAtmosphere(vec3 surface, vec3 position_worldspace, vec3 camera_worldspace, float fadeDistance)
+{
+	if (AtmosphereEnabled == 0)
+		return surface;
+
+	vec3 toSurface = position_worldspace - camera_worldspace;
+	float distance = length(toSurface);
+	vec2 uv = skyViewUV(toSurface / max(distance, 1e-4));
+
+	// Slice i holds the haze up to the end of the slice: fade it in over the first one
+	float slice = distance * KmPerUnit / AerialDistance * AERIAL_SLICES;
+	vec4 aerial = texture(AerialPerspectiveSampler, vec3(uv, (slice - 0.5) / AERIAL_SLICES));
+	float near = clamp(slice, 0.0, 1.0);
+	vec3 result = surface * mix(1.0, aerial.a, near) + aerial.rgb * near;
+
+	if (fadeDistance > 0.0)
+		result = mix(result, texture(SkyViewSampler, uv).rgb, smoothstep(0.8 * fadeDistance, fadeDistance, distance));
+	return result;
+}
+
+void main()
+{
+	vec3 n = normalize(Normal_worldspace);
+	// LightPosition_worldspace points away from the sun, see main.cpp
+	vec3 l = normalize(-LightPosition_worldspace);
+	float cosTheta = clamp(dot(n, l), 0.0, 1.0);
+	// Ambient from the sky above, a little from the ground below
+	float ambient = 0.2 * (0.75 + 0.25 * n.y);
+
+	color = PropColor * (ambient + cosTheta);
+	color = applyAtmosphere(color, Position_worldspace, views[ViewIndex].CameraPosition.xyz, views[ViewIndex].Params.y);
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#version 330 core
+
+// Instanced Props at one Level of Detail, see Props.hpp
+
+layout(location = 0) in vec3 vertPosition_modelspace;
+layout(location = 2) in vec3 vertNormal_modelspace;
+// Per instance: xyz position, w scale; cosine and sine of the yaw
+layout(location = 3) in vec4 instancePositionScale;
+layout(location = 4) in vec4 instanceRotation;
+
+out vec3 Position_worldspace;
+out vec3 Normal_worldspace;
+
+// Cameras of every view of the frame, see Views.hpp
+struct ViewData
+{
+	mat4 V;
+	mat4 P;
+	mat4 VP;
+	vec4 CameraPosition;
+	vec4 Params;
+};
+layout(std140) uniform Views
+{
+	ViewData views[4];
+};
+uniform int ViewIndex;
+
+vec3 rotateYaw(vec3 v)
+{
+	return vec3(instanceRotation.x * v.x + instanceRotation.y * v.z, v.y, -instanceRotation.y * v.x + instanceRotation.x * v.z);
+}
+
+void main()
+{
+	Position_worldspace = rotateYaw(vertPosition_modelspace * instancePositionScale.w) + instancePositionScale.xyz;
+	Normal_worldspace = rotateYaw(vertNormal_modelspace);
+	gl_Position = views[ViewIndex].VP * vec4(Position_worldspace, 1.0);
+}
\ No newline at end of file
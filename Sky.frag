@@ -0,0 +1,37 @@
+#version 330 core
+
+// Sky View Table of Atmosphere.hpp, plus the Sun Disk.
+
+in vec3 Direction_worldspace;
+
+// Ouput data
+out vec3 color;
+
+uniform sampler2D SkyViewSampler;
+uniform vec3 SunDirection;
+uniform vec3 SunColor;
+
+#define PI 3.14159265
+
+// Texture coordinates of a direction in the sky view table: azimuth from the sun,
+// elevation squeezed towards the horizon as in SkyViewElevation
+vec2 skyViewUV(vec3 dir)
+{
+	float elevation = asin(clamp(dir.y, -1.0, 1.0));
+	float v = 0.5 - 0.5 * sign(elevation) * sqrt(abs(elevation) / (0.5 * PI));
+	vec2 h = dir.xz;
+	vec2 s = SunDirection.xz;
+	// The sun at the zenith has no azimuth, the sky is the same all around
+	float cosAzimuth = (dot(h, h) > 1e-8 && dot(s, s) > 1e-8) ? dot(normalize(h), normalize(s)) : 1.0;
+	return vec2(acos(clamp(cosAzimuth, -1.0, 1.0)) / PI, v);
+}
+
+void main()
+{
+	vec3 dir = normalize(Direction_worldspace);
+	color = texture(SkyViewSampler, skyViewUV(dir)).rgb;
+
+	// Half a degree wide, with a soft edge. The planet hides it below the horizon.
+	if (dir.y > 0.0)
+		color += SunColor * smoothstep(0.99995, 0.99999, dot(dir, SunDirection));
+}
\ No newline at end of file
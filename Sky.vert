@@ -0,0 +1,31 @@
+#version 330 core
+
+// Full Screen Triangle on the Far Plane, from gl_VertexID. See Sky.hpp.
+
+out vec3 Direction_worldspace;
+
+// Cameras of every view of the frame, see Views.hpp
+struct ViewData
+{
+	mat4 V;
+	mat4 P;
+	mat4 VP;
+	vec4 CameraPosition;
+	vec4 Params;
+};
+layout(std140) uniform Views
+{
+	ViewData views[4];
+};
+uniform int ViewIndex;
+
+void main()
+{
+	vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;
+	// z = w: depth 1, behind everything that was drawn
+	gl_Position = vec4(p, 1.0, 1.0);
+
+	// The far plane is flat, so the direction interpolates linearly across the screen
+	vec4 far = inverse(views[ViewIndex].VP) * vec4(p, 1.0, 1.0);
+	Direction_worldspace = far.xyz / far.w - views[ViewIndex].CameraPosition.xyz;
+}
\ No newline at end of file
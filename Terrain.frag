@@ -16,11 +16,25 @@ out vec3 color;
 
 // Values that stay constant for the whole mesh.
 uniform sampler2D DiffuseTextureSampler;
-uniform mat4 V;
 uniform mat4 M;
 uniform mat3 MV3x3;
 uniform vec3 LightPosition_worldspace;
 
+// Cameras of every view of the frame, see Views.hpp
+struct ViewData
+{
+	mat4 V;
+	mat4 P;
+	mat4 VP;
+	vec4 CameraPosition;
+	vec4 Params;
+};
+layout(std140) uniform Views
+{
+	ViewData views[4];
+};
+uniform int ViewIndex;
+
 struct Matrial
 {
 	sampler2D rock; 
@@ -33,6 +47,75 @@ struct Matrial
 };
 uniform Matrial rt;
 
+// Cascaded Shadow Map of the directional light
+uniform sampler2DArrayShadow ShadowMap;
+uniform mat4 ShadowMatrices[4];
+uniform vec4 CascadeSplits;
+uniform int ShadowsEnabled;
+
+// Baked horizon visibility: the part of the sky each height map texel sees
+uniform sampler2D HorizonSampler;
+uniform int AmbientOcclusionEnabled;
+
+// Atmosphere tables, see Sky.hpp
+uniform sampler2D SkyViewSampler;
+uniform sampler3D AerialPerspectiveSampler;
+uniform vec3 SunDirection;
+uniform float KmPerUnit;
+uniform float AerialDistance;
+uniform int AtmosphereEnabled;
+
+#define PI 3.14159265
+#define AERIAL_SLICES 32.0
+
+// Texture coordinates of a direction in the sky view table, as in Sky.frag
+vec2 skyViewUV(vec3 dir)
+{
+	float elevation = asin(clamp(dir.y, -1.0, 1.0));
+	float v = 0.5 - 0.5 * sign(elevation) * sqrt(abs(elevation) / (0.5 * PI));
+	vec2 h = dir.xz;
+	vec2 s = SunDirection.xz;
+	float cosAzimuth = (dot(h, h) > 1e-8 && dot(s, s) > 1e-8) ? dot(normalize(h), normalize(s)) : 1.0;
+	return vec2(acos(clamp(cosAzimuth, -1.0, 1.0)) / PI, v);
+}
+
+// Haze between the camera and the surface, then the sky where the surface reaches fadeDistance,
+// so the far plane and the level of detail changes out there do not show
+vec3 applyAtmosphere(vec3 surface, vec3 position_worldspace, vec3 camera_worldspace, float fadeDistance)
+{
+	if (AtmosphereEnabled == 0)
+		return surface;
+
+	vec3 toSurface = position_worldspace - camera_worldspace;
+	float distance = length(toSurface);
+	vec2 uv = skyViewUV(toSurface / max(distance, 1e-4));
+
+	// Slice i holds the haze up to the end of the slice: fade it in over the first one
+	float slice = distance * KmPerUnit / AerialDistance * AERIAL_SLICES;
+	vec4 aerial = texture(AerialPerspectiveSampler, vec3(uv, (slice - 0.5) / AERIAL_SLICES));
+	float near = clamp(slice, 0.0, 1.0);
+	vec3 result = surface * mix(1.0, aerial.a, near) + aerial.rgb * near;
+
+	if (fadeDistance > 0.0)
+		result = mix(result, texture(SkyViewSampler, uv).rgb, smoothstep(0.8 * fadeDistance, fadeDistance, distance));
+	return result;
+}
+
+// 1: lit, 0: in shadow
+float computeShadow(vec3 position_worldspace, float viewDepth)
+{
+	if (ShadowsEnabled == 0 || viewDepth > CascadeSplits[3])
+		return 1.0;
+
+	int cascade = 0;
+	while (cascade < 3 && viewDepth > CascadeSplits[cascade])
+		cascade++;
+
+	vec4 p = ShadowMatrices[cascade] * vec4(position_worldspace, 1.0);
+	vec3 coord = p.xyz / p.w * 0.5 + 0.5;
+	return texture(ShadowMap, vec4(coord.xy, float(cascade), coord.z - 0.0005));
+}
+
 
 void main(){
 
@@ -53,7 +136,8 @@ void main(){
 							+ dataIn.tex_radio.y * texture(rt.rock_s,normTexUV).rgb
 							+ dataIn.tex_radio.z * texture(rt.snow_s,normTexUV).rgb; 
 
-	vec3 MaterialAmbientColor = vec3(0.2,0.2,0.2) * MaterialDiffuseColor;
+	float skyVisibility = AmbientOcclusionEnabled != 0 ? texture(HorizonSampler, dataIn.UV).r : 1.0;
+	vec3 MaterialAmbientColor = vec3(0.2,0.2,0.2) * MaterialDiffuseColor * skyVisibility;
 	// vec3 MaterialSpecularColor = vec3(1,1,1);
 
 	// Distance to the light
@@ -79,6 +163,11 @@ void main(){
 	cosB = clamp(pow(cosB,shininess),0,1);
 	cosB = cosB * cosTheta * (shininess+2)/(2*radians(180.0f));
 	vec3 specular = MaterialSpecularColor *LightPower*cosB;//(distance*distance);
+
+	// Shadow only takes the direct light away
+	float visibility = computeShadow(dataIn.Position_worldspace, -(views[ViewIndex].V * vec4(dataIn.Position_worldspace, 1)).z);
+	diffuse *= visibility;
+	specular *= visibility;
 	
 	// color = n;
 	color = 
@@ -89,4 +178,7 @@ void main(){
 		// Specular : reflective highlight, like a mirror
 		specular;
 
+	// Params.y: fade distance of this view, 0 for none
+	color = applyAtmosphere(color, dataIn.Position_worldspace, views[ViewIndex].CameraPosition.xyz, views[ViewIndex].Params.y);
+
 }
\ No newline at end of file
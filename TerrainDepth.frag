@@ -0,0 +1,6 @@
+#version 330 core
+
+// Depth only pass: No color output, the depth buffer is all we want.
+void main()
+{
+}
\ No newline at end of file
@@ -0,0 +1,70 @@
+#version 330 core
+
+// Deferred variant of Terrain.frag: Same Material Blending, but No Lighting.
+// Writes Albedo, Packed Normal and Specular into the G-Buffer.
+
+// Interpolated values from the vertex shaders
+in TESE_DATA
+{
+	vec2 UV;
+	vec3 Position_worldspace;
+	vec3 EyeDirection_cameraspace;
+	vec3 LightDirection_cameraspace;
+	vec3 Normal_cameraspace;
+	vec3 tex_radio;
+}dataIn;
+
+// Ouput data: G-Buffer targets
+layout(location = 0) out vec4 gAlbedo;		// rgb: albedo, a: 1 when lit
+layout(location = 1) out vec2 gNormal;		// octahedral normal
+layout(location = 2) out vec4 gSpecular;	// rgb: specular color, a: sky visibility
+
+// Values that stay constant for the whole mesh.
+uniform sampler2D DiffuseTextureSampler;
+
+struct Matrial
+{
+	sampler2D rock; 
+	sampler2D grass; 
+	sampler2D snow; 
+
+	sampler2D rock_s; 
+	sampler2D grass_s; 
+	sampler2D snow_s; 
+};
+uniform Matrial rt;
+
+// Baked horizon visibility, as in Terrain.frag
+uniform sampler2D HorizonSampler;
+uniform int AmbientOcclusionEnabled;
+
+// Octahedral Normal Encoding: A unit vector in Two Numbers
+vec2 octWrap(vec2 v)
+{
+	return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 encodeNormal(vec3 n)
+{
+	n /= (abs(n.x) + abs(n.y) + abs(n.z));
+	n.xy = n.z >= 0.0 ? n.xy : octWrap(n.xy);
+	return n.xy;
+}
+
+void main(){
+
+	// Material properties, Same as Terrain.frag
+	vec2 tiling = textureSize(DiffuseTextureSampler,0) / textureSize(rt.grass,0);
+	vec2 normTexUV = tiling * vec2(dataIn.UV.x,dataIn.UV.y);
+	vec3 MaterialDiffuseColor = dataIn.tex_radio.x * texture(rt.grass,normTexUV).rgb
+							+ dataIn.tex_radio.y * texture(rt.rock,normTexUV).rgb
+							+ dataIn.tex_radio.z * texture(rt.snow,normTexUV).rgb;
+	vec3 MaterialSpecularColor = dataIn.tex_radio.x * texture(rt.grass_s,normTexUV).rgb
+							+ dataIn.tex_radio.y * texture(rt.rock_s,normTexUV).rgb
+							+ dataIn.tex_radio.z * texture(rt.snow_s,normTexUV).rgb; 
+
+	gAlbedo = vec4(MaterialDiffuseColor, 1.0);
+	gNormal = encodeNormal(normalize(dataIn.Normal_cameraspace));
+	float skyVisibility = AmbientOcclusionEnabled != 0 ? texture(HorizonSampler, dataIn.UV).r : 1.0;
+	gSpecular = vec4(MaterialSpecularColor, skyVisibility);
+}
\ No newline at end of file
@@ -0,0 +1,229 @@
+#version 330 core
+
+// Water Plane: screen space reflections through a copy of the finished view, falling back to the
+// planar reflection (or the sky), over the refracted terrain absorbed by the depth of water. See Water.hpp.
+
+in vec3 Position_worldspace;
+
+// Ouput data
+out vec3 color;
+
+uniform vec3 LightPosition_worldspace;
+uniform float Time;
+
+// Cameras of every view of the frame, see Views.hpp
+struct ViewData
+{
+	mat4 V;
+	mat4 P;
+	mat4 VP;
+	vec4 CameraPosition;
+	vec4 Params;
+};
+layout(std140) uniform Views
+{
+	ViewData views[4];
+};
+uniform int ViewIndex;
+
+// The view before the water: window sized, the view covers Viewport (x, y, width, height, in pixels)
+uniform sampler2D SceneColorSampler;
+uniform sampler2D SceneDepthSampler;
+uniform vec2 SceneSize;
+uniform vec4 Viewport;
+uniform int SSRSteps;
+uniform float SSRDistance;
+
+// Planar reflection of the latest update, ReflectionScale: part of the target its viewport covers
+uniform sampler2D ReflectionSampler;
+uniform mat4 ReflectionVP;
+uniform vec2 ReflectionScale;
+uniform int ReflectionEnabled;
+
+// Atmosphere tables, see Sky.hpp
+uniform sampler2D SkyViewSampler;
+uniform sampler3D AerialPerspectiveSampler;
+uniform vec3 SunDirection;
+uniform vec3 SunColor;
+uniform float KmPerUnit;
+uniform float AerialDistance;
+uniform int AtmosphereEnabled;
+
+#define PI 3.14159265
+#define AERIAL_SLICES 32.0
+// Same bound as max_ssr_steps in Water.hpp
+#define MAX_SSR_STEPS 64
+
+// Per unit of water crossed: red goes first
+const vec3 absorption = vec3(0.45, 0.12, 0.08);
+const vec3 deepColor = vec3(0.01, 0.05, 0.07);
+
+// Texture coordinates of a direction in the sky view table, as in Sky.frag
+vec2 skyViewUV(vec3 dir)
+{
+	float elevation = asin(clamp(dir.y, -1.0, 1.0));
+	float v = 0.5 - 0.5 * sign(elevation) * sqrt(abs(elevation) / (0.5 * PI));
+	vec2 h = dir.xz;
+	vec2 s = SunDirection.xz;
+	float cosAzimuth = (dot(h, h) > 1e-8 && dot(s, s) > 1e-8) ? dot(normalize(h), normalize(s)) : 1.0;
+	return vec2(acos(clamp(cosAzimuth, -1.0, 1.0)) / PI, v);
+}
+
+vec3 skyColor(vec3 dir)
+{
+	return AtmosphereEnabled != 0 ? texture(SkyViewSampler, skyViewUV(dir)).rgb : vec3(0.7, 0.8, 1.0);
+}
+
+// Haze between the camera and the surface, as in Terrain.frag, split in rgb: in-scattered light, a: transmittance.
+// The refracted terrain is already hazed, so only the light the water adds goes through it.
+vec4 aerialPerspective(vec3 toSurface, float distance)
+{
+	if (AtmosphereEnabled == 0)
+		return vec4(0.0, 0.0, 0.0, 1.0);
+	float slice = distance * KmPerUnit / AerialDistance * AERIAL_SLICES;
+	vec4 aerial = texture(AerialPerspectiveSampler, vec3(skyViewUV(toSurface / max(distance, 1e-4)), (slice - 0.5) / AERIAL_SLICES));
+	float near = clamp(slice, 0.0, 1.0);
+	return vec4(aerial.rgb * near, mix(1.0, aerial.a, near));
+}
+
+// Small ripples: a few sine waves crossing each other
+vec3 waveNormal(vec2 p, float t)
+{
+	vec2 slope = vec2(0.0);
+	slope += 0.040 * vec2(0.8, 0.6) * cos(dot(p, vec2(0.8, 0.6)) * 0.9 + t * 1.1);
+	slope += 0.030 * vec2(-0.4, 0.9) * cos(dot(p, vec2(-0.4, 0.9)) * 1.7 + t * 1.6);
+	slope += 0.020 * vec2(0.9, -0.3) * cos(dot(p, vec2(0.9, -0.3)) * 3.1 + t * 2.3);
+	slope += 0.012 * vec2(-0.7, -0.7) * cos(dot(p, vec2(-0.7, -0.7)) * 5.3 + t * 3.0);
+	return normalize(vec3(-slope.x, 1.0, -slope.y));
+}
+
+// View space depth (negative) of a depth buffer value
+float viewZ(float depth, mat4 P)
+{
+	return -P[3][2] / (depth * 2.0 - 1.0 + P[2][2]);
+}
+
+// Window texture coordinates of a view space point; xy: coordinates, z: 1 inside the view
+vec3 sceneUV(vec3 q, mat4 P)
+{
+	vec4 clip = P * vec4(q, 1.0);
+	vec2 uv = clip.xy / clip.w * 0.5 + 0.5;
+	float inside = (uv.x >= 0.0 && uv.x <= 1.0 && uv.y >= 0.0 && uv.y <= 1.0) ? 1.0 : 0.0;
+	return vec3((Viewport.xy + uv * Viewport.zw) / SceneSize, inside);
+}
+
+// Marches the reflected ray through the scene depth. rgb: color it hits, a: confidence
+vec4 traceScreenSpace(vec3 origin, vec3 dir, mat4 P)
+{
+	if (SSRSteps <= 0)
+		return vec4(0.0);
+
+	float stepLength = SSRDistance / float(SSRSteps);
+	// Per pixel offset of the steps, so the banding turns into noise
+	float jitter = fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+	float previous = 0.0;
+	for (int i = 0; i < MAX_SSR_STEPS; i++)
+	{
+		if (i >= SSRSteps)
+			break;
+		float t = stepLength * (float(i) + 0.5 + 0.5 * jitter);
+		vec3 q = origin + dir * t;
+		if (q.z > -0.1)
+			break;
+		vec3 uv = sceneUV(q, P);
+		if (uv.z == 0.0)
+			break;
+
+		// Behind the surface, and not by more than a step: it crossed it. Further behind: it passed behind an object.
+		float behind = viewZ(textureLod(SceneDepthSampler, uv.xy, 0.0).r, P) - q.z;
+		if (behind > 0.0 && behind < stepLength * 2.0)
+		{
+			// Halve the last step a few times
+			float a = previous, b = t;
+			for (int r = 0; r < 5; r++)
+			{
+				float m = 0.5 * (a + b);
+				vec3 mq = origin + dir * m;
+				if (viewZ(textureLod(SceneDepthSampler, sceneUV(mq, P).xy, 0.0).r, P) > mq.z)
+					b = m;
+				else
+					a = m;
+			}
+			vec3 hit = sceneUV(origin + dir * b, P);
+
+			// Fade out near the edges of the view and the end of the ray, where the next frame may lose the hit
+			vec2 inView = (hit.xy * SceneSize - Viewport.xy) / Viewport.zw;
+			vec2 edge = min(inView, 1.0 - inView);
+			float confidence = smoothstep(0.0, 0.08, min(edge.x, edge.y)) * (1.0 - smoothstep(0.7, 1.0, b / SSRDistance));
+			return vec4(textureLod(SceneColorSampler, hit.xy, 0.0).rgb, confidence);
+		}
+		previous = t;
+	}
+	return vec4(0.0);
+}
+
+void main()
+{
+	mat4 V = views[ViewIndex].V;
+	mat4 P = views[ViewIndex].P;
+	vec3 camera = views[ViewIndex].CameraPosition.xyz;
+
+	vec3 toSurface = Position_worldspace - camera;
+	float distance = length(toSurface);
+	vec3 e = -toSurface / max(distance, 1e-4);
+
+	// Seen from below, the plane is the underside of the same surface
+	vec3 n = waveNormal(Position_worldspace.xz, Time);
+	if (e.y < 0.0)
+		n.y = -n.y;
+	float cosTheta = max(dot(n, e), 0.0);
+	// Schlick, water F0 = 0.02
+	float fresnel = 0.02 + 0.98 * pow(1.0 - cosTheta, 5.0);
+
+	// Refraction: the terrain under this pixel, pushed by the ripples unless that lands on something over the water
+	vec3 origin = (V * vec4(Position_worldspace, 1.0)).xyz;
+	vec2 pixelUV = gl_FragCoord.xy / SceneSize;
+	vec2 refractUV = pixelUV + n.xz * 0.02;
+	float floorZ = viewZ(texture(SceneDepthSampler, refractUV).r, P);
+	if (floorZ > origin.z)
+	{
+		refractUV = pixelUV;
+		floorZ = viewZ(texture(SceneDepthSampler, refractUV).r, P);
+	}
+	// Water crossed along the view ray, scaled from view depth
+	float thickness = max(origin.z - floorZ, 0.0) * distance / max(-origin.z, 1e-4);
+	vec3 transmittance = exp(-thickness * absorption);
+	vec3 below = texture(SceneColorSampler, refractUV).rgb;
+
+	// Reflection: screen space first, then the planar reflection or the sky for what it misses
+	vec3 r = reflect(-e, n);
+	r.y = abs(r.y);
+	vec3 fallback = skyColor(r);
+	if (ReflectionEnabled != 0)
+	{
+		vec4 clip = ReflectionVP * vec4(Position_worldspace, 1.0);
+		vec2 uv = clamp(clip.xy / clip.w * 0.5 + 0.5 + n.xz * 0.03, 0.0, 1.0);
+		if (clip.w > 0.0)
+			fallback = texture(ReflectionSampler, uv * ReflectionScale).rgb;
+	}
+	vec4 traced = traceScreenSpace(origin, normalize(mat3(V) * r), P);
+	vec3 reflected = mix(fallback, traced.rgb, traced.a);
+
+	// Sun glints. LightPosition_worldspace points away from the sun, see main.cpp
+	vec3 sun = normalize(-LightPosition_worldspace);
+	vec3 specular = SunColor * pow(max(dot(r, sun), 0.0), 400.0) * 4.0 * step(0.0, sun.y);
+
+	// Shallow water near the shore lets the terrain through
+	fresnel *= smoothstep(0.0, 0.3, thickness);
+
+	// Light the water adds, hazed; the refracted terrain was hazed when it was drawn
+	vec3 added = fresnel * reflected + specular + (1.0 - fresnel) * (1.0 - transmittance) * deepColor * (0.3 + 0.7 * max(sun.y, 0.0));
+	float coverage = 1.0 - (1.0 - fresnel) * dot(transmittance, vec3(1.0 / 3.0));
+	vec4 aerial = aerialPerspective(toSurface, distance);
+	color = added * aerial.a + aerial.rgb * coverage + (1.0 - fresnel) * transmittance * below;
+
+	// Same fade into the sky as the terrain, before the far plane
+	float fadeDistance = views[ViewIndex].Params.y;
+	if (fadeDistance > 0.0)
+		color = mix(color, skyColor(-e), smoothstep(0.8 * fadeDistance, fadeDistance, distance));
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#version 330 core
+
+// Water Plane from gl_VertexID, a strip of 4 corners over WaterBounds. See Water.hpp.
+
+out vec3 Position_worldspace;
+
+// Cameras of every view of the frame, see Views.hpp
+struct ViewData
+{
+	mat4 V;
+	mat4 P;
+	mat4 VP;
+	vec4 CameraPosition;
+	vec4 Params;
+};
+layout(std140) uniform Views
+{
+	ViewData views[4];
+};
+uniform int ViewIndex;
+
+uniform float WaterLevel;
+// xy: lowest x and z, zw: highest
+uniform vec4 WaterBounds;
+
+void main()
+{
+	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+	vec2 xz = mix(WaterBounds.xy, WaterBounds.zw, corner);
+	Position_worldspace = vec3(xz.x, WaterLevel, xz.y);
+	gl_Position = views[ViewIndex].VP * vec4(Position_worldspace, 1.0);
+}
\ No newline at end of file
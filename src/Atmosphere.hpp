@@ -0,0 +1,373 @@
+#pragma once
+/*
+	Physically Based Atmosphere, precomputed on the CPU.
+	Rayleigh, Mie and ozone around a spherical planet, in kilometers, as in Hillaire's
+	"A Scalable and Production Ready Sky and Atmosphere Rendering Technique" (EGSR 2020).
+	Four tables: transmittance to the top of the atmosphere, multiple scattering as an isotropic
+	source, the sky seen from the viewer, and the aerial perspective in front of the viewer.
+	Every table runs on every core, and they only change with the sun.
+*/
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "Parallel.hpp"
+
+struct AtmosphereSettings
+{
+	// Planet and top of the atmosphere, km
+	float bottomRadius = 6360.0f;
+	float topRadius = 6460.0f;
+
+	// Per km at sea level
+	glm::vec3 rayleighScattering = glm::vec3(5.802e-3f, 13.558e-3f, 33.1e-3f);
+	float rayleighScaleHeight = 8.0f;
+	float mieScattering = 3.996e-3f;
+	float mieAbsorption = 4.40e-3f;
+	float mieScaleHeight = 1.2f;
+	float mieG = 0.8f;
+	// Ozone: a tent of this half width around its center altitude
+	glm::vec3 ozoneAbsorption = glm::vec3(0.650e-3f, 1.881e-3f, 0.085e-3f);
+	float ozoneCenter = 25.0f;
+	float ozoneHalfWidth = 15.0f;
+	glm::vec3 groundAlbedo = glm::vec3(0.3f);
+
+	// Sun illuminance, in the units of the terrain lighting: the horizon is about white
+	float sunIlluminance = 9.0f;
+	// Altitude of the viewer of the sky and aerial perspective tables, km
+	float viewerAltitude = 0.5f;
+	// World units to km, for the aerial perspective. The 100 units of terrain span 25 km of haze.
+	float kmPerUnit = 0.25f;
+	// Distance of the last aerial perspective slice, km: the 500 units far plane
+	float aerialDistance = 125.0f;
+};
+
+// Table sizes
+static constexpr int transmittance_width = 256;
+static constexpr int transmittance_height = 64;
+static constexpr int multi_scattering_size = 32;
+static constexpr int sky_view_width = 192;
+static constexpr int sky_view_height = 108;
+static constexpr int aerial_size = 32;
+static constexpr float atmosphere_pi = 3.14159265f;
+
+// Sky view and aerial perspective rows: more rows near the horizon, where the sky changes the most.
+// v in [0, 1], 0: zenith, 0.5: horizon, 1: nadir. Sky.frag, Terrain.frag and DeferredLighting.frag invert it.
+static inline float SkyViewElevation(float v)
+{
+	float c = v < 0.5f ? 1.0f - 2.0f * v : 2.0f * v - 1.0f;
+	float elevation = c * c * 0.5f * atmosphere_pi;
+	return v < 0.5f ? elevation : -elevation;
+}
+
+// Nearest positive distance from o along d to the sphere, -1 when it misses
+static inline float RaySphere(const glm::vec3& o, const glm::vec3& d, float radius)
+{
+	float b = glm::dot(o, d);
+	float c = glm::dot(o, o) - radius * radius;
+	float disc = b * b - c;
+	if (disc < 0.0f)
+		return -1.0f;
+	float s = std::sqrt(disc);
+	if (-b - s >= 0.0f)
+		return -b - s;
+	return -b + s >= 0.0f ? -b + s : -1.0f;
+}
+
+static inline float RayleighPhase(float cosTheta)
+{
+	return 3.0f / (16.0f * atmosphere_pi) * (1.0f + cosTheta * cosTheta);
+}
+
+// Cornette-Shanks
+static inline float MiePhase(float g, float cosTheta)
+{
+	float k = 3.0f / (8.0f * atmosphere_pi) * (1.0f - g * g) / (2.0f + g * g);
+	return k * (1.0f + cosTheta * cosTheta) / std::pow(1.0f + g * g - 2.0f * g * cosTheta, 1.5f);
+}
+
+class Atmosphere
+{
+private:
+	AtmosphereSettings settings;
+	// World direction towards the sun, and the same elevation at azimuth 0 for the tables
+	glm::vec3 sunDirection = glm::vec3(0.0f, 1.0f, 0.0f);
+	glm::vec3 sun = glm::vec3(0.0f, 1.0f, 0.0f);
+
+	std::vector<glm::vec3> transmittance;
+	std::vector<glm::vec3> multiScattering;
+	std::vector<glm::vec3> skyView;
+	// rgb: in-scattered light, a: mean transmittance. Slice after slice of aerial_size x aerial_size.
+	std::vector<glm::vec4> aerial;
+
+	struct Medium
+	{
+		glm::vec3 rayleigh;
+		float mie;
+		glm::vec3 extinction;
+	};
+
+	Medium medium(float altitude) const
+	{
+		altitude = std::max(altitude, 0.0f);
+		float rayleighDensity = std::exp(-altitude / settings.rayleighScaleHeight);
+		float mieDensity = std::exp(-altitude / settings.mieScaleHeight);
+		float ozoneDensity = std::max(0.0f, 1.0f - std::abs(altitude - settings.ozoneCenter) / settings.ozoneHalfWidth);
+
+		Medium m;
+		m.rayleigh = settings.rayleighScattering * rayleighDensity;
+		m.mie = settings.mieScattering * mieDensity;
+		m.extinction = m.rayleigh + glm::vec3((settings.mieScattering + settings.mieAbsorption) * mieDensity) + settings.ozoneAbsorption * ozoneDensity;
+		return m;
+	}
+
+	// Bilinear lookup of a table over (cosine of the sun zenith in [-1, 1], altitude)
+	static glm::vec3 lookup(const std::vector<glm::vec3>& table, int w, int h, float mu, float altitude, float top)
+	{
+		float x = glm::clamp((mu * 0.5f + 0.5f) * float(w) - 0.5f, 0.0f, float(w - 1));
+		float y = glm::clamp(altitude / top * float(h) - 0.5f, 0.0f, float(h - 1));
+		int x0 = std::min((int)x, w - 2), y0 = std::min((int)y, h - 2);
+		float fx = x - float(x0), fy = y - float(y0);
+		const glm::vec3* row0 = &table[size_t(y0) * w + x0];
+		const glm::vec3* row1 = row0 + w;
+		glm::vec3 lower = row0[0] + (row0[1] - row0[0]) * fx;
+		glm::vec3 upper = row1[0] + (row1[1] - row1[0]) * fx;
+		return lower + (upper - lower) * fy;
+	}
+
+	// Sunlight that reaches a point at radius r and sun zenith cosine mu, zero in the shadow of the planet
+	glm::vec3 sunTransmittance(float r, float mu) const
+	{
+		if (mu < 0.0f && r * r * (1.0f - mu * mu) < settings.bottomRadius * settings.bottomRadius)
+			return glm::vec3(0.0f);
+		return TransmittanceAt(r - settings.bottomRadius, mu);
+	}
+
+	void bakeTransmittance()
+	{
+		transmittance.resize(size_t(transmittance_width) * transmittance_height);
+		const float thickness = settings.topRadius - settings.bottomRadius;
+		ParallelFor(transmittance_height, [&](int y)
+		{
+			float altitude = (float(y) + 0.5f) / float(transmittance_height) * thickness;
+			for (int x = 0; x < transmittance_width; x++)
+			{
+				float mu = (float(x) + 0.5f) / float(transmittance_width) * 2.0f - 1.0f;
+				glm::vec3 o(0.0f, settings.bottomRadius + altitude, 0.0f);
+				glm::vec3 d(std::sqrt(std::max(0.0f, 1.0f - mu * mu)), mu, 0.0f);
+				float length = RaySphere(o, d, settings.topRadius);
+
+				const int steps = 40;
+				glm::vec3 depth(0.0f);
+				for (int s = 0; s < steps; s++)
+				{
+					glm::vec3 p = o + d * ((float(s) + 0.5f) / float(steps) * length);
+					depth += medium(glm::length(p) - settings.bottomRadius).extinction;
+				}
+				transmittance[size_t(y) * transmittance_width + x] = glm::exp(-depth * (length / float(steps)));
+			}
+		});
+	}
+
+	// Second order scattering from a uniform sphere of directions, summed as a geometric series
+	void bakeMultiScattering()
+	{
+		multiScattering.resize(size_t(multi_scattering_size) * multi_scattering_size);
+		const float thickness = settings.topRadius - settings.bottomRadius;
+		const int rings = 8;
+		const float isotropic = 1.0f / (4.0f * atmosphere_pi);
+		ParallelFor(multi_scattering_size, [&](int y)
+		{
+			float altitude = (float(y) + 0.5f) / float(multi_scattering_size) * thickness;
+			glm::vec3 o(0.0f, settings.bottomRadius + altitude, 0.0f);
+			for (int x = 0; x < multi_scattering_size; x++)
+			{
+				// Sun in the xy plane, at this zenith cosine
+				float muS = (float(x) + 0.5f) / float(multi_scattering_size) * 2.0f - 1.0f;
+				glm::vec3 sunDirection(std::sqrt(std::max(0.0f, 1.0f - muS * muS)), muS, 0.0f);
+
+				glm::vec3 secondOrder(0.0f), transfer(0.0f);
+				for (int i = 0; i < rings; i++)
+				{
+					for (int j = 0; j < rings; j++)
+					{
+						float cosTheta = 1.0f - 2.0f * (float(i) + 0.5f) / float(rings);
+						float sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+						float phi = 2.0f * atmosphere_pi * (float(j) + 0.5f) / float(rings);
+						glm::vec3 d(sinTheta * std::cos(phi), cosTheta, sinTheta * std::sin(phi));
+
+						float ground = RaySphere(o, d, settings.bottomRadius);
+						float length = ground > 0.0f ? ground : RaySphere(o, d, settings.topRadius);
+
+						const int steps = 20;
+						float dt = length / float(steps);
+						glm::vec3 T(1.0f), L(0.0f), f(0.0f);
+						for (int s = 0; s < steps; s++)
+						{
+							glm::vec3 p = o + d * ((float(s) + 0.5f) * dt);
+							float r = glm::length(p);
+							Medium m = medium(r - settings.bottomRadius);
+							glm::vec3 scattering = m.rayleigh + glm::vec3(m.mie);
+							glm::vec3 stepT = glm::exp(-m.extinction * dt);
+
+							float cosSun = glm::dot(p, sunDirection) / r;
+							bool shadowed = cosSun < 0.0f && r * r * (1.0f - cosSun * cosSun) < settings.bottomRadius * settings.bottomRadius;
+							glm::vec3 sunLight = shadowed ? glm::vec3(0.0f) : TransmittanceAt(r - settings.bottomRadius, cosSun);
+
+							// Analytic integral of the source over the step
+							glm::vec3 integral = (glm::vec3(1.0f) - stepT) / glm::max(m.extinction, glm::vec3(1e-7f));
+							L += T * scattering * sunLight * isotropic * integral;
+							f += T * scattering * integral;
+							T *= stepT;
+						}
+
+						// Sunlight bounced by the ground
+						if (ground > 0.0f)
+						{
+							glm::vec3 p = o + d * ground;
+							glm::vec3 up = glm::normalize(p);
+							float cosSun = glm::dot(up, sunDirection);
+							L += T * TransmittanceAt(0.0f, cosSun) * std::max(cosSun, 0.0f) * settings.groundAlbedo / atmosphere_pi;
+						}
+
+						secondOrder += L;
+						transfer += f;
+					}
+				}
+				secondOrder /= float(rings * rings);
+				transfer /= float(rings * rings);
+				multiScattering[size_t(y) * multi_scattering_size + x] = secondOrder / (glm::vec3(1.0f) - transfer);
+			}
+		});
+	}
+
+	// In-scattered light along one ray, between t0 and t1, added to L. T is the transmittance so far.
+	// phase: Rayleigh and Mie phase functions of the ray, against the sun.
+	void integrate(const glm::vec3& o, const glm::vec3& d, const glm::vec2& phase, float t0, float t1, int steps, glm::vec3& L, glm::vec3& T) const
+	{
+		const float phaseR = phase.x;
+		const float phaseM = phase.y;
+		const float thickness = settings.topRadius - settings.bottomRadius;
+		float dt = (t1 - t0) / float(steps);
+		for (int s = 0; s < steps; s++)
+		{
+			glm::vec3 p = o + d * (t0 + (float(s) + 0.5f) * dt);
+			float r = glm::length(p);
+			float altitude = r - settings.bottomRadius;
+			Medium m = medium(altitude);
+			glm::vec3 stepT = glm::exp(-m.extinction * dt);
+
+			float cosSun = glm::dot(p, sun) / r;
+			glm::vec3 multi = lookup(multiScattering, multi_scattering_size, multi_scattering_size, cosSun, glm::clamp(altitude, 0.0f, thickness), thickness);
+			glm::vec3 source = (m.rayleigh * phaseR + glm::vec3(m.mie * phaseM)) * sunTransmittance(r, cosSun) + (m.rayleigh + glm::vec3(m.mie)) * multi;
+
+			glm::vec3 integral = (glm::vec3(1.0f) - stepT) / glm::max(m.extinction, glm::vec3(1e-7f));
+			L += T * source * integral;
+			T *= stepT;
+		}
+	}
+
+	// Direction of a sky view or aerial perspective texel, with the sun at azimuth 0
+	static glm::vec3 viewDirection(float u, float v)
+	{
+		float azimuth = u * atmosphere_pi;
+		float elevation = SkyViewElevation(v);
+		return glm::vec3(std::cos(elevation) * std::cos(azimuth), std::sin(elevation), std::cos(elevation) * std::sin(azimuth));
+	}
+
+	void bakeSkyView()
+	{
+		skyView.resize(size_t(sky_view_width) * sky_view_height);
+		const glm::vec3 o(0.0f, settings.bottomRadius + settings.viewerAltitude, 0.0f);
+		ParallelFor(sky_view_height, [&](int y)
+		{
+			for (int x = 0; x < sky_view_width; x++)
+			{
+				glm::vec3 d = viewDirection((float(x) + 0.5f) / float(sky_view_width), (float(y) + 0.5f) / float(sky_view_height));
+				float ground = RaySphere(o, d, settings.bottomRadius);
+				float length = ground > 0.0f ? ground : RaySphere(o, d, settings.topRadius);
+
+				// Short steps near the viewer, long ones in the thin air far away
+				const glm::vec2 phase(RayleighPhase(glm::dot(d, sun)), MiePhase(settings.mieG, glm::dot(d, sun)));
+				const int segments = 32;
+				glm::vec3 L(0.0f), T(1.0f);
+				for (int s = 0; s < segments; s++)
+				{
+					float a = float(s) / float(segments), b = float(s + 1) / float(segments);
+					integrate(o, d, phase, a * a * length, b * b * length, 1, L, T);
+				}
+				if (ground > 0.0f)
+				{
+					glm::vec3 p = o + d * ground;
+					float cosSun = glm::dot(p, sun) / glm::length(p);
+					L += T * sunTransmittance(glm::length(p), cosSun) * std::max(cosSun, 0.0f) * settings.groundAlbedo / atmosphere_pi;
+				}
+				skyView[size_t(y) * sky_view_width + x] = L * settings.sunIlluminance;
+			}
+		});
+	}
+
+	// The planet does not stop these rays: the terrain is what they reach
+	void bakeAerialPerspective()
+	{
+		aerial.resize(size_t(aerial_size) * aerial_size * aerial_size);
+		const glm::vec3 o(0.0f, settings.bottomRadius + settings.viewerAltitude, 0.0f);
+		const float slice = settings.aerialDistance / float(aerial_size);
+		ParallelFor(aerial_size, [&](int y)
+		{
+			for (int x = 0; x < aerial_size; x++)
+			{
+				glm::vec3 d = viewDirection((float(x) + 0.5f) / float(aerial_size), (float(y) + 0.5f) / float(aerial_size));
+				const glm::vec2 phase(RayleighPhase(glm::dot(d, sun)), MiePhase(settings.mieG, glm::dot(d, sun)));
+				glm::vec3 L(0.0f), T(1.0f);
+				for (int z = 0; z < aerial_size; z++)
+				{
+					integrate(o, d, phase, float(z) * slice, float(z + 1) * slice, 2, L, T);
+					aerial[(size_t(z) * aerial_size + y) * aerial_size + x] = glm::vec4(L * settings.sunIlluminance, (T.x + T.y + T.z) / 3.0f);
+				}
+			}
+		});
+	}
+public:
+	Atmosphere() = default;
+
+	Atmosphere(const AtmosphereSettings& _settings)
+	{
+		settings = _settings;
+		bakeTransmittance();
+		bakeMultiScattering();
+	}
+
+	// Sky and aerial perspective for a new sun. sun_direction: towards the sun, y up.
+	// The tables measure azimuths from the sun, so only its elevation matters.
+	void Bake(const glm::vec3& sun_direction)
+	{
+		sunDirection = glm::normalize(sun_direction);
+		float cosZenith = glm::clamp(sunDirection.y, -1.0f, 1.0f);
+		sun = glm::vec3(std::sqrt(1.0f - cosZenith * cosZenith), cosZenith, 0.0f);
+		bakeSkyView();
+		bakeAerialPerspective();
+	}
+
+	// Transmittance from an altitude to the top of the atmosphere, at a zenith cosine
+	glm::vec3 TransmittanceAt(float altitude, float mu) const
+	{
+		return lookup(transmittance, transmittance_width, transmittance_height, mu, altitude, settings.topRadius - settings.bottomRadius);
+	}
+
+	// Color of the sun disk seen by the viewer
+	glm::vec3 SunColor() const
+	{
+		return TransmittanceAt(settings.viewerAltitude, sun.y) * settings.sunIlluminance;
+	}
+
+	const AtmosphereSettings& GetSettings() const { return settings; }
+	const glm::vec3& GetSunDirection() const { return sunDirection; }
+	const float* GetSkyView() const { return &skyView[0].x; }
+	const float* GetAerialPerspective() const { return &aerial[0].x; }
+	const float* GetTransmittance() const { return &transmittance[0].x; }
+	const float* GetMultiScattering() const { return &multiScattering[0].x; }
+};
\ No newline at end of file
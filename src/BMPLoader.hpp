@@ -3,65 +3,15 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
+#include "BMPReader.hpp"
+
 // Load BMP images file from Hard Disk
 static inline GLuint loadBMP_custom(const char* imagepath, GLenum filter_mode, GLenum what_happens_at_edge, int& width, int& height) {
 
-	printf("Reading image %s\n", imagepath);
-
-	// Data read from the header of the BMP file
-	unsigned char header[54];
-	unsigned int dataPos;
-	unsigned int imageSize;
-	// Actual RGB data
-	unsigned char* data;
-
-	// Open the file
-	FILE* file = fopen(imagepath, "rb");
-	if (!file) {
-		printf("%s could not be opened. Are you in the right directory ? !\n", imagepath);
-		return 0;
-	}
-
-	// Read the header, i.e. the 54 first bytes
-
-	// If less than 54 bytes are read, problem
-	if (fread(header, 1, 54, file) != 54) {
-		printf("Not a correct BMP file\n");
-		fclose(file);
-		return 0;
-	}
-	// A BMP files always begins with "BM"
-	if (header[0] != 'B' || header[1] != 'M') {
-		printf("Not a correct BMP file\n");
-		fclose(file);
+	// Decode the file on the CPU first
+	std::vector<unsigned char> data;
+	if (!readBMP_custom(imagepath, width, height, data))
 		return 0;
-	}
-	// Make sure this is a 24bpp file
-	if (*(int*)&(header[0x1E]) != 0) { printf("Not a correct BMP file\n");    fclose(file); return 0; }
-	if (*(int*)&(header[0x1C]) != 24) { printf("Not a correct BMP file\n");    fclose(file); return 0; }
-
-	// Read the information about the image
-	dataPos = *(int*)&(header[0x0A]);
-	imageSize = *(int*)&(header[0x22]);
-
-	// texture width of the image
-	width = *(int*)&(header[0x12]);
-	// texture height of the image
-	height = *(int*)&(header[0x16]);
-
-	// Some BMP files are misformatted, guess missing information
-	if (imageSize == 0)    imageSize = width * height * 3; // 3 : one byte for each Red, Green and Blue component
-	if (dataPos == 0)      dataPos = 54; // The BMP header is done that way
-
-	// Create a buffer
-	data = new unsigned char[imageSize];
-
-	// Read the actual data from the file into the buffer
-	fseek(file, dataPos, SEEK_SET);
-	fread(data, 1, imageSize, file);
-
-	// Everything is in memory now, the file can be closed.
-	fclose(file);
 
 	// Create one OpenGL texture
 	GLuint textureID;
@@ -73,10 +23,7 @@ static inline GLuint loadBMP_custom(const char* imagepath, GLenum filter_mode, G
 	// Give the image to OpenGL
 	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, data);
-
-	// OpenGL has now copied the data. Free our own version
-	delete[] data;
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, data.data());
 
 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, what_happens_at_edge);
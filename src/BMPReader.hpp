@@ -0,0 +1,107 @@
+#pragma once
+/*
+	Read and write 24 bit BMP images, without OpenGL.
+	Shared by the texture loader, the texture baker, the frame capture and the offline tools.
+*/
+
+#include <stdio.h>
+#include <vector>
+
+// Read and check the header of a 24bpp BMP file, leaving the file at the end of the header
+static inline bool readBMP_header(FILE* file, int& width, int& height, unsigned int& dataPos, unsigned int& imageSize) {
+
+	// Read the header, i.e. the 54 first bytes
+	unsigned char header[54];
+
+	// If less than 54 bytes are read, problem
+	if (fread(header, 1, 54, file) != 54) {
+		printf("Not a correct BMP file\n");
+		return false;
+	}
+	// A BMP files always begins with "BM"
+	if (header[0] != 'B' || header[1] != 'M') {
+		printf("Not a correct BMP file\n");
+		return false;
+	}
+	// Make sure this is a 24bpp file
+	if (*(int*)&(header[0x1E]) != 0) { printf("Not a correct BMP file\n"); return false; }
+	if (*(int*)&(header[0x1C]) != 24) { printf("Not a correct BMP file\n"); return false; }
+
+	// Read the information about the image
+	dataPos = *(int*)&(header[0x0A]);
+	imageSize = *(int*)&(header[0x22]);
+
+	// texture width of the image
+	width = *(int*)&(header[0x12]);
+	// texture height of the image
+	height = *(int*)&(header[0x16]);
+
+	// Some BMP files are misformatted, guess missing information
+	if (imageSize == 0)    imageSize = width * height * 3; // 3 : one byte for each Red, Green and Blue component
+	if (dataPos == 0)      dataPos = 54; // The BMP header is done that way
+	return true;
+}
+
+// Read a 24bpp BMP file. Pixels stay as in the file: BGR, bottom row first.
+static inline bool readBMP_custom(const char* imagepath, int& width, int& height, std::vector<unsigned char>& out_data) {
+
+	printf("Reading image %s\n", imagepath);
+
+	// Data read from the header of the BMP file
+	unsigned int dataPos;
+	unsigned int imageSize;
+
+	// Open the file
+	FILE* file = fopen(imagepath, "rb");
+	if (!file) {
+		printf("%s could not be opened. Are you in the right directory ? !\n", imagepath);
+		return false;
+	}
+
+	if (!readBMP_header(file, width, height, dataPos, imageSize)) {
+		fclose(file);
+		return false;
+	}
+
+	// Read the actual data from the file into the buffer
+	out_data.resize(imageSize);
+	fseek(file, dataPos, SEEK_SET);
+	fread(out_data.data(), 1, imageSize, file);
+
+	// Everything is in memory now, the file can be closed.
+	fclose(file);
+	return true;
+}
+
+// Write a 24bpp BMP file from BGR pixels, bottom row first, rows tightly packed (what glReadPixels gives with GL_PACK_ALIGNMENT 1)
+static inline bool writeBMP_custom(const char* imagepath, int width, int height, const unsigned char* bgr) {
+
+	// Rows are padded to 4 bytes in the file
+	const unsigned int stride = (unsigned int)(width * 3 + 3) & ~3u;
+	const unsigned int imageSize = stride * (unsigned int)height;
+
+	unsigned char header[54] = { 'B', 'M' };
+	*(unsigned int*)&(header[0x02]) = 54 + imageSize;
+	*(unsigned int*)&(header[0x0A]) = 54;
+	*(unsigned int*)&(header[0x0E]) = 40;
+	*(int*)&(header[0x12]) = width;
+	*(int*)&(header[0x16]) = height;
+	*(unsigned short*)&(header[0x1A]) = 1;
+	*(unsigned short*)&(header[0x1C]) = 24;
+	*(unsigned int*)&(header[0x22]) = imageSize;
+
+	FILE* file = fopen(imagepath, "wb");
+	if (!file) {
+		printf("%s could not be written\n", imagepath);
+		return false;
+	}
+
+	fwrite(header, 1, 54, file);
+	const unsigned char padding[3] = { 0, 0, 0 };
+	for (int y = 0; y < height; y++) {
+		fwrite(bgr + size_t(y) * width * 3, 1, size_t(width) * 3, file);
+		fwrite(padding, 1, stride - width * 3, file);
+	}
+	fclose(file);
+	return true;
+}
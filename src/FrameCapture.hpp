@@ -0,0 +1,68 @@
+#pragma once
+/*
+	Offscreen Frame Capture.
+	A color and depth target of any size, independent of the window, read back into a 24 bit BMP.
+	TERRAIN_CAPTURE renders one frame of the player view into it, to diff against ReferenceRenderer.hpp.
+*/
+
+#include <GL/glew.h>
+
+#include <stdio.h>
+#include <vector>
+
+#include "BMPReader.hpp"
+#include "GLResource.hpp"
+
+class FrameCapture
+{
+private:
+	FramebufferHandle fbo;
+	TextureHandle color;
+	TextureHandle depth;
+	int width = 0;
+	int height = 0;
+public:
+	FrameCapture(int _width, int _height)
+	{
+		width = _width;
+		height = _height;
+
+		// Same unorm8 color as the window; float depth, the reference compares floats
+		color.Reset(GenTexture(), int64_t(width) * height * 4);
+		glBindTexture(GL_TEXTURE_2D, color);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		depth.Reset(GenTexture(), int64_t(width) * height * 4);
+		glBindTexture(GL_TEXTURE_2D, depth);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		fbo.Reset(GenFramebuffer());
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			printf("Frame capture target is not complete!\n");
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	// Read the target back and write it, bottom row first like the reference renderer
+	bool Save(const char* path) const
+	{
+		std::vector<unsigned char> pixels(size_t(width) * height * 3);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+		glReadBuffer(GL_COLOR_ATTACHMENT0);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, width, height, GL_BGR, GL_UNSIGNED_BYTE, pixels.data());
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+		return writeBMP_custom(path, width, height, pixels.data());
+	}
+
+	GLuint GetFramebuffer() const { return fbo; }
+	int GetWidth() const { return width; }
+	int GetHeight() const { return height; }
+};
\ No newline at end of file
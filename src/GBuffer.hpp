@@ -0,0 +1,92 @@
+#pragma once
+/*
+	Compact G-Buffer for the deferred path.
+	RT0: albedo (RGBA8), RT1: octahedral packed normal (RG16_SNORM),
+	RT2: specular color (RGBA8), and a 32 bit float depth texture.
+*/
+
+#include <GL/glew.h>
+
+#include <stdio.h>
+
+#include "GLResource.hpp"
+
+class GBuffer
+{
+private:
+	FramebufferHandle FBO;
+
+	int width = 0;
+	int height = 0;
+
+	static void createTarget(TextureHandle& target, GLenum internal_format, GLenum format, GLenum type, int w, int h, int bytes_per_texel)
+	{
+		target.Reset(GenTexture(), int64_t(w) * h * bytes_per_texel);
+		glBindTexture(GL_TEXTURE_2D, target);
+		glTexImage2D(GL_TEXTURE_2D, 0, internal_format, w, h, 0, format, type, nullptr);
+		// One texel per pixel, never filtered
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+public:
+	TextureHandle albedoID;
+	TextureHandle normalID;
+	TextureHandle specularID;
+	TextureHandle depthID;
+
+	GBuffer() = default;
+
+	GBuffer(int _width, int _height)
+	{
+		width = _width;
+		height = _height;
+
+		createTarget(albedoID, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height, 4);
+		createTarget(normalID, GL_RG16_SNORM, GL_RG, GL_SHORT, width, height, 4);
+		createTarget(specularID, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height, 4);
+		createTarget(depthID, GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT, width, height, 4);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		FBO.Reset(GenFramebuffer());
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoID, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalID, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, specularID, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthID, 0);
+
+		const GLenum drawBuffers[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+		glDrawBuffers(3, drawBuffers);
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			printf("G-Buffer is not complete!\n");
+
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	void Bind()
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+		glViewport(0, 0, width, height);
+	}
+
+	void UnBind()
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	// Bind the four targets to consecutive texture units, from first_slot
+	void ActiveTargets(unsigned int first_slot) const
+	{
+		const unsigned int targets[4] = { albedoID, normalID, specularID, depthID };
+		for (unsigned int i = 0; i < 4; i++)
+		{
+			glActiveTexture(GL_TEXTURE0 + first_slot + i);
+			glBindTexture(GL_TEXTURE_2D, targets[i]);
+		}
+	}
+
+	int GetWidth() const { return width; }
+	int GetHeight() const { return height; }
+};
\ No newline at end of file
@@ -0,0 +1,247 @@
+#pragma once
+/*
+	Ownership of OpenGL Objects.
+	GLHandle<Type>: move-only owner of one GL name. Its memory is accounted per type.
+	DeletionQueue: released names are deleted once the GPU has finished the frames that may still use them.
+*/
+
+#include <GL/glew.h>
+
+#include <stdio.h>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+enum class ResourceType
+{
+	Texture,
+	Buffer,
+	VertexArray,
+	Program,
+	Framebuffer,
+	Query,
+	Count
+};
+
+static inline const char* ResourceTypeName(ResourceType type)
+{
+	static const char* names[] = { "Texture", "Buffer", "VertexArray", "Program", "Framebuffer", "Query" };
+	return names[int(type)];
+}
+
+// Live objects and their bytes, per type
+class ResourceStats
+{
+private:
+	int64_t counts[int(ResourceType::Count)] = {};
+	int64_t bytes[int(ResourceType::Count)] = {};
+public:
+	void Add(ResourceType type, int64_t size) { counts[int(type)]++; bytes[int(type)] += size; }
+	void Remove(ResourceType type, int64_t size) { counts[int(type)]--; bytes[int(type)] -= size; }
+	void Resize(ResourceType type, int64_t from, int64_t to) { bytes[int(type)] += to - from; }
+
+	int64_t GetCount(ResourceType type) const { return counts[int(type)]; }
+	int64_t GetBytes(ResourceType type) const { return bytes[int(type)]; }
+
+	int64_t GetTotalCount() const
+	{
+		int64_t total = 0;
+		for (int64_t c : counts)
+			total += c;
+		return total;
+	}
+
+	void Print() const
+	{
+		for (int i = 0; i < int(ResourceType::Count); i++)
+			printf("  %-12s %5lld objects %10.2f MB\n", ResourceTypeName(ResourceType(i)), (long long)counts[i], double(bytes[i]) / (1024.0 * 1024.0));
+	}
+};
+
+static inline ResourceStats& GetResourceStats()
+{
+	static ResourceStats stats;
+	return stats;
+}
+
+// Deletes released GL names once the frames that were in flight when they were released are done
+class DeletionQueue
+{
+private:
+	static constexpr int frames_in_flight = 3;
+
+	struct Pending
+	{
+		ResourceType type;
+		unsigned int id;
+	};
+
+	// One batch per frame slot, guarded by the fence of that frame
+	std::vector<Pending> batches[frames_in_flight];
+	GLsync fences[frames_in_flight] = {};
+	unsigned int frame = 0;
+
+	static void destroy(ResourceType type, unsigned int id)
+	{
+		switch (type)
+		{
+		case ResourceType::Texture: glDeleteTextures(1, &id); break;
+		case ResourceType::Buffer: glDeleteBuffers(1, &id); break;
+		case ResourceType::VertexArray: glDeleteVertexArrays(1, &id); break;
+		case ResourceType::Program: glDeleteProgram(id); break;
+		case ResourceType::Framebuffer: glDeleteFramebuffers(1, &id); break;
+		case ResourceType::Query: glDeleteQueries(1, &id); break;
+		default: break;
+		}
+	}
+
+	void destroyBatch(int slot)
+	{
+		for (const Pending& p : batches[slot])
+			destroy(p.type, p.id);
+		batches[slot].clear();
+	}
+public:
+	void Enqueue(ResourceType type, unsigned int id)
+	{
+		batches[frame % frames_in_flight].push_back({ type, id });
+	}
+
+	// Names waiting for their frame to finish on the GPU
+	size_t GetPendingCount() const
+	{
+		size_t count = 0;
+		for (const std::vector<Pending>& batch : batches)
+			count += batch.size();
+		return count;
+	}
+
+	// Call once per frame, after SwapBuffers
+	void EndFrame()
+	{
+		int slot = frame % frames_in_flight;
+		if (fences[slot])
+			glDeleteSync(fences[slot]);
+		fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		frame++;
+
+		// The next slot was fenced frames_in_flight frames ago: wait for it, then free its batch
+		int next = frame % frames_in_flight;
+		if (fences[next])
+		{
+			glClientWaitSync(fences[next], GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(1000000000));
+			glDeleteSync(fences[next]);
+			fences[next] = 0;
+		}
+		destroyBatch(next);
+	}
+
+	// Shutdown: wait for the GPU, then delete everything left
+	void Flush()
+	{
+		glFinish();
+		for (int i = 0; i < frames_in_flight; i++)
+		{
+			destroyBatch(i);
+			if (fences[i])
+			{
+				glDeleteSync(fences[i]);
+				fences[i] = 0;
+			}
+		}
+	}
+};
+
+static inline DeletionQueue& GetDeletionQueue()
+{
+	static DeletionQueue queue;
+	return queue;
+}
+
+// Move-only owner of a GL name
+template<ResourceType Type>
+class GLHandle
+{
+private:
+	unsigned int id = 0;
+	int64_t size = 0;
+public:
+	GLHandle() = default;
+
+	explicit GLHandle(unsigned int _id, int64_t _size = 0)
+	{
+		Reset(_id, _size);
+	}
+
+	~GLHandle()
+	{
+		Release();
+	}
+
+	GLHandle(const GLHandle&) = delete;
+	GLHandle& operator=(const GLHandle&) = delete;
+
+	GLHandle(GLHandle&& other) noexcept
+	{
+		std::swap(id, other.id);
+		std::swap(size, other.size);
+	}
+
+	GLHandle& operator=(GLHandle&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Release();
+			std::swap(id, other.id);
+			std::swap(size, other.size);
+		}
+		return *this;
+	}
+
+	// Take ownership of a new name, releasing the old one
+	void Reset(unsigned int _id, int64_t _size = 0)
+	{
+		Release();
+		id = _id;
+		size = _size;
+		if (id)
+			GetResourceStats().Add(Type, size);
+	}
+
+	// Hand the name to the deletion queue
+	void Release()
+	{
+		if (!id)
+			return;
+		GetResourceStats().Remove(Type, size);
+		GetDeletionQueue().Enqueue(Type, id);
+		id = 0;
+		size = 0;
+	}
+
+	// Bytes of GPU memory behind the name, for the accounting
+	void SetMemorySize(int64_t _size)
+	{
+		if (id)
+			GetResourceStats().Resize(Type, size, _size);
+		size = _size;
+	}
+
+	int64_t GetMemorySize() const { return size; }
+	unsigned int Get() const { return id; }
+	operator unsigned int() const { return id; }
+};
+
+using TextureHandle = GLHandle<ResourceType::Texture>;
+using BufferHandle = GLHandle<ResourceType::Buffer>;
+using VertexArrayHandle = GLHandle<ResourceType::VertexArray>;
+using ProgramHandle = GLHandle<ResourceType::Program>;
+using FramebufferHandle = GLHandle<ResourceType::Framebuffer>;
+using QueryHandle = GLHandle<ResourceType::Query>;
+
+// glGen* for one name
+static inline unsigned int GenTexture() { unsigned int id; glGenTextures(1, &id); return id; }
+static inline unsigned int GenBuffer() { unsigned int id; glGenBuffers(1, &id); return id; }
+static inline unsigned int GenVertexArray() { unsigned int id; glGenVertexArrays(1, &id); return id; }
+static inline unsigned int GenFramebuffer() { unsigned int id; glGenFramebuffers(1, &id); return id; }
+static inline unsigned int GenQuery() { unsigned int id; glGenQueries(1, &id); return id; }
\ No newline at end of file
@@ -0,0 +1,395 @@
+#pragma once
+/*
+	Height Field Processing on the CPU, without OpenGL.
+	Decodes the 24-bit RGB height maps the shaders read, and derives what a renderer
+	wants precomputed: a float pyramid, min/max mips, normals and horizon occlusion.
+	Rows are kept in file order, so row 0 is texture coordinate v = 0, as in the GL texture.
+*/
+
+#include <stdio.h>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <mutex>
+
+#include "BMPReader.hpp"
+
+// Same constants as compute_height in Terrain.tese
+static constexpr float terrain_y_scale = 0.00002f;
+static constexpr float terrain_y_shift = -50.0f;
+// Highest height the 24-bit RGB encoding can give
+static constexpr float terrain_y_max = terrain_y_scale * float(0xFFFFFF) + terrain_y_shift;
+
+// compute_height of the shaders, from the bytes of one BMP texel (B, G, R in the file)
+static inline float DecodeHeight(unsigned char r, unsigned char g, unsigned char b)
+{
+	return terrain_y_scale * float((int(r) << 16) + (int(g) << 8) + int(b)) + terrain_y_shift;
+}
+
+// 24-bit RGB code of a height, as compute_height reads it back
+static inline unsigned int EncodeHeight(float height)
+{
+	double code = std::floor((double(height) - double(terrain_y_shift)) / double(terrain_y_scale) + 0.5);
+	return (unsigned int)std::min(std::max(code, 0.0), double(0xFFFFFF));
+}
+
+// Texel rectangle [x0, x1) x [y0, y1)
+struct TexelRect
+{
+	int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+
+	bool Empty() const { return x1 <= x0 || y1 <= y0; }
+	int Width() const { return x1 - x0; }
+	int Height() const { return y1 - y0; }
+
+	TexelRect Grown(int texels) const { return { x0 - texels, y0 - texels, x1 + texels, y1 + texels }; }
+
+	TexelRect Clipped(int width, int height) const
+	{
+		return { std::max(x0, 0), std::max(y0, 0), std::min(x1, width), std::min(y1, height) };
+	}
+
+	TexelRect Union(const TexelRect& other) const
+	{
+		if (Empty()) return other;
+		if (other.Empty()) return *this;
+		return { std::min(x0, other.x0), std::min(y0, other.y0), std::max(x1, other.x1), std::max(y1, other.y1) };
+	}
+};
+
+// Where the n_points x n_points grid mesh of main.cpp samples the height map.
+// Vertex i sits at x = scale * i - scale * n_points / 2 and reads u = (i + 0.5) / (n_points - 1), same along z and v.
+struct TerrainMapping
+{
+	float uvPerWorld = 1.0f;
+	float uvOffset = 0.0f;
+	int width = 1;
+	int height = 1;
+
+	TerrainMapping() = default;
+
+	TerrainMapping(int n_points, float scale, int _width, int _height)
+	{
+		uvPerWorld = 1.0f / (scale * float(n_points - 1));
+		uvOffset = (float(n_points) * 0.5f + 0.5f) / float(n_points - 1);
+		width = _width;
+		height = _height;
+	}
+
+	// Continuous texel coordinates: texel (i, j) covers [i, i + 1) x [j, j + 1)
+	float WorldToTexelX(float x) const { return (x * uvPerWorld + uvOffset) * float(width); }
+	float WorldToTexelY(float z) const { return (z * uvPerWorld + uvOffset) * float(height); }
+	float TexelToWorldX(float tx) const { return (tx / float(width) - uvOffset) / uvPerWorld; }
+	float TexelToWorldZ(float ty) const { return (ty / float(height) - uvOffset) / uvPerWorld; }
+
+	// World units between two texel centers, along x
+	float Spacing() const { return 1.0f / (uvPerWorld * float(width)); }
+
+	// Texels read by the world rectangle [x0, x1] x [z0, z1]
+	TexelRect WorldToTexels(float x0, float z0, float x1, float z1) const
+	{
+		return { (int)std::floor(WorldToTexelX(x0)), (int)std::floor(WorldToTexelY(z0)),
+			(int)std::floor(WorldToTexelX(x1)) + 1, (int)std::floor(WorldToTexelY(z1)) + 1 };
+	}
+};
+
+// Heights of a rectangle of the map, with an apron of halo texels around it
+struct HeightGrid
+{
+	int width = 0;
+	int height = 0;
+	std::vector<float> heights;
+
+	void Resize(int w, int h)
+	{
+		width = w;
+		height = h;
+		heights.assign(size_t(w) * h, 0.0f);
+	}
+
+	float& At(int x, int y) { return heights[size_t(y) * width + x]; }
+	float At(int x, int y) const { return heights[size_t(y) * width + x]; }
+
+	float Clamped(int x, int y) const
+	{
+		x = std::min(std::max(x, 0), width - 1);
+		y = std::min(std::max(y, 0), height - 1);
+		return heights[size_t(y) * width + x];
+	}
+
+	float Bilinear(float x, float y) const
+	{
+		int x0 = (int)std::floor(x);
+		int y0 = (int)std::floor(y);
+		float fx = x - float(x0);
+		float fy = y - float(y0);
+		float top = Clamped(x0, y0) + (Clamped(x0 + 1, y0) - Clamped(x0, y0)) * fx;
+		float bottom = Clamped(x0, y0 + 1) + (Clamped(x0 + 1, y0 + 1) - Clamped(x0, y0 + 1)) * fx;
+		return top + (bottom - top) * fy;
+	}
+};
+
+// 64 bit file offsets, maps of 16k and more go past 2 GB
+static inline int SeekFile(FILE* file, int64_t offset)
+{
+#ifdef _WIN32
+	return _fseeki64(file, offset, SEEK_SET);
+#else
+	return fseeko(file, (off_t)offset, SEEK_SET);
+#endif
+}
+
+// Random access to the texels of a 24-bit BMP height map, without loading it whole
+class HeightmapSource
+{
+private:
+	std::string path;
+	int width = 0;
+	int height = 0;
+	unsigned int dataPos = 0;
+	size_t stride = 0;
+public:
+	bool Open(const char* _path)
+	{
+		path = _path;
+		FILE* file = fopen(_path, "rb");
+		if (!file)
+		{
+			printf("%s could not be opened. Are you in the right directory ? !\n", _path);
+			return false;
+		}
+
+		unsigned int imageSize;
+		bool ok = readBMP_header(file, width, height, dataPos, imageSize);
+		fclose(file);
+		if (!ok)
+			return false;
+
+		// Rows are padded to 4 bytes, unless the file says it is smaller than that
+		stride = (size_t(width) * 3 + 3) & ~size_t(3);
+		if (imageSize < stride * height)
+			stride = size_t(width) * 3;
+		return true;
+	}
+
+	// Decode the rectangle [x0, x0 + w) x [y0, y0 + h). Outside the map, the edge texels repeat.
+	// Every call opens its own file, so threads can read at the same time.
+	bool ReadRegion(int x0, int y0, int w, int h, HeightGrid& out) const
+	{
+		FILE* file = fopen(path.c_str(), "rb");
+		if (!file)
+			return false;
+
+		out.Resize(w, h);
+		int readX0 = std::max(x0, 0);
+		int readX1 = std::min(x0 + w, width);
+		std::vector<unsigned char> row(size_t(readX1 - readX0) * 3);
+		bool ok = true;
+		for (int y = 0; y < h && ok; y++)
+		{
+			int fileRow = std::min(std::max(y0 + y, 0), height - 1);
+			SeekFile(file, int64_t(dataPos) + int64_t(fileRow) * int64_t(stride) + int64_t(readX0) * 3);
+			ok = fread(row.data(), 1, row.size(), file) == row.size();
+			for (int x = 0; x < w; x++)
+			{
+				int fileX = std::min(std::max(x0 + x, readX0), readX1 - 1) - readX0;
+				const unsigned char* bgr = &row[size_t(fileX) * 3];
+				out.At(x, y) = DecodeHeight(bgr[2], bgr[1], bgr[0]);
+			}
+		}
+		fclose(file);
+		if (!ok)
+			printf("%s is truncated\n", path.c_str());
+		return ok;
+	}
+
+	int GetWidth() const { return width; }
+	int GetHeight() const { return height; }
+};
+
+// Half size, rounded up. The last odd row and column reduce what they have.
+static inline int HalfSize(int size)
+{
+	return std::max(1, (size + 1) / 2);
+}
+
+// 2x2 reduction of the pyramid. A box filter rounds off ridges and fills valleys a little more at
+// every level; ridge moves the result towards the extreme of the footprint that stands out from
+// the mean, so crests and drainage lines survive down the chain. 0: box filter, 1: keep the extreme.
+static inline void DownsampleHeights(const HeightGrid& src, float ridge, HeightGrid& dst)
+{
+	dst.Resize(HalfSize(src.width), HalfSize(src.height));
+	for (int y = 0; y < dst.height; y++)
+	{
+		for (int x = 0; x < dst.width; x++)
+		{
+			int sx1 = std::min(2 * x + 1, src.width - 1);
+			int sy1 = std::min(2 * y + 1, src.height - 1);
+			float a = src.At(2 * x, 2 * y), b = src.At(sx1, 2 * y);
+			float c = src.At(2 * x, sy1), d = src.At(sx1, sy1);
+
+			float mean = 0.25f * (a + b + c + d);
+			float lo = std::min(std::min(a, b), std::min(c, d));
+			float hi = std::max(std::max(a, b), std::max(c, d));
+			float extreme = (hi - mean > mean - lo) ? hi : lo;
+			dst.At(x, y) = mean + ridge * (extreme - mean);
+		}
+	}
+}
+
+// 2x2 reduction of min/max mips. Exact, so they stay conservative for culling and ray marching.
+static inline void ReduceMinMax(const HeightGrid& srcMin, const HeightGrid& srcMax, HeightGrid& dstMin, HeightGrid& dstMax)
+{
+	dstMin.Resize(HalfSize(srcMin.width), HalfSize(srcMin.height));
+	dstMax.Resize(dstMin.width, dstMin.height);
+	for (int y = 0; y < dstMin.height; y++)
+	{
+		for (int x = 0; x < dstMin.width; x++)
+		{
+			int sx1 = std::min(2 * x + 1, srcMin.width - 1);
+			int sy1 = std::min(2 * y + 1, srcMin.height - 1);
+			dstMin.At(x, y) = std::min(std::min(srcMin.At(2 * x, 2 * y), srcMin.At(sx1, 2 * y)), std::min(srcMin.At(2 * x, sy1), srcMin.At(sx1, sy1)));
+			dstMax.At(x, y) = std::max(std::max(srcMax.At(2 * x, 2 * y), srcMax.At(sx1, 2 * y)), std::max(srcMax.At(2 * x, sy1), srcMax.At(sx1, sy1)));
+		}
+	}
+}
+
+// World space normal of texel (x, y), central differences. spacing: world units between texels.
+static inline void HeightNormal(const HeightGrid& grid, int x, int y, float spacing, float normal[3])
+{
+	float dx = (grid.Clamped(x + 1, y) - grid.Clamped(x - 1, y)) / (2.0f * spacing);
+	float dz = (grid.Clamped(x, y + 1) - grid.Clamped(x, y - 1)) / (2.0f * spacing);
+	float length = std::sqrt(dx * dx + 1.0f + dz * dz);
+	normal[0] = -dx / length;
+	normal[1] = 1.0f / length;
+	normal[2] = -dz / length;
+}
+
+// Horizon based ambient occlusion of texel (x, y): in every direction, march out to radius texels
+// and keep the highest elevation angle. Returns the visible part of the sky, 1 on open ground.
+static inline float HorizonVisibility(const HeightGrid& grid, int x, int y, float spacing, int directions, int radius)
+{
+	const float h0 = grid.At(x, y);
+	float occlusion = 0.0f;
+	for (int d = 0; d < directions; d++)
+	{
+		float angle = 6.2831853f * (float(d) + 0.5f) / float(directions);
+		float dirX = std::cos(angle), dirY = std::sin(angle);
+
+		// Flat horizon at least: the ground below the texel never occludes
+		float maxTan = 0.0f;
+		// Dense steps near the texel, sparser further out
+		for (float dist = 1.0f; dist <= float(radius); dist = std::max(dist + 1.0f, dist * 1.15f))
+		{
+			float h = grid.Bilinear(float(x) + dirX * dist, float(y) + dirY * dist);
+			maxTan = std::max(maxTan, (h - h0) / (dist * spacing));
+		}
+		// Sine of the horizon angle
+		occlusion += maxTan / std::sqrt(1.0f + maxTan * maxTan);
+	}
+	return 1.0f - occlusion / float(directions);
+}
+
+// Raster files written by the tools, read back by the renderer.
+// Header, then rows in file order (row 0 is v = 0), channels interleaved.
+enum class RasterFormat : uint32_t { Float32 = 0, UNorm8 = 1 };
+
+struct RasterHeader
+{
+	uint32_t magic = 0x4648544C; // "LTHF"
+	uint32_t version = 1;
+	int32_t width = 0;
+	int32_t height = 0;
+	int32_t channels = 1;
+	RasterFormat format = RasterFormat::Float32;
+};
+
+static inline size_t RasterTexelBytes(const RasterHeader& header)
+{
+	return size_t(header.channels) * (header.format == RasterFormat::Float32 ? 4 : 1);
+}
+
+// Raster file written one region at a time, from any thread
+class RasterWriter
+{
+private:
+	FILE* file = nullptr;
+	RasterHeader header;
+	std::mutex mutex;
+public:
+	RasterWriter() = default;
+	RasterWriter(const RasterWriter&) = delete;
+	RasterWriter& operator=(const RasterWriter&) = delete;
+
+	~RasterWriter()
+	{
+		if (file)
+			fclose(file);
+	}
+
+	bool Open(const std::string& path, int width, int height, int channels, RasterFormat format)
+	{
+		header.width = width;
+		header.height = height;
+		header.channels = channels;
+		header.format = format;
+
+		file = fopen(path.c_str(), "wb");
+		if (!file)
+		{
+			printf("Could not write %s\n", path.c_str());
+			return false;
+		}
+		fwrite(&header, sizeof(header), 1, file);
+
+		// Full size up front, regions land anywhere
+		int64_t bytes = int64_t(width) * height * RasterTexelBytes(header);
+		if (bytes > 0)
+		{
+			unsigned char zero = 0;
+			SeekFile(file, int64_t(sizeof(header)) + bytes - 1);
+			fwrite(&zero, 1, 1, file);
+		}
+		return true;
+	}
+
+	// w x h texels, tightly packed, at (x0, y0)
+	void WriteRegion(int x0, int y0, int w, int h, const void* data)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		size_t texel = RasterTexelBytes(header);
+		const unsigned char* bytes = (const unsigned char*)data;
+		for (int y = 0; y < h; y++)
+		{
+			SeekFile(file, int64_t(sizeof(header)) + (int64_t(y0 + y) * header.width + x0) * int64_t(texel));
+			fwrite(bytes + size_t(y) * w * texel, texel, w, file);
+		}
+	}
+
+	const RasterHeader& GetHeader() const { return header; }
+};
+
+// Whole raster in memory: small levels, or the renderer side
+static inline bool ReadRaster(const char* path, RasterHeader& header, std::vector<unsigned char>& out_data)
+{
+	FILE* file = fopen(path, "rb");
+	if (!file)
+	{
+		printf("%s could not be opened. Are you in the right directory ? !\n", path);
+		return false;
+	}
+
+	RasterHeader expected;
+	bool ok = fread(&header, sizeof(header), 1, file) == 1 && header.magic == expected.magic && header.version == expected.version;
+	if (ok)
+	{
+		out_data.resize(size_t(header.width) * header.height * RasterTexelBytes(header));
+		ok = fread(out_data.data(), 1, out_data.size(), file) == out_data.size();
+	}
+	fclose(file);
+	if (!ok)
+		printf("%s is not a valid raster file\n", path);
+	return ok;
+}
\ No newline at end of file
@@ -0,0 +1,209 @@
+#pragma once
+/*
+	Horizon Based Ambient Occlusion, baked once for the static terrain.
+	Every texel looks for its highest horizon in a fixed set of directions; what is left of the sky is its
+	ambient visibility. The sample offsets are the same for every texel, so the fast path shades four texels
+	of a row at once with SSE2, on every core. HorizonVisibility in Heightfield.hpp is the reference.
+*/
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+#include "Heightfield.hpp"
+#include "Parallel.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HORIZON_BAKER_SSE2 1
+#endif
+
+struct HorizonSettings
+{
+	int directions = 16;
+	// Search distance, in texels
+	int radius = 32;
+	// World units between two texels
+	float spacing = 1.0f;
+};
+
+// Bilinear sample offsets of every direction, in the order HorizonVisibility walks them
+struct HorizonKernel
+{
+	struct Step
+	{
+		int ox, oy;
+		float fx, fy;
+		float invDistance;
+	};
+
+	std::vector<Step> steps;
+	std::vector<int> directionEnd;
+	// Texels a sample can reach around its texel
+	int apron = 1;
+
+	void Build(const HorizonSettings& settings)
+	{
+		steps.clear();
+		directionEnd.clear();
+		apron = 1;
+		for (int d = 0; d < settings.directions; d++)
+		{
+			float angle = 6.2831853f * (float(d) + 0.5f) / float(settings.directions);
+			float dirX = std::cos(angle), dirY = std::sin(angle);
+			for (float dist = 1.0f; dist <= float(settings.radius); dist = std::max(dist + 1.0f, dist * 1.15f))
+			{
+				Step step;
+				float px = dirX * dist, py = dirY * dist;
+				step.ox = (int)std::floor(px);
+				step.oy = (int)std::floor(py);
+				step.fx = px - float(step.ox);
+				step.fy = py - float(step.oy);
+				step.invDistance = 1.0f / (dist * settings.spacing);
+				steps.push_back(step);
+				apron = std::max(apron, std::max(std::abs(step.ox), std::abs(step.oy)) + 1);
+			}
+			directionEnd.push_back((int)steps.size());
+		}
+	}
+};
+
+// Visibility of count texels of row y, from x. The grid needs kernel.apron texels around them.
+static inline void HorizonVisibilityRow(const HeightGrid& grid, int x, int y, int count, const HorizonKernel& kernel, float* out)
+{
+	const int stride = grid.width;
+	const int directions = (int)kernel.directionEnd.size();
+	const float invDirections = 1.0f / float(directions);
+	int i = 0;
+
+#ifdef HORIZON_BAKER_SSE2
+	const __m128 one = _mm_set1_ps(1.0f);
+	for (; i + 4 <= count; i += 4)
+	{
+		const float* center = &grid.heights[size_t(y) * stride + x + i];
+		const __m128 h0 = _mm_loadu_ps(center);
+		__m128 occlusion = _mm_setzero_ps();
+
+		int s = 0;
+		for (int d = 0; d < directions; d++)
+		{
+			// Flat horizon at least
+			__m128 maxTan = _mm_setzero_ps();
+			for (; s < kernel.directionEnd[d]; s++)
+			{
+				const HorizonKernel::Step& step = kernel.steps[s];
+				const float* p = center + step.oy * stride + step.ox;
+				const __m128 fx = _mm_set1_ps(step.fx);
+				__m128 a = _mm_loadu_ps(p), b = _mm_loadu_ps(p + 1);
+				__m128 c = _mm_loadu_ps(p + stride), e = _mm_loadu_ps(p + stride + 1);
+				__m128 top = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), fx));
+				__m128 bottom = _mm_add_ps(c, _mm_mul_ps(_mm_sub_ps(e, c), fx));
+				__m128 h = _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), _mm_set1_ps(step.fy)));
+				maxTan = _mm_max_ps(maxTan, _mm_mul_ps(_mm_sub_ps(h, h0), _mm_set1_ps(step.invDistance)));
+			}
+			// Sine of the horizon angle
+			occlusion = _mm_add_ps(occlusion, _mm_div_ps(maxTan, _mm_sqrt_ps(_mm_add_ps(one, _mm_mul_ps(maxTan, maxTan)))));
+		}
+		_mm_storeu_ps(out + i, _mm_sub_ps(one, _mm_mul_ps(occlusion, _mm_set1_ps(invDirections))));
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		const float* center = &grid.heights[size_t(y) * stride + x + i];
+		const float h0 = center[0];
+		float occlusion = 0.0f;
+
+		int s = 0;
+		for (int d = 0; d < directions; d++)
+		{
+			float maxTan = 0.0f;
+			for (; s < kernel.directionEnd[d]; s++)
+			{
+				const HorizonKernel::Step& step = kernel.steps[s];
+				const float* p = center + step.oy * stride + step.ox;
+				float top = p[0] + (p[1] - p[0]) * step.fx;
+				float bottom = p[stride] + (p[stride + 1] - p[stride]) * step.fx;
+				float h = top + (bottom - top) * step.fy;
+				maxTan = std::max(maxTan, (h - h0) * step.invDistance);
+			}
+			occlusion += maxTan / std::sqrt(1.0f + maxTan * maxTan);
+		}
+		out[i] = 1.0f - occlusion * invDirections;
+	}
+}
+
+// Copy rect of the grid with an apron around it. Outside the grid, the edge texels repeat.
+static inline void PadRegion(const HeightGrid& src, const TexelRect& rect, int apron, HeightGrid& out)
+{
+	out.Resize(rect.Width() + 2 * apron, rect.Height() + 2 * apron);
+	for (int y = 0; y < out.height; y++)
+		for (int x = 0; x < out.width; x++)
+			out.At(x, y) = src.Clamped(rect.x0 - apron + x, rect.y0 - apron + y);
+}
+
+// Ambient visibility of every texel of a height field, as unorm8. Ready for an R8 texture.
+class HorizonMap
+{
+private:
+	HorizonSettings settings;
+	HorizonKernel kernel;
+
+	int width = 0;
+	int height = 0;
+	std::vector<unsigned char> visibility;
+public:
+	HorizonMap() = default;
+
+	HorizonMap(const HorizonSettings& _settings)
+	{
+		settings = _settings;
+		kernel.Build(settings);
+	}
+
+	// Whole map
+	void Bake(const HeightGrid& heights)
+	{
+		width = heights.width;
+		height = heights.height;
+		visibility.assign(size_t(width) * height, 255);
+		Update(heights, { 0, 0, width, height });
+	}
+
+	// Heights changed inside dirty: every texel whose search radius reaches it gets a new horizon.
+	// Returns the texels rewritten.
+	TexelRect Update(const HeightGrid& heights, const TexelRect& dirty)
+	{
+		TexelRect rect = dirty.Grown(kernel.apron).Clipped(width, height);
+		if (rect.Empty())
+			return rect;
+
+		HeightGrid padded;
+		PadRegion(heights, rect, kernel.apron, padded);
+
+		// A band of rows per item: long rows keep the SIMD loop busy
+		const int rows_per_item = 4;
+		const int items = (rect.Height() + rows_per_item - 1) / rows_per_item;
+		ParallelFor(items, [&](int item)
+		{
+			std::vector<float> row(rect.Width());
+			int yEnd = std::min(rect.Height(), (item + 1) * rows_per_item);
+			for (int y = item * rows_per_item; y < yEnd; y++)
+			{
+				HorizonVisibilityRow(padded, kernel.apron, kernel.apron + y, rect.Width(), kernel, row.data());
+				unsigned char* dst = &visibility[size_t(rect.y0 + y) * width + rect.x0];
+				for (int x = 0; x < rect.Width(); x++)
+					dst[x] = (unsigned char)std::min(std::max(int(row[x] * 255.0f + 0.5f), 0), 255);
+			}
+		});
+		return rect;
+	}
+
+	const HorizonSettings& GetSettings() const { return settings; }
+	const HorizonKernel& GetKernel() const { return kernel; }
+	int GetWidth() const { return width; }
+	int GetHeight() const { return height; }
+	const unsigned char* GetData() const { return visibility.data(); }
+	unsigned char At(int x, int y) const { return visibility[size_t(y) * width + x]; }
+};
\ No newline at end of file
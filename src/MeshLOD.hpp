@@ -0,0 +1,771 @@
+#pragma once
+/*
+	Level of Detail Chains for Triangle Meshes.
+	Quadric error edge collapse (Garland and Heckbert 1997) removes vertices but never moves them, so
+	every level is only an index list into the same vertex buffer. Each list is reordered for the
+	post-transform vertex cache (Forsyth's linear speed optimizer), then the vertices for fetch locality.
+	At draw time, the coarsest level whose error stays under a pixel on screen is picked.
+*/
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <queue>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+
+struct Mesh
+{
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+	std::vector<unsigned int> indices;
+};
+
+// Merge identical corners: OBJ files come with one vertex per corner
+static inline void WeldVertices(Mesh& mesh)
+{
+	struct Key
+	{
+		float v[8];
+		bool operator==(const Key& o) const { return memcmp(v, o.v, sizeof(v)) == 0; }
+	};
+	struct KeyHash
+	{
+		size_t operator()(const Key& k) const
+		{
+			uint32_t bits[8];
+			memcpy(bits, k.v, sizeof(bits));
+			size_t h = 0;
+			for (uint32_t b : bits)
+				h = (h ^ b) * 16777619u;
+			return h;
+		}
+	};
+
+	std::unordered_map<Key, unsigned int, KeyHash> unique;
+	std::vector<unsigned int> remap(mesh.positions.size());
+	Mesh welded;
+	for (size_t i = 0; i < mesh.positions.size(); i++)
+	{
+		glm::vec2 uv = i < mesh.uvs.size() ? mesh.uvs[i] : glm::vec2(0.0f);
+		glm::vec3 n = i < mesh.normals.size() ? mesh.normals[i] : glm::vec3(0.0f);
+		Key key = { { mesh.positions[i].x, mesh.positions[i].y, mesh.positions[i].z, uv.x, uv.y, n.x, n.y, n.z } };
+		auto found = unique.find(key);
+		if (found == unique.end())
+		{
+			found = unique.emplace(key, (unsigned int)welded.positions.size()).first;
+			welded.positions.push_back(mesh.positions[i]);
+			welded.uvs.push_back(uv);
+			welded.normals.push_back(n);
+		}
+		remap[i] = found->second;
+	}
+	for (unsigned int index : mesh.indices)
+		welded.indices.push_back(remap[index]);
+	mesh = std::move(welded);
+}
+
+// Sum of squared distances to a set of planes, weighted by their triangle areas
+struct Quadric
+{
+	// Upper half of the symmetric 4x4 matrix: a2 ab ac ad b2 bc bd c2 cd d2
+	double q[10] = {};
+	double weight = 0.0;
+
+	static Quadric FromPlane(const glm::vec3& n, float d, double w)
+	{
+		Quadric r;
+		const double a = n.x, b = n.y, c = n.z, e = d;
+		const double m[10] = { a * a, a * b, a * c, a * e, b * b, b * c, b * e, c * c, c * e, e * e };
+		for (int i = 0; i < 10; i++)
+			r.q[i] = m[i] * w;
+		r.weight = w;
+		return r;
+	}
+
+	void Add(const Quadric& o)
+	{
+		for (int i = 0; i < 10; i++)
+			q[i] += o.q[i];
+		weight += o.weight;
+	}
+
+	// Mean squared distance of p to the planes
+	double Error(const glm::vec3& p) const
+	{
+		const double x = p.x, y = p.y, z = p.z;
+		double e = q[0] * x * x + 2.0 * q[1] * x * y + 2.0 * q[2] * x * z + 2.0 * q[3] * x
+			+ q[4] * y * y + 2.0 * q[5] * y * z + 2.0 * q[6] * y
+			+ q[7] * z * z + 2.0 * q[8] * z + q[9];
+		return weight > 0.0 ? std::max(e, 0.0) / weight : 0.0;
+	}
+};
+
+// Collapse edges of a triangle list until it has at most target_index_count indices, or the next
+// collapse would move the surface more than max_error. Vertices on open borders and on attribute
+// seams stay put. Returns the kept triangles; out_error gets the largest error accepted.
+static inline std::vector<unsigned int> SimplifyMesh(const Mesh& mesh, const std::vector<unsigned int>& indices, size_t target_index_count, float max_error, float* out_error = nullptr)
+{
+	const size_t vertexCount = mesh.positions.size();
+	const size_t triangleCount = indices.size() / 3;
+	std::vector<unsigned int> tris(indices.begin(), indices.begin() + triangleCount * 3);
+	if (out_error)
+		*out_error = 0.0f;
+
+	// Vertices at the same position share their topology
+	std::vector<unsigned int> position(vertexCount);
+	std::vector<int> wedges(vertexCount, 0);
+	{
+		struct PositionHash
+		{
+			size_t operator()(const glm::vec3& p) const
+			{
+				uint32_t bits[3];
+				memcpy(bits, &p.x, sizeof(bits));
+				return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+			}
+		};
+		std::unordered_map<glm::vec3, unsigned int, PositionHash> first;
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			auto found = first.emplace(mesh.positions[v], (unsigned int)v).first;
+			position[v] = found->second;
+			wedges[found->second]++;
+		}
+	}
+
+	// Locked: on a seam (several wedges), or on an open border (an edge without its opposite)
+	std::vector<bool> locked(vertexCount, false);
+	for (size_t v = 0; v < vertexCount; v++)
+		locked[v] = wedges[position[v]] > 1;
+	{
+		std::unordered_map<uint64_t, int> halfEdges;
+		auto key = [](unsigned int a, unsigned int b) { return (uint64_t(a) << 32) | b; };
+		for (size_t t = 0; t < triangleCount; t++)
+			for (int k = 0; k < 3; k++)
+				halfEdges[key(position[tris[t * 3 + k]], position[tris[t * 3 + (k + 1) % 3]])]++;
+		for (const auto& edge : halfEdges)
+		{
+			unsigned int a = (unsigned int)(edge.first >> 32), b = (unsigned int)(edge.first & 0xffffffffu);
+			if (halfEdges.find(key(b, a)) == halfEdges.end())
+				locked[a] = locked[b] = true;
+		}
+	}
+	for (size_t v = 0; v < vertexCount; v++)
+		if (locked[position[v]])
+			locked[v] = true;
+
+	// Quadrics of the triangle planes, and the triangles around every vertex
+	std::vector<Quadric> quadrics(vertexCount);
+	std::vector<std::vector<unsigned int>> around(vertexCount);
+	std::vector<bool> dead(triangleCount, false);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		const glm::vec3& p0 = mesh.positions[tris[t * 3]];
+		const glm::vec3 e = glm::cross(mesh.positions[tris[t * 3 + 1]] - p0, mesh.positions[tris[t * 3 + 2]] - p0);
+		const float area2 = glm::length(e);
+		if (area2 > 0.0f)
+		{
+			const glm::vec3 n = e / area2;
+			Quadric plane = Quadric::FromPlane(n, -glm::dot(n, p0), 0.5 * area2);
+			for (int k = 0; k < 3; k++)
+				quadrics[position[tris[t * 3 + k]]].Add(plane);
+		}
+		for (int k = 0; k < 3; k++)
+			around[tris[t * 3 + k]].push_back((unsigned int)t);
+	}
+	// Seam wedges share the quadric of their position
+	for (size_t v = 0; v < vertexCount; v++)
+		quadrics[v] = quadrics[position[v]];
+
+	// Would moving from onto to flip or squash a triangle that stays?
+	auto canCollapse = [&](unsigned int from, unsigned int to)
+	{
+		if (locked[from])
+			return false;
+		// Link condition: the only shared neighbors are the opposite corners of the shared triangles
+		int shared = 0, sharedTriangles = 0;
+		std::vector<unsigned int> fromNeighbors;
+		for (unsigned int t : around[from])
+		{
+			if (dead[t])
+				continue;
+			bool hasTo = false;
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int v = tris[t * 3 + k];
+				hasTo = hasTo || v == to;
+				if (v != from && std::find(fromNeighbors.begin(), fromNeighbors.end(), position[v]) == fromNeighbors.end())
+					fromNeighbors.push_back(position[v]);
+			}
+			if (hasTo)
+			{
+				sharedTriangles++;
+				continue;
+			}
+
+			glm::vec3 p[3], q[3];
+			for (int k = 0; k < 3; k++)
+			{
+				p[k] = mesh.positions[tris[t * 3 + k]];
+				q[k] = tris[t * 3 + k] == from ? mesh.positions[to] : p[k];
+			}
+			glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+			glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+			if (glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after))
+				return false;
+		}
+		std::vector<unsigned int> toNeighbors;
+		for (unsigned int t : around[to])
+		{
+			if (dead[t])
+				continue;
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int v = tris[t * 3 + k];
+				if (v != to && std::find(toNeighbors.begin(), toNeighbors.end(), position[v]) == toNeighbors.end())
+					toNeighbors.push_back(position[v]);
+			}
+		}
+		// Neighbors by position, so wedges across a seam count once
+		for (unsigned int v : fromNeighbors)
+			if (v != position[to] && std::find(toNeighbors.begin(), toNeighbors.end(), v) != toNeighbors.end())
+				shared++;
+		return sharedTriangles > 0 && shared == sharedTriangles;
+	};
+
+	struct Collapse
+	{
+		double cost;
+		unsigned int from, to;
+		unsigned int fromVersion, toVersion;
+		bool operator<(const Collapse& o) const { return cost > o.cost; }
+	};
+	std::priority_queue<Collapse> queue;
+	std::vector<unsigned int> version(vertexCount, 0);
+
+	// The cheaper direction of an edge, if either may move. Seam wedges only receive.
+	auto pushEdge = [&](unsigned int a, unsigned int b)
+	{
+		Quadric q = quadrics[a];
+		q.Add(quadrics[b]);
+		double costToB = locked[a] || wedges[position[b]] > 1 ? 1e30 : q.Error(mesh.positions[b]);
+		double costToA = locked[b] || wedges[position[a]] > 1 ? 1e30 : q.Error(mesh.positions[a]);
+		if (costToB < costToA)
+			queue.push({ costToB, a, b, version[a], version[b] });
+		else if (costToA < 1e30)
+			queue.push({ costToA, b, a, version[b], version[a] });
+	};
+
+	for (size_t t = 0; t < triangleCount; t++)
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int a = tris[t * 3 + k], b = tris[t * 3 + (k + 1) % 3];
+			if (a < b)
+				pushEdge(a, b);
+		}
+
+	const double maxCost = double(max_error) * double(max_error);
+	size_t liveTriangles = triangleCount;
+	while (liveTriangles * 3 > target_index_count && !queue.empty())
+	{
+		Collapse c = queue.top();
+		queue.pop();
+		if (c.fromVersion != version[c.from] || c.toVersion != version[c.to])
+			continue;
+		if (c.cost > maxCost)
+			break;
+		if (!canCollapse(c.from, c.to))
+			continue;
+
+		for (unsigned int t : around[c.from])
+		{
+			if (dead[t])
+				continue;
+			bool hasTo = tris[t * 3] == c.to || tris[t * 3 + 1] == c.to || tris[t * 3 + 2] == c.to;
+			if (hasTo)
+			{
+				dead[t] = true;
+				liveTriangles--;
+				continue;
+			}
+			for (int k = 0; k < 3; k++)
+				if (tris[t * 3 + k] == c.from)
+					tris[t * 3 + k] = c.to;
+			around[c.to].push_back(t);
+		}
+		around[c.from].clear();
+		quadrics[c.to].Add(quadrics[c.from]);
+		version[c.from]++;
+		version[c.to]++;
+		if (out_error)
+			*out_error = std::max(*out_error, (float)std::sqrt(c.cost));
+
+		// Fresh costs for the edges around the vertex that grew
+		for (unsigned int t : around[c.to])
+		{
+			if (dead[t])
+				continue;
+			for (int k = 0; k < 3; k++)
+				if (tris[t * 3 + k] != c.to)
+					pushEdge(c.to, tris[t * 3 + k]);
+		}
+	}
+
+	std::vector<unsigned int> result;
+	result.reserve(liveTriangles * 3);
+	for (size_t t = 0; t < triangleCount; t++)
+		if (!dead[t])
+			result.insert(result.end(), tris.begin() + t * 3, tris.begin() + t * 3 + 3);
+	return result;
+}
+
+// Reorder triangles so that recently transformed vertices are reused (Forsyth, "Linear-Speed Vertex Cache Optimisation")
+static inline void OptimizeVertexCache(std::vector<unsigned int>& indices, size_t vertex_count)
+{
+	static constexpr int cache_size = 32;
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+		return;
+
+	auto vertexScore = [](int cache_position, int remaining)
+	{
+		if (remaining == 0)
+			return -1.0f;
+		float score = 0.0f;
+		if (cache_position >= 0)
+			score = cache_position < 3 ? 0.75f : std::pow(1.0f - float(cache_position - 3) / float(cache_size - 3), 1.5f);
+		return score + 2.0f / std::sqrt(float(remaining));
+	};
+
+	// Triangles of every vertex, as ranges of one array
+	std::vector<unsigned int> offsets(vertex_count + 1, 0);
+	for (unsigned int v : indices)
+		offsets[v + 1]++;
+	for (size_t v = 0; v < vertex_count; v++)
+		offsets[v + 1] += offsets[v];
+	std::vector<unsigned int> vertexTriangles(indices.size());
+	std::vector<int> remaining(vertex_count, 0);
+	for (size_t t = 0; t < triangleCount; t++)
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int v = indices[t * 3 + k];
+			vertexTriangles[offsets[v] + remaining[v]++] = (unsigned int)t;
+		}
+
+	std::vector<float> score(vertex_count);
+	std::vector<int> cachePosition(vertex_count, -1);
+	for (size_t v = 0; v < vertex_count; v++)
+		score[v] = vertexScore(-1, remaining[v]);
+	std::vector<float> triangleScore(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++)
+		triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<unsigned int> result;
+	result.reserve(indices.size());
+	std::vector<unsigned int> cache, nextCache;
+	size_t scan = 0;
+	int best = -1;
+
+	for (size_t done = 0; done < triangleCount; done++)
+	{
+		// Nothing in the cache has triangles left: next one in the input order
+		if (best < 0)
+		{
+			while (emitted[scan])
+				scan++;
+			best = (int)scan;
+		}
+
+		emitted[best] = true;
+		nextCache.clear();
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int v = indices[best * 3 + k];
+			result.push_back(v);
+			nextCache.push_back(v);
+
+			// Drop the triangle from the vertex's list
+			unsigned int* begin = &vertexTriangles[offsets[v]];
+			unsigned int* end = begin + remaining[v];
+			*std::find(begin, end, (unsigned int)best) = *(end - 1);
+			remaining[v]--;
+		}
+		for (unsigned int v : cache)
+			if (std::find(nextCache.begin(), nextCache.end(), v) == nextCache.end())
+				nextCache.push_back(v);
+
+		// Vertices pushed out of the cache lose their position score
+		for (size_t i = 0; i < nextCache.size(); i++)
+		{
+			unsigned int v = nextCache[i];
+			cachePosition[v] = i < (size_t)cache_size ? (int)i : -1;
+			score[v] = vertexScore(cachePosition[v], remaining[v]);
+		}
+		if (nextCache.size() > (size_t)cache_size)
+			nextCache.resize(cache_size);
+		std::swap(cache, nextCache);
+
+		// Best triangle around the cache
+		best = -1;
+		float bestScore = -1.0f;
+		for (unsigned int v : cache)
+		{
+			for (int i = 0; i < remaining[v]; i++)
+			{
+				unsigned int t = vertexTriangles[offsets[v] + i];
+				triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+				if (triangleScore[t] > bestScore)
+				{
+					bestScore = triangleScore[t];
+					best = (int)t;
+				}
+			}
+		}
+	}
+	indices = std::move(result);
+}
+
+// Average vertices transformed per triangle with a FIFO post-transform cache
+static inline float ComputeACMR(const std::vector<unsigned int>& indices, size_t vertex_count, int cache_size = 16)
+{
+	if (indices.empty())
+		return 0.0f;
+	std::vector<int64_t> stamp(vertex_count, -1000000);
+	int64_t misses = 0;
+	for (unsigned int v : indices)
+	{
+		// In the cache while fewer than cache_size misses happened since it was loaded
+		if (misses - stamp[v] > cache_size)
+		{
+			stamp[v] = misses;
+			misses++;
+		}
+	}
+	return float(misses) / float(indices.size() / 3);
+}
+
+// Vertices in order of first use in the lists, so each list walks the vertex buffer forward
+static inline void OptimizeVertexFetch(Mesh& mesh, std::vector<std::vector<unsigned int>*>& index_lists)
+{
+	const unsigned int unused = ~0u;
+	std::vector<unsigned int> remap(mesh.positions.size(), unused);
+	unsigned int next = 0;
+	for (std::vector<unsigned int>* list : index_lists)
+		for (unsigned int v : *list)
+			if (remap[v] == unused)
+				remap[v] = next++;
+
+	Mesh out;
+	out.positions.resize(next);
+	out.uvs.resize(next);
+	out.normals.resize(next);
+	for (size_t v = 0; v < remap.size(); v++)
+	{
+		if (remap[v] == unused)
+			continue;
+		out.positions[remap[v]] = mesh.positions[v];
+		out.uvs[remap[v]] = v < mesh.uvs.size() ? mesh.uvs[v] : glm::vec2(0.0f);
+		out.normals[remap[v]] = v < mesh.normals.size() ? mesh.normals[v] : glm::vec3(0.0f);
+	}
+	for (std::vector<unsigned int>* list : index_lists)
+		for (unsigned int& v : *list)
+			v = remap[v];
+	mesh.positions = std::move(out.positions);
+	mesh.uvs = std::move(out.uvs);
+	mesh.normals = std::move(out.normals);
+}
+
+// Distance from p to the triangle abc (Ericson, Real-Time Collision Detection 5.1.5)
+static inline float PointTriangleDistance(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+	glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+	float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+	if (d1 <= 0.0f && d2 <= 0.0f) return glm::length(p - a);
+	glm::vec3 bp = p - b;
+	float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+	if (d3 >= 0.0f && d4 <= d3) return glm::length(p - b);
+	float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return glm::length(p - (a + ab * (d1 / (d1 - d3))));
+	glm::vec3 cp = p - c;
+	float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+	if (d6 >= 0.0f && d5 <= d6) return glm::length(p - c);
+	float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return glm::length(p - (a + ac * (d2 / (d2 - d6))));
+	float va = d3 * d6 - d5 * d4;
+	if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) return glm::length(p - (b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)))));
+	float denom = 1.0f / (va + vb + vc);
+	return glm::length(p - (a + ab * (vb * denom) + ac * (vc * denom)));
+}
+
+// Largest distance of the vertices of the full mesh to the nearest triangle of a level: how far the
+// surface really moved. The triangles go into a grid, each vertex searches rings of cells around
+// its own until the next ring cannot hold anything nearer.
+static inline float MeasureDeviation(const Mesh& mesh, const std::vector<unsigned int>& indices)
+{
+	const size_t triangles = indices.size() / 3;
+	if (triangles == 0 || mesh.positions.empty())
+		return 0.0f;
+
+	glm::vec3 lo = mesh.positions[0], hi = mesh.positions[0];
+	for (const glm::vec3& p : mesh.positions)
+	{
+		lo = glm::min(lo, p);
+		hi = glm::max(hi, p);
+	}
+	// Cells a few triangles wide on a closed surface, at most 64^3 of them
+	const int cells = std::min(std::max((int)(3.0 * std::cbrt(double(triangles))), 1), 64);
+	const glm::vec3 size = glm::max(hi - lo, glm::vec3(1e-6f));
+	const float cellSize = std::max(std::max(size.x, size.y), size.z) / float(cells);
+	glm::ivec3 dims;
+	for (int k = 0; k < 3; k++)
+		dims[k] = std::min(std::max((int)std::ceil(size[k] / cellSize), 1), cells);
+	auto cellOf = [&](const glm::vec3& p)
+	{
+		glm::ivec3 c;
+		for (int k = 0; k < 3; k++)
+			c[k] = std::min(std::max((int)((p[k] - lo[k]) / cellSize), 0), dims[k] - 1);
+		return c;
+	};
+
+	// Triangles by cell, each in every cell its bounds touch
+	std::vector<std::vector<unsigned int>> grid(size_t(dims.x) * dims.y * dims.z);
+	for (unsigned int t = 0; t < triangles; t++)
+	{
+		const glm::vec3& a = mesh.positions[indices[t * 3]];
+		const glm::vec3& b = mesh.positions[indices[t * 3 + 1]];
+		const glm::vec3& c = mesh.positions[indices[t * 3 + 2]];
+		glm::ivec3 c0 = cellOf(glm::min(glm::min(a, b), c)), c1 = cellOf(glm::max(glm::max(a, b), c));
+		for (int z = c0.z; z <= c1.z; z++)
+			for (int y = c0.y; y <= c1.y; y++)
+				for (int x = c0.x; x <= c1.x; x++)
+					grid[(size_t(z) * dims.y + y) * dims.x + x].push_back(t);
+	}
+
+	std::vector<bool> kept(mesh.positions.size(), false);
+	for (unsigned int v : indices)
+		kept[v] = true;
+	// Last vertex that tested a triangle, so a triangle in several cells is tested once
+	std::vector<unsigned int> stamp(triangles, ~0u);
+	const int maxRing = std::max(std::max(dims.x, dims.y), dims.z);
+	float deviation = 0.0f;
+	for (unsigned int v = 0; v < mesh.positions.size(); v++)
+	{
+		if (kept[v])
+			continue;
+		const glm::vec3& p = mesh.positions[v];
+		const glm::ivec3 home = cellOf(p);
+		float nearest = 1e30f;
+		// Anything outside ring r is at least r cells away
+		for (int r = 0; r <= maxRing && nearest > float(r - 1) * cellSize; r++)
+		{
+			for (int z = std::max(home.z - r, 0); z <= std::min(home.z + r, dims.z - 1); z++)
+			{
+				for (int y = std::max(home.y - r, 0); y <= std::min(home.y + r, dims.y - 1); y++)
+				{
+					for (int x = std::max(home.x - r, 0); x <= std::min(home.x + r, dims.x - 1); x++)
+					{
+						// The shell of the ring only, the inside was searched before
+						if (std::max(std::max(std::abs(x - home.x), std::abs(y - home.y)), std::abs(z - home.z)) != r)
+							continue;
+						for (unsigned int t : grid[(size_t(z) * dims.y + y) * dims.x + x])
+						{
+							if (stamp[t] == v)
+								continue;
+							stamp[t] = v;
+							nearest = std::min(nearest, PointTriangleDistance(p, mesh.positions[indices[t * 3]],
+								mesh.positions[indices[t * 3 + 1]], mesh.positions[indices[t * 3 + 2]]));
+						}
+					}
+				}
+			}
+		}
+		deviation = std::max(deviation, nearest);
+	}
+	return deviation;
+}
+
+struct MeshLevel
+{
+	// Range of MeshLODChain::mesh.indices
+	unsigned int firstIndex;
+	unsigned int count;
+	// Largest distance of the full mesh's vertices to this level's surface, in model units (MeasureDeviation)
+	float error;
+	// Post-transform cache misses per triangle
+	float acmr;
+};
+
+struct MeshLODChain
+{
+	// Vertices shared by every level; indices of all the levels, one after another
+	Mesh mesh;
+	std::vector<MeshLevel> levels;
+	// Bounding sphere, in model units
+	glm::vec3 center = glm::vec3(0.0f);
+	float radius = 0.0f;
+	// Cache misses per triangle of level 0 before the reordering
+	float sourceAcmr = 0.0f;
+};
+
+struct LODSettings
+{
+	// Each level keeps this fraction of the triangles of the previous one
+	float reduction = 0.5f;
+	int maxLevels = 6;
+	// Stop when a level would have fewer triangles
+	size_t minTriangles = 32;
+	// Stop collapsing past this quadric error, relative to the bounding radius
+	float maxRelativeError = 0.1f;
+};
+
+// Weld, simplify every level from the full mesh (so errors do not pile up), then optimize for the GPU
+static inline MeshLODChain BuildLODChain(Mesh mesh, const LODSettings& settings = LODSettings())
+{
+	MeshLODChain chain;
+	WeldVertices(mesh);
+	if (mesh.positions.empty())
+		return chain;
+
+	glm::vec3 lo = mesh.positions[0], hi = mesh.positions[0];
+	for (const glm::vec3& p : mesh.positions)
+	{
+		lo = glm::min(lo, p);
+		hi = glm::max(hi, p);
+	}
+	chain.center = 0.5f * (lo + hi);
+	for (const glm::vec3& p : mesh.positions)
+		chain.radius = std::max(chain.radius, glm::length(p - chain.center));
+
+	std::vector<std::vector<unsigned int>> lists = { mesh.indices };
+	std::vector<float> errors = { 0.0f };
+	chain.sourceAcmr = ComputeACMR(mesh.indices, mesh.positions.size());
+	size_t target = mesh.indices.size();
+	for (int level = 1; level < settings.maxLevels; level++)
+	{
+		target = size_t(float(target) * settings.reduction) / 3 * 3;
+		if (target / 3 < settings.minTriangles)
+			break;
+		std::vector<unsigned int> simplified = SimplifyMesh(mesh, mesh.indices, target, settings.maxRelativeError * chain.radius);
+		// Stuck on locked vertices or the error limit
+		if (simplified.size() > lists.back().size() * 9 / 10)
+			break;
+		target = simplified.size();
+		// The quadric error is a mean over the planes around a vertex, so it is measured again: the pixel
+		// test of SelectLOD needs the largest distance
+		errors.push_back(MeasureDeviation(mesh, simplified));
+		lists.push_back(std::move(simplified));
+	}
+
+	// Coarsest level first: every level then reads a prefix of the vertex buffer
+	std::vector<std::vector<unsigned int>*> order;
+	for (std::vector<unsigned int>& list : lists)
+		OptimizeVertexCache(list, mesh.positions.size());
+	for (size_t l = lists.size(); l-- > 0;)
+		order.push_back(&lists[l]);
+	OptimizeVertexFetch(mesh, order);
+
+	chain.mesh.positions = std::move(mesh.positions);
+	chain.mesh.uvs = std::move(mesh.uvs);
+	chain.mesh.normals = std::move(mesh.normals);
+	for (size_t l = 0; l < lists.size(); l++)
+	{
+		MeshLevel level = { (unsigned int)chain.mesh.indices.size(), (unsigned int)lists[l].size(), errors[l],
+			ComputeACMR(lists[l], chain.mesh.positions.size()) };
+		chain.mesh.indices.insert(chain.mesh.indices.end(), lists[l].begin(), lists[l].end());
+		chain.levels.push_back(level);
+	}
+	return chain;
+}
+
+// Coarsest level whose error covers at most max_pixels on screen. pixels_per_unit: pixels covered by
+// one world unit at distance 1 (viewport height / (2 tan(fov / 2))).
+static inline int SelectLOD(const MeshLODChain& chain, float scale, float distance, float pixels_per_unit, float max_pixels = 1.0f)
+{
+	const float unitPixels = pixels_per_unit * scale / std::max(distance, 1e-3f);
+	int level = 0;
+	while (level + 1 < (int)chain.levels.size() && chain.levels[level + 1].error * unitPixels <= max_pixels)
+		level++;
+	return level;
+}
+
+// A lumpy rock: an icosphere pushed in and out by value noise, for when no model file is around
+static inline Mesh MakeRockMesh(int subdivisions, uint32_t seed)
+{
+	const float t = (1.0f + std::sqrt(5.0f)) * 0.5f;
+	std::vector<glm::vec3> points = {
+		{ -1, t, 0 }, { 1, t, 0 }, { -1, -t, 0 }, { 1, -t, 0 }, { 0, -1, t }, { 0, 1, t },
+		{ 0, -1, -t }, { 0, 1, -t }, { t, 0, -1 }, { t, 0, 1 }, { -t, 0, -1 }, { -t, 0, 1 } };
+	std::vector<unsigned int> faces = {
+		0, 11, 5, 0, 5, 1, 0, 1, 7, 0, 7, 10, 0, 10, 11, 1, 5, 9, 5, 11, 4, 11, 10, 2, 10, 7, 6, 7, 1, 8,
+		3, 9, 4, 3, 4, 2, 3, 2, 6, 3, 6, 8, 3, 8, 9, 4, 9, 5, 2, 4, 11, 6, 2, 10, 8, 6, 7, 9, 8, 1 };
+	for (glm::vec3& p : points)
+		p = glm::normalize(p);
+
+	for (int s = 0; s < subdivisions; s++)
+	{
+		std::unordered_map<uint64_t, unsigned int> middles;
+		auto middle = [&](unsigned int a, unsigned int b)
+		{
+			uint64_t key = (uint64_t(std::min(a, b)) << 32) | std::max(a, b);
+			auto found = middles.find(key);
+			if (found != middles.end())
+				return found->second;
+			points.push_back(glm::normalize(points[a] + points[b]));
+			middles.emplace(key, (unsigned int)points.size() - 1);
+			return (unsigned int)points.size() - 1;
+		};
+		std::vector<unsigned int> next;
+		for (size_t f = 0; f < faces.size(); f += 3)
+		{
+			unsigned int a = faces[f], b = faces[f + 1], c = faces[f + 2];
+			unsigned int ab = middle(a, b), bc = middle(b, c), ca = middle(c, a);
+			unsigned int split[12] = { a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca };
+			next.insert(next.end(), split, split + 12);
+		}
+		faces = std::move(next);
+	}
+
+	// Smooth noise on the sphere: a few random bumps of decreasing size
+	auto random = [&seed]() { seed = seed * 1664525u + 1013904223u; return float(seed >> 8) / 16777216.0f; };
+	std::vector<glm::vec4> bumps;
+	for (int i = 0; i < 24; i++)
+	{
+		glm::vec3 d = glm::normalize(glm::vec3(random() - 0.5f, random() - 0.5f, random() - 0.5f) + glm::vec3(1e-4f));
+		bumps.push_back(glm::vec4(d, 0.15f + 0.5f * random() / (1.0f + float(i) * 0.2f)));
+	}
+
+	Mesh mesh;
+	for (const glm::vec3& p : points)
+	{
+		float r = 1.0f;
+		for (const glm::vec4& bump : bumps)
+		{
+			float c = glm::dot(p, glm::vec3(bump));
+			r += bump.w * 0.3f * std::max(c - 0.6f, 0.0f) * 2.5f;
+		}
+		// Flatter underneath, so the rock sits on the ground
+		glm::vec3 q = p * r;
+		q.y = q.y < 0.0f ? q.y * 0.5f : q.y * 0.8f;
+		mesh.positions.push_back(q);
+	}
+	mesh.indices = faces;
+
+	// Smooth normals from the faces
+	mesh.normals.assign(mesh.positions.size(), glm::vec3(0.0f));
+	for (size_t f = 0; f < faces.size(); f += 3)
+	{
+		glm::vec3 n = glm::cross(mesh.positions[faces[f + 1]] - mesh.positions[faces[f]], mesh.positions[faces[f + 2]] - mesh.positions[faces[f]]);
+		for (int k = 0; k < 3; k++)
+			mesh.normals[faces[f + k]] += n;
+	}
+	for (glm::vec3& n : mesh.normals)
+		n = glm::normalize(n);
+	mesh.uvs.assign(mesh.positions.size(), glm::vec2(0.0f));
+	return mesh;
+}
\ No newline at end of file
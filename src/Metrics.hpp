@@ -0,0 +1,472 @@
+#pragma once
+/*
+	Runtime Metrics: counters, gauges and histograms in one registry.
+	Recording is an add or a store on a plain field behind one branch on the enabled flag: nothing is
+	locked, allocated or looked up by name per frame, and nothing is recorded while disabled. Once per
+	interval the registry takes a snapshot (counter rates, gauge values, histogram percentiles over the
+	interval), which the overlay shows and the exporter writes as CSV rows or JSON lines, to a file or
+	to a local UDP socket.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <cmath>
+#include <deque>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#ifdef _WIN32
+// winsock2.h pulls in windows.h: keep its min and max macros out of std::min and std::max
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#endif
+
+enum class MetricKind
+{
+	Counter,
+	Gauge,
+	Histogram
+};
+
+// Only ever goes up. The snapshot turns it into a rate.
+class Counter
+{
+private:
+	friend class MetricsRegistry;
+	const bool* enabled;
+	uint64_t total = 0;
+	uint64_t intervalStart = 0;
+public:
+	std::string name;
+	std::string unit;
+
+	Counter(const bool* _enabled, const char* _name, const char* _unit) : enabled(_enabled), name(_name), unit(_unit) {}
+
+	void Add(uint64_t n = 1) { if (*enabled) total += n; }
+	uint64_t GetTotal() const { return total; }
+};
+
+// Latest value wins
+class Gauge
+{
+private:
+	const bool* enabled;
+	double value = 0.0;
+public:
+	std::string name;
+	std::string unit;
+
+	Gauge(const bool* _enabled, const char* _name, const char* _unit) : enabled(_enabled), name(_name), unit(_unit) {}
+
+	void Set(double v) { if (*enabled) value = v; }
+	double GetValue() const { return value; }
+};
+
+// Distribution over the current interval: 8 linear buckets per power of two (at most 12.5% wide),
+// from 2^-10 to 2^22 of the unit. Values outside clamp to the first or last bucket.
+class Histogram
+{
+public:
+	static constexpr int min_exponent = -10;
+	static constexpr int max_exponent = 22;
+	static constexpr int sub_buckets = 8;
+	static constexpr int bucket_count = (max_exponent - min_exponent) * sub_buckets;
+private:
+	const bool* enabled;
+	uint32_t buckets[bucket_count] = {};
+	uint64_t count = 0;
+	double sum = 0.0;
+	double minimum = 0.0;
+	double maximum = 0.0;
+
+	// frexp splits v into m * 2^e with m in [0.5, 1): the exponent picks the octave, the mantissa the sub bucket
+	static int bucketOf(double v)
+	{
+		if (!(v > 0.0))
+			return 0;
+		int e;
+		double m = std::frexp(v, &e);
+		int index = (e - 1 - min_exponent) * sub_buckets + int((m - 0.5) * 2.0 * sub_buckets);
+		return std::min(std::max(index, 0), bucket_count - 1);
+	}
+
+	static double lowerBound(int index)
+	{
+		return std::ldexp(1.0 + double(index % sub_buckets) / sub_buckets, index / sub_buckets + min_exponent);
+	}
+public:
+	std::string name;
+	std::string unit;
+
+	Histogram(const bool* _enabled, const char* _name, const char* _unit) : enabled(_enabled), name(_name), unit(_unit) {}
+
+	void Record(double v)
+	{
+		if (!*enabled)
+			return;
+		buckets[bucketOf(v)]++;
+		minimum = count ? std::min(minimum, v) : v;
+		maximum = count ? std::max(maximum, v) : v;
+		count++;
+		sum += v;
+	}
+
+	uint64_t GetCount() const { return count; }
+	double GetMean() const { return count ? sum / double(count) : 0.0; }
+	double GetMin() const { return minimum; }
+	double GetMax() const { return maximum; }
+
+	// Value under which a fraction p of the samples fall, interpolated inside its bucket
+	double Percentile(double p) const
+	{
+		if (count == 0)
+			return 0.0;
+		double rank = p * double(count);
+		uint64_t seen = 0;
+		for (int i = 0; i < bucket_count; i++)
+		{
+			if (buckets[i] == 0)
+				continue;
+			if (double(seen + buckets[i]) >= rank)
+			{
+				double t = (rank - double(seen)) / double(buckets[i]);
+				double lo = lowerBound(i), hi = lowerBound(i + 1);
+				return std::min(std::max(lo + (hi - lo) * t, minimum), maximum);
+			}
+			seen += buckets[i];
+		}
+		return maximum;
+	}
+
+	void Reset()
+	{
+		memset(buckets, 0, sizeof(buckets));
+		count = 0;
+		sum = 0.0;
+		minimum = maximum = 0.0;
+	}
+};
+
+// One metric at the end of an interval
+struct MetricSample
+{
+	const std::string* name;
+	const std::string* unit;
+	MetricKind kind;
+	// Counter: per second over the interval. Gauge: the value. Histogram: the mean.
+	double value;
+	// Counter: since the start. Histogram: samples in the interval.
+	double total;
+	// Histogram only
+	double p50, p95, p99, max;
+};
+
+class MetricsRegistry
+{
+private:
+	// Deques keep the addresses the callers hold on to
+	std::deque<Counter> counters;
+	std::deque<Gauge> gauges;
+	std::deque<Histogram> histograms;
+
+	bool enabled = false;
+	double intervalStart = 0.0;
+	double snapshotTime = 0.0;
+	std::vector<MetricSample> snapshot;
+public:
+	MetricsRegistry() = default;
+	MetricsRegistry(const MetricsRegistry&) = delete;
+	MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+	// Find by name, or create. Call once at startup and keep the reference.
+	Counter& GetCounter(const char* name, const char* unit = "")
+	{
+		for (Counter& c : counters)
+			if (c.name == name)
+				return c;
+		counters.emplace_back(&enabled, name, unit);
+		return counters.back();
+	}
+
+	Gauge& GetGauge(const char* name, const char* unit = "")
+	{
+		for (Gauge& g : gauges)
+			if (g.name == name)
+				return g;
+		gauges.emplace_back(&enabled, name, unit);
+		return gauges.back();
+	}
+
+	Histogram& GetHistogram(const char* name, const char* unit = "")
+	{
+		for (Histogram& h : histograms)
+			if (h.name == name)
+				return h;
+		histograms.emplace_back(&enabled, name, unit);
+		return histograms.back();
+	}
+
+	bool IsEnabled() const { return enabled; }
+
+	// The interval restarts, so the first snapshot does not count the time spent disabled
+	void SetEnabled(bool _enabled, double now)
+	{
+		if (_enabled && !enabled)
+		{
+			intervalStart = now;
+			for (Counter& c : counters)
+				c.intervalStart = c.total;
+			for (Histogram& h : histograms)
+				h.Reset();
+		}
+		enabled = _enabled;
+	}
+
+	// Close the interval when it is interval seconds old. Returns true when a new snapshot was taken.
+	bool Snapshot(double now, double interval)
+	{
+		if (!enabled || now - intervalStart < interval)
+			return false;
+
+		const double seconds = std::max(now - intervalStart, 1e-6);
+		snapshot.clear();
+		for (Counter& c : counters)
+		{
+			snapshot.push_back({ &c.name, &c.unit, MetricKind::Counter, double(c.total - c.intervalStart) / seconds, double(c.total), 0.0, 0.0, 0.0, 0.0 });
+			c.intervalStart = c.total;
+		}
+		for (Gauge& g : gauges)
+			snapshot.push_back({ &g.name, &g.unit, MetricKind::Gauge, g.GetValue(), 0.0, 0.0, 0.0, 0.0, 0.0 });
+		for (Histogram& h : histograms)
+		{
+			snapshot.push_back({ &h.name, &h.unit, MetricKind::Histogram, h.GetMean(), double(h.GetCount()),
+				h.Percentile(0.5), h.Percentile(0.95), h.Percentile(0.99), h.GetMax() });
+			h.Reset();
+		}
+		intervalStart = now;
+		snapshotTime = now;
+		return true;
+	}
+
+	const std::vector<MetricSample>& GetSnapshot() const { return snapshot; }
+	double GetSnapshotTime() const { return snapshotTime; }
+};
+
+static inline MetricsRegistry& GetMetrics()
+{
+	static MetricsRegistry registry;
+	return registry;
+}
+
+// Writes every snapshot as one CSV row (a header first, again whenever the metrics change) or one JSON line.
+// Targets: "file.csv", "file.json" / "file.jsonl", or "udp:127.0.0.1:8125" for JSON lines, one datagram each.
+class MetricsExporter
+{
+private:
+	enum class Format { Csv, Json };
+
+	FILE* file = nullptr;
+#ifdef _WIN32
+	SOCKET sock = INVALID_SOCKET;
+#else
+	int sock = -1;
+#endif
+	sockaddr_in address = {};
+	Format format = Format::Json;
+	std::string header;
+	std::string line;
+
+	void appendNumber(double v)
+	{
+		char buffer[32];
+		// JSON has no NaN or infinity
+		snprintf(buffer, sizeof(buffer), "%.6g", std::isfinite(v) ? v : 0.0);
+		line += buffer;
+	}
+
+	void buildCsv(double time, const std::vector<MetricSample>& samples)
+	{
+		std::string columns = "time";
+		line.clear();
+		appendNumber(time);
+		for (const MetricSample& s : samples)
+		{
+			if (s.kind == MetricKind::Histogram)
+			{
+				static const char* stats[] = { "mean", "count", "p50", "p95", "p99", "max" };
+				const double values[] = { s.value, s.total, s.p50, s.p95, s.p99, s.max };
+				for (int i = 0; i < 6; i++)
+				{
+					columns += "," + *s.name + "." + stats[i];
+					line += ",";
+					appendNumber(values[i]);
+				}
+			}
+			else if (s.kind == MetricKind::Counter)
+			{
+				columns += "," + *s.name + ".rate," + *s.name + ".total";
+				line += ",";
+				appendNumber(s.value);
+				line += ",";
+				appendNumber(s.total);
+			}
+			else
+			{
+				columns += "," + *s.name;
+				line += ",";
+				appendNumber(s.value);
+			}
+		}
+		line += "\n";
+		if (columns != header)
+		{
+			header = columns;
+			line = header + "\n" + line;
+		}
+	}
+
+	void buildJson(double time, const std::vector<MetricSample>& samples)
+	{
+		line = "{\"time\":";
+		appendNumber(time);
+		for (const MetricSample& s : samples)
+		{
+			line += ",\"" + *s.name + "\":";
+			if (s.kind == MetricKind::Histogram)
+			{
+				line += "{\"mean\":"; appendNumber(s.value);
+				line += ",\"count\":"; appendNumber(s.total);
+				line += ",\"p50\":"; appendNumber(s.p50);
+				line += ",\"p95\":"; appendNumber(s.p95);
+				line += ",\"p99\":"; appendNumber(s.p99);
+				line += ",\"max\":"; appendNumber(s.max);
+				line += "}";
+			}
+			else if (s.kind == MetricKind::Counter)
+			{
+				line += "{\"rate\":"; appendNumber(s.value);
+				line += ",\"total\":"; appendNumber(s.total);
+				line += "}";
+			}
+			else
+				appendNumber(s.value);
+		}
+		line += "}\n";
+	}
+public:
+	MetricsExporter() = default;
+	MetricsExporter(const MetricsExporter&) = delete;
+	MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+	~MetricsExporter()
+	{
+		Close();
+	}
+
+	bool Open(const char* target)
+	{
+		Close();
+		if (!strncmp(target, "udp:", 4))
+		{
+			char host[64] = {};
+			int port = 0;
+			const char* colon = strrchr(target + 4, ':');
+			if (!colon || colon - (target + 4) >= (int)sizeof(host) || (port = atoi(colon + 1)) <= 0)
+			{
+				printf("Metrics: expected udp:host:port, got %s\n", target);
+				return false;
+			}
+			memcpy(host, target + 4, colon - (target + 4));
+#ifdef _WIN32
+			WSADATA wsa;
+			WSAStartup(MAKEWORD(2, 2), &wsa);
+#endif
+			address.sin_family = AF_INET;
+			address.sin_port = htons((unsigned short)port);
+			if (inet_pton(AF_INET, host, &address.sin_addr) != 1)
+			{
+				printf("Metrics: %s is not an IPv4 address\n", host);
+				return false;
+			}
+			sock = socket(AF_INET, SOCK_DGRAM, 0);
+			format = Format::Json;
+#ifdef _WIN32
+			return sock != INVALID_SOCKET;
+#else
+			return sock >= 0;
+#endif
+		}
+
+		file = fopen(target, "w");
+		if (!file)
+		{
+			printf("Metrics: %s could not be opened\n", target);
+			return false;
+		}
+		const char* extension = strrchr(target, '.');
+		format = extension && !strcmp(extension, ".csv") ? Format::Csv : Format::Json;
+		header.clear();
+		return true;
+	}
+
+	bool IsOpen() const
+	{
+#ifdef _WIN32
+		return file || sock != INVALID_SOCKET;
+#else
+		return file || sock >= 0;
+#endif
+	}
+
+	void Write(double time, const std::vector<MetricSample>& samples)
+	{
+		if (file)
+		{
+			if (format == Format::Csv)
+				buildCsv(time, samples);
+			else
+				buildJson(time, samples);
+			fwrite(line.data(), 1, line.size(), file);
+			// A soak run can be killed at any time: every line is on disk once written
+			fflush(file);
+		}
+		else if (IsOpen())
+		{
+			buildJson(time, samples);
+			sendto(sock, line.data(), (int)line.size(), 0, (const sockaddr*)&address, sizeof(address));
+		}
+	}
+
+	void Close()
+	{
+		if (file)
+			fclose(file);
+		file = nullptr;
+#ifdef _WIN32
+		if (sock != INVALID_SOCKET)
+		{
+			closesocket(sock);
+			WSACleanup();
+		}
+		sock = INVALID_SOCKET;
+#else
+		if (sock >= 0)
+			close(sock);
+		sock = -1;
+#endif
+	}
+};
\ No newline at end of file
@@ -0,0 +1,355 @@
+#pragma once
+/*
+	Occlusion Culling against a Software Rasterized Heightfield.
+	A coarse copy of the terrain is rasterized on the CPU, at low resolution, from the camera of the
+	frame. Its vertices take the lowest height their cells can show, so it always stays under the real
+	terrain and only hides what the terrain hides. The depth buffer becomes a Hi-Z pyramid that keeps
+	the farthest depth of every tile, and a box is hidden when its nearest point is behind all of it.
+	No GL in here: it runs, and is checked, headless (tools/OcclusionBench.cpp).
+*/
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "Heightfield.hpp"
+#include "Parallel.hpp"
+
+class OcclusionCuller
+{
+private:
+	// Occluder mesh: gridWidth x gridHeight vertices, cellSize apart, from (originX, originZ)
+	int gridWidth = 0;
+	int gridHeight = 0;
+	float originX = 0.0f;
+	float originZ = 0.0f;
+	float extentX = 0.0f;
+	float extentZ = 0.0f;
+	std::vector<float> gridHeights;
+
+	// Depth pyramid of 1 / w, 0 where nothing was drawn. Level 0 is the raster;
+	// every next level keeps the smallest (farthest) of 2 x 2 texels.
+	int width = 0;
+	int height = 0;
+	std::vector<std::vector<float>> levels;
+	std::vector<int> levelWidths;
+	std::vector<int> levelHeights;
+
+	glm::mat4 viewProjection = glm::mat4(1.0f);
+	std::vector<glm::vec4> clipVertices;
+
+	struct ScreenVertex
+	{
+		double x, y;
+		float invW;
+	};
+
+	// Triangle after clipping and projection, counter-clockwise on screen
+	struct ScreenTriangle
+	{
+		ScreenVertex a, b, c;
+		double area;
+		int y0, y1;
+	};
+	std::vector<ScreenTriangle> triangles;
+
+	// Lowest height the terrain shows around vertex (i, j): its four cells, plus one texel for the sampling
+	float occluderHeight(const HeightGrid& heights, const TerrainMapping& mapping, int i, int j) const
+	{
+		// The mesh edge is where the grid may read outside the map
+		if (i == 0 || j == 0 || i == gridWidth - 1 || j == gridHeight - 1)
+			return terrain_y_shift;
+
+		float x = originX + float(i) * cellSize;
+		float z = originZ + float(j) * cellSize;
+		TexelRect footprint = mapping.WorldToTexels(x - cellSize, z - cellSize, x + cellSize, z + cellSize)
+			.Grown(1).Clipped(heights.width, heights.height);
+		if (footprint.Empty())
+			return terrain_y_shift;
+
+		float lowest = terrain_y_max;
+		for (int y = footprint.y0; y < footprint.y1; y++)
+			for (int tx = footprint.x0; tx < footprint.x1; tx++)
+				lowest = std::min(lowest, heights.At(tx, y));
+		return lowest;
+	}
+
+	// Clip a triangle to w >= near_w: up to 4 vertices
+	int clipNear(const glm::vec4* in, glm::vec4* out) const
+	{
+		int count = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			const glm::vec4& a = in[k];
+			const glm::vec4& b = in[(k + 1) % 3];
+			bool aInside = a.w >= nearW;
+			bool bInside = b.w >= nearW;
+			if (aInside)
+				out[count++] = a;
+			if (aInside != bInside)
+				out[count++] = a + (b - a) * ((nearW - a.w) / (b.w - a.w));
+		}
+		return count;
+	}
+
+	ScreenVertex toScreen(const glm::vec4& c) const
+	{
+		float invW = 1.0f / c.w;
+		return { (double(c.x) * invW * 0.5 + 0.5) * width, (double(c.y) * invW * 0.5 + 0.5) * height, invW };
+	}
+
+	// Project a clipped triangle, drop it when it covers no pixel center
+	void setup(const glm::vec4& p0, const glm::vec4& p1, const glm::vec4& p2)
+	{
+		ScreenTriangle t = { toScreen(p0), toScreen(p1), toScreen(p2), 0.0, 0, 0 };
+		t.area = (t.b.x - t.a.x) * (t.c.y - t.a.y) - (t.b.y - t.a.y) * (t.c.x - t.a.x);
+		if (t.area == 0.0)
+			return;
+		// Both windings are occluders
+		if (t.area < 0.0)
+		{
+			std::swap(t.b, t.c);
+			t.area = -t.area;
+		}
+		t.y0 = std::max((int)std::floor(std::min({ t.a.y, t.b.y, t.c.y })), 0);
+		t.y1 = std::min((int)std::ceil(std::max({ t.a.y, t.b.y, t.c.y })), height - 1);
+		double x0 = std::min({ t.a.x, t.b.x, t.c.x }), x1 = std::max({ t.a.x, t.b.x, t.c.x });
+		if (t.y0 > t.y1 || x1 < 0.0 || x0 > double(width))
+			return;
+		triangles.push_back(t);
+	}
+
+	// Pixel centers inside the triangle, rows [row0, row1): keep the nearest 1 / w
+	void rasterize(const ScreenTriangle& t, int row0, int row1)
+	{
+		const ScreenVertex& a = t.a;
+		const ScreenVertex& b = t.b;
+		const ScreenVertex& c = t.c;
+		int x0 = std::max((int)std::floor(std::min({ a.x, b.x, c.x })), 0);
+		int x1 = std::min((int)std::ceil(std::max({ a.x, b.x, c.x })), width - 1);
+		int y0 = std::max(t.y0, row0);
+		int y1 = std::min(t.y1, row1 - 1);
+
+		// Edge functions, positive inside, stepped along the row; 1 / w is linear in screen space
+		const double inverseArea = 1.0 / t.area;
+		const double stepA = -(c.y - b.y), stepB = -(a.y - c.y);
+		float* depth = levels[0].data();
+		for (int y = y0; y <= y1; y++)
+		{
+			const double py = double(y) + 0.5;
+			const double px = double(x0) + 0.5;
+			double wa = (b.x - px) * (c.y - py) - (b.y - py) * (c.x - px);
+			double wb = (c.x - px) * (a.y - py) - (c.y - py) * (a.x - px);
+			for (int x = x0; x <= x1; x++, wa += stepA, wb += stepB)
+			{
+				double wc = t.area - wa - wb;
+				if (wa < 0.0 || wb < 0.0 || wc < 0.0)
+					continue;
+				float invW = float((wa * a.invW + wb * b.invW + wc * c.invW) * inverseArea);
+				float& d = depth[size_t(y) * width + x];
+				d = std::max(d, invW);
+			}
+		}
+	}
+
+	void buildPyramid()
+	{
+		for (size_t l = 1; l < levels.size(); l++)
+		{
+			const int pw = levelWidths[l - 1], ph = levelHeights[l - 1];
+			const int w = levelWidths[l], h = levelHeights[l];
+			const std::vector<float>& src = levels[l - 1];
+			std::vector<float>& dst = levels[l];
+			for (int y = 0; y < h; y++)
+			{
+				for (int x = 0; x < w; x++)
+				{
+					// Odd sizes: the last texel also takes the row or column left over
+					int sx1 = std::min(2 * x + (x == w - 1 ? 3 : 2), pw);
+					int sy1 = std::min(2 * y + (y == h - 1 ? 3 : 2), ph);
+					float farthest = src[size_t(2 * y) * pw + 2 * x];
+					for (int sy = 2 * y; sy < sy1; sy++)
+						for (int sx = 2 * x; sx < sx1; sx++)
+							farthest = std::min(farthest, src[size_t(sy) * pw + sx]);
+					dst[size_t(y) * w + x] = farthest;
+				}
+			}
+		}
+	}
+public:
+	// World units between occluder vertices
+	float cellSize = 2.0f;
+	// Closest w the raster keeps; boxes that reach it are visible
+	float nearW = 0.1f;
+	// Relative depth margin before a box counts as behind the occluders
+	float depthBias = 0.002f;
+	// Horizontal bands of the raster, one per job
+	int bands = 8;
+
+	OcclusionCuller(int _width = 256, int _height = 128, float cell_size = 2.0f)
+	{
+		cellSize = cell_size;
+		width = std::max(_width, 1);
+		height = std::max(_height, 1);
+		int w = width, h = height;
+		while (true)
+		{
+			levelWidths.push_back(w);
+			levelHeights.push_back(h);
+			levels.emplace_back(size_t(w) * h, 0.0f);
+			if (w == 1 && h == 1)
+				break;
+			w = std::max(w / 2, 1);
+			h = std::max(h / 2, 1);
+		}
+	}
+
+	// Occluder mesh over the world rectangle [x0, x1] x [z0, z1]
+	void Build(const HeightGrid& heights, const TerrainMapping& mapping, float x0, float z0, float x1, float z1)
+	{
+		originX = x0;
+		originZ = z0;
+		extentX = x1;
+		extentZ = z1;
+		gridWidth = (int)std::ceil((x1 - x0) / cellSize) + 1;
+		gridHeight = (int)std::ceil((z1 - z0) / cellSize) + 1;
+		gridHeights.assign(size_t(gridWidth) * gridHeight, terrain_y_shift);
+		Update(heights, mapping, { 0, 0, heights.width, heights.height });
+	}
+
+	// Lower or raise the occluder vertices that can see the dirty texels
+	void Update(const HeightGrid& heights, const TerrainMapping& mapping, const TexelRect& dirty)
+	{
+		for (int j = 0; j < gridHeight; j++)
+		{
+			for (int i = 0; i < gridWidth; i++)
+			{
+				float x = originX + float(i) * cellSize;
+				float z = originZ + float(j) * cellSize;
+				TexelRect footprint = mapping.WorldToTexels(x - cellSize, z - cellSize, x + cellSize, z + cellSize).Grown(1);
+				if (footprint.x1 <= dirty.x0 || footprint.x0 >= dirty.x1 || footprint.y1 <= dirty.y0 || footprint.y0 >= dirty.y1)
+					continue;
+				gridHeights[size_t(j) * gridWidth + i] = occluderHeight(heights, mapping, i, j);
+			}
+		}
+	}
+
+	// Rasterize the occluders from a camera, then build the pyramid
+	void Render(const glm::mat4& view_projection)
+	{
+		viewProjection = view_projection;
+		std::fill(levels[0].begin(), levels[0].end(), 0.0f);
+
+		clipVertices.resize(gridHeights.size());
+		for (int j = 0; j < gridHeight; j++)
+		{
+			for (int i = 0; i < gridWidth; i++)
+			{
+				float x = std::min(originX + float(i) * cellSize, extentX);
+				float z = std::min(originZ + float(j) * cellSize, extentZ);
+				clipVertices[size_t(j) * gridWidth + i] = viewProjection * glm::vec4(x, gridHeights[size_t(j) * gridWidth + i], z, 1.0f);
+			}
+		}
+
+		// Clip and project every cell once
+		triangles.clear();
+		for (int j = 0; j + 1 < gridHeight; j++)
+		{
+			for (int i = 0; i + 1 < gridWidth; i++)
+			{
+				const size_t v = size_t(j) * gridWidth + i;
+				const glm::vec4 quad[4] = { clipVertices[v], clipVertices[v + 1], clipVertices[v + gridWidth + 1], clipVertices[v + gridWidth] };
+
+				// Whole cell outside one clip plane
+				bool outside = false;
+				for (int axis = 0; axis < 2 && !outside; axis++)
+				{
+					bool allBelow = true, allAbove = true;
+					for (const glm::vec4& p : quad)
+					{
+						allBelow = allBelow && p[axis] < -p.w;
+						allAbove = allAbove && p[axis] > p.w;
+					}
+					outside = allBelow || allAbove;
+				}
+				if (outside || (quad[0].w < nearW && quad[1].w < nearW && quad[2].w < nearW && quad[3].w < nearW))
+					continue;
+
+				for (int k = 0; k < 2; k++)
+				{
+					const glm::vec4 triangle[3] = { quad[0], quad[1 + k], quad[2 + k] };
+					glm::vec4 clipped[4];
+					int count = clipNear(triangle, clipped);
+					for (int f = 1; f + 1 < count; f++)
+						setup(clipped[0], clipped[f], clipped[f + 1]);
+				}
+			}
+		}
+
+		// Bands of rows: no two jobs write the same pixel
+		const int bandCount = std::min(std::max(bands, 1), height);
+		ParallelFor(bandCount, [&](int band)
+		{
+			const int row0 = height * band / bandCount;
+			const int row1 = height * (band + 1) / bandCount;
+			for (const ScreenTriangle& t : triangles)
+				if (t.y0 < row1 && t.y1 >= row0)
+					rasterize(t, row0, row1);
+		});
+
+		buildPyramid();
+	}
+
+	// False when the box is behind the occluders over every pixel it could cover, one pixel of margin around it
+	bool IsVisible(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const
+	{
+		double minX = 1e30, minY = 1e30, maxX = -1e30, maxY = -1e30;
+		float nearest = 0.0f;
+		for (int corner = 0; corner < 8; corner++)
+		{
+			glm::vec4 c = viewProjection * glm::vec4(corner & 1 ? boundsMax.x : boundsMin.x, corner & 2 ? boundsMax.y : boundsMin.y, corner & 4 ? boundsMax.z : boundsMin.z, 1.0f);
+			if (c.w < nearW)
+				return true;
+			ScreenVertex s = toScreen(c);
+			minX = std::min(minX, s.x);
+			maxX = std::max(maxX, s.x);
+			minY = std::min(minY, s.y);
+			maxY = std::max(maxY, s.y);
+			// w is linear over the box: its nearest point is a corner
+			nearest = std::max(nearest, s.invW);
+		}
+
+		int x0 = (int)std::floor(std::max(minX, -1.0)) - 1;
+		int x1 = (int)std::floor(std::min(maxX, double(width))) + 1;
+		int y0 = (int)std::floor(std::max(minY, -1.0)) - 1;
+		int y1 = (int)std::floor(std::min(maxY, double(height))) + 1;
+		x0 = std::max(x0, 0);
+		y0 = std::max(y0, 0);
+		x1 = std::min(x1, width - 1);
+		y1 = std::min(y1, height - 1);
+		// Off screen: the frustum test decides
+		if (x0 > x1 || y0 > y1)
+			return true;
+
+		// Coarsest level where the rectangle spans at most 4 x 4 texels
+		size_t level = 0;
+		while (level + 1 < levels.size() && ((x1 >> level) - (x0 >> level) >= 4 || (y1 >> level) - (y0 >> level) >= 4))
+			level++;
+
+		const int w = levelWidths[level], h = levelHeights[level];
+		float farthest = 1e30f;
+		for (int y = std::min(y0 >> level, h - 1); y <= std::min(y1 >> level, h - 1); y++)
+			for (int x = std::min(x0 >> level, w - 1); x <= std::min(x1 >> level, w - 1); x++)
+				farthest = std::min(farthest, levels[level][size_t(y) * w + x]);
+
+		return nearest >= farthest * (1.0f - depthBias);
+	}
+
+	int GetWidth() const { return width; }
+	int GetHeight() const { return height; }
+	int GetTriangleCount() const { return std::max(gridWidth - 1, 0) * std::max(gridHeight - 1, 0) * 2; }
+	// Level 0: 1 / w of the nearest occluder, 0 for none
+	const float* GetDepth() const { return levels[0].data(); }
+};
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+/*
+	Minimal Thread Pool Free Parallel Loop.
+	Workers pull the next item from an atomic counter, so uneven items balance themselves.
+*/
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+
+// Worker count: every hardware thread, at least one
+static inline unsigned int WorkerCount()
+{
+	return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Run body(i) for i in [0, count), on all cores, or on at most max_workers threads
+template<typename Body>
+static inline void ParallelFor(int count, const Body& body, unsigned int max_workers = 0)
+{
+	unsigned int workers = std::min(WorkerCount(), (unsigned int)std::max(count, 1));
+	if (max_workers > 0)
+		workers = std::min(workers, max_workers);
+	if (workers <= 1)
+	{
+		for (int i = 0; i < count; i++)
+			body(i);
+		return;
+	}
+
+	std::atomic<int> next(0);
+	std::vector<std::thread> threads;
+	for (unsigned int w = 0; w < workers; w++)
+	{
+		threads.emplace_back([&next, &body, count]()
+		{
+			for (int i = next++; i < count; i = next++)
+				body(i);
+		});
+	}
+	for (std::thread& t : threads)
+		t.join();
+}
\ No newline at end of file
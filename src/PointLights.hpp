@@ -0,0 +1,100 @@
+#pragma once
+/*
+	Point Lights for the deferred path, and the per tile light lists the culling pass fills.
+	Layouts match the std430 blocks in LightCull.comp and DeferredLighting.frag.
+*/
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <random>
+
+#include "GLResource.hpp"
+
+// Tile size of the light culling pass, in pixels
+static constexpr int light_tile_size = 16;
+// Upper bound of lights one tile can hold
+static constexpr int max_lights_per_tile = 256;
+
+struct PointLight
+{
+	glm::vec4 position_radius;	// xyz: world position, w: radius of influence
+	glm::vec4 color_intensity;	// rgb: color, a: intensity
+};
+
+class PointLights
+{
+private:
+	BufferHandle lightBuffer;
+	BufferHandle tileBuffer;
+
+	int tilesX = 0;
+	int tilesY = 0;
+public:
+	std::vector<PointLight> lights;
+
+	PointLights() = default;
+
+	PointLights(int screen_width, int screen_height)
+	{
+		tilesX = (screen_width + light_tile_size - 1) / light_tile_size;
+		tilesY = (screen_height + light_tile_size - 1) / light_tile_size;
+
+		lightBuffer.Reset(GenBuffer());
+
+		// Per tile: one count, then max_lights_per_tile indices
+		int64_t tileBytes = int64_t(sizeof(unsigned int)) * tilesX * tilesY * (max_lights_per_tile + 1);
+		tileBuffer.Reset(GenBuffer(), tileBytes);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, tileBytes, nullptr, GL_DYNAMIC_COPY);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+
+	// Scatter count lights over the terrain, just above the valleys
+	void Scatter(int count, float half_extent, float y_min, float y_max, unsigned int seed = 1)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> xz(-half_extent, half_extent);
+		std::uniform_real_distribution<float> y(y_min, y_max);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+		lights.clear();
+		for (int i = 0; i < count; i++)
+		{
+			PointLight light;
+			light.position_radius = glm::vec4(xz(rng), y(rng), xz(rng), 4.0f + 6.0f * unit(rng));
+			// Warm street light colors
+			light.color_intensity = glm::vec4(1.0f, 0.6f + 0.3f * unit(rng), 0.3f + 0.3f * unit(rng), 1.5f);
+			lights.push_back(light);
+		}
+		Upload();
+	}
+
+	void Upload()
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, lightBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(PointLight) * lights.size(), lights.empty() ? nullptr : lights.data(), GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		lightBuffer.SetMemorySize(int64_t(sizeof(PointLight) * lights.size()));
+	}
+
+	// Binding 0: lights, binding 1: tile lists
+	void BindBuffers() const
+	{
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, lightBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, tileBuffer);
+	}
+
+	// One work group per tile
+	void DispatchCulling() const
+	{
+		glDispatchCompute(tilesX, tilesY, 1);
+		// Lighting pass reads the tile lists next
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	}
+
+	int GetCount() const { return (int)lights.size(); }
+	int GetTilesX() const { return tilesX; }
+	int GetTilesY() const { return tilesY; }
+};
\ No newline at end of file
@@ -0,0 +1,222 @@
+#pragma once
+/*
+	Props Scattered over the Terrain, each drawn at its own Level of Detail.
+	All the levels of the model share one vertex buffer and one index buffer (see MeshLOD.hpp).
+	Every frame the instances in view get a level from the size of its error on screen, are grouped
+	by level into one instance buffer, and each level is one instanced draw of its index range.
+*/
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <random>
+#include <cstddef>
+#include <algorithm>
+
+#include "MeshLOD.hpp"
+#include "Heightfield.hpp"
+#include "OcclusionCulling.hpp"
+#include "GLResource.hpp"
+
+// One element of the instance buffer, attributes 3 and 4 of Prop.vert
+struct PropInstance
+{
+	glm::vec4 position_scale;	// xyz: world position of the model origin, w: scale
+	glm::vec4 rotation;			// x, y: cosine and sine of the yaw
+};
+
+class Props
+{
+private:
+	MeshLODChain chain;
+
+	VertexArrayHandle VAO;
+	BufferHandle positionBuffer;
+	BufferHandle normalBuffer;
+	BufferHandle indexBuffer;
+	BufferHandle instanceBuffer;
+
+	std::vector<PropInstance> instances;
+
+	// Instances in view of the latest Update, grouped by level
+	std::vector<std::vector<PropInstance>> byLevel;
+	std::vector<PropInstance> sorted;
+	std::vector<int> levelFirst;
+
+	size_t drawnTriangles = 0;
+	size_t fullTriangles = 0;
+
+	// Lowest point of the model, in model units
+	float bottom = 0.0f;
+
+	// Bottom of the model on the ground, a little sunk so slopes leave no gap under it
+	void settle(PropInstance& instance, const HeightGrid& heights, const TerrainMapping& mapping) const
+	{
+		const float x = instance.position_scale.x, z = instance.position_scale.z;
+		const float ground = heights.Bilinear(mapping.WorldToTexelX(x) - 0.5f, mapping.WorldToTexelY(z) - 0.5f);
+		instance.position_scale.y = ground - (bottom + 0.15f * chain.radius) * instance.position_scale.w;
+	}
+public:
+	Props(MeshLODChain _chain) : chain(std::move(_chain))
+	{
+		const Mesh& mesh = chain.mesh;
+		if (!mesh.positions.empty())
+			bottom = std::min_element(mesh.positions.begin(), mesh.positions.end(), [](const glm::vec3& a, const glm::vec3& b) { return a.y < b.y; })->y;
+		VAO.Reset(GenVertexArray());
+
+		// The terrain keeps its VAO bound, so put it back
+		GLint previous = 0;
+		glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previous);
+		glBindVertexArray(VAO);
+
+		positionBuffer.Reset(GenBuffer(), int64_t(mesh.positions.size() * sizeof(glm::vec3)));
+		glBindBuffer(GL_ARRAY_BUFFER, positionBuffer);
+		glBufferData(GL_ARRAY_BUFFER, mesh.positions.size() * sizeof(glm::vec3), mesh.positions.data(), GL_STATIC_DRAW);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+
+		normalBuffer.Reset(GenBuffer(), int64_t(mesh.normals.size() * sizeof(glm::vec3)));
+		glBindBuffer(GL_ARRAY_BUFFER, normalBuffer);
+		glBufferData(GL_ARRAY_BUFFER, mesh.normals.size() * sizeof(glm::vec3), mesh.normals.data(), GL_STATIC_DRAW);
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+
+		indexBuffer.Reset(GenBuffer(), int64_t(mesh.indices.size() * sizeof(unsigned int)));
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(unsigned int), mesh.indices.data(), GL_STATIC_DRAW);
+
+		// Per instance: advances once per instance, not per vertex
+		instanceBuffer.Reset(GenBuffer());
+		glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+		glEnableVertexAttribArray(3);
+		glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(PropInstance), (void*)offsetof(PropInstance, position_scale));
+		glVertexAttribDivisor(3, 1);
+		glEnableVertexAttribArray(4);
+		glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(PropInstance), (void*)offsetof(PropInstance, rotation));
+		glVertexAttribDivisor(4, 1);
+
+		glBindVertexArray(previous);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		byLevel.resize(chain.levels.size());
+		levelFirst.resize(chain.levels.size());
+	}
+
+	// Scatter count props on the terrain between two heights, on gentle slopes only
+	void Scatter(int count, const HeightGrid& heights, const TerrainMapping& mapping, float half_extent, float y_min, float y_max, unsigned int seed = 1)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> xz(-half_extent, half_extent);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+		instances.clear();
+		const float step = mapping.Spacing();
+		for (int attempt = 0; attempt < count * 50 && (int)instances.size() < count; attempt++)
+		{
+			const float x = xz(rng), z = xz(rng);
+			const float tx = mapping.WorldToTexelX(x) - 0.5f, ty = mapping.WorldToTexelY(z) - 0.5f;
+			const float h = heights.Bilinear(tx, ty);
+			const float slope = std::max(std::abs(heights.Bilinear(tx + 1.0f, ty) - heights.Bilinear(tx - 1.0f, ty)),
+				std::abs(heights.Bilinear(tx, ty + 1.0f) - heights.Bilinear(tx, ty - 1.0f))) / (2.0f * step);
+			if (h < y_min || h > y_max || slope > 0.8f)
+				continue;
+
+			const float yaw = 6.2831853f * unit(rng);
+			PropInstance instance;
+			instance.position_scale = glm::vec4(x, h, z, 0.3f + 0.7f * unit(rng) * unit(rng));
+			instance.rotation = glm::vec4(std::cos(yaw), std::sin(yaw), 0.0f, 0.0f);
+			settle(instance, heights, mapping);
+			instances.push_back(instance);
+		}
+	}
+
+	// Follow the ground after an edit
+	void Settle(const HeightGrid& heights, const TerrainMapping& mapping)
+	{
+		for (PropInstance& instance : instances)
+			settle(instance, heights, mapping);
+	}
+
+	// Pick the level of every instance in the frustum, and not behind a ridge when occlusion is given.
+	// pixels_per_unit: viewport height / (2 tan(fov / 2)). forced_level >= 0 draws every instance at that level.
+	void Update(const glm::mat4& view_projection, const glm::vec3& camera, float pixels_per_unit, int forced_level = -1, const OcclusionCuller* occlusion = nullptr)
+	{
+		// Frustum planes (Gribb and Hartmann), normalized so the sphere test is in world units
+		glm::vec4 planes[6];
+		for (int i = 0; i < 3; i++)
+		{
+			glm::vec4 row(view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]);
+			glm::vec4 w(view_projection[0][3], view_projection[1][3], view_projection[2][3], view_projection[3][3]);
+			planes[i * 2] = w + row;
+			planes[i * 2 + 1] = w - row;
+		}
+		for (glm::vec4& plane : planes)
+			plane /= glm::length(glm::vec3(plane));
+
+		for (std::vector<PropInstance>& level : byLevel)
+			level.clear();
+		drawnTriangles = 0;
+		fullTriangles = 0;
+
+		for (const PropInstance& instance : instances)
+		{
+			const float scale = instance.position_scale.w;
+			const glm::vec3 c = chain.center * scale;
+			const glm::vec3 center = glm::vec3(instance.position_scale) + glm::vec3(instance.rotation.x * c.x + instance.rotation.y * c.z, c.y, -instance.rotation.y * c.x + instance.rotation.x * c.z);
+			const float radius = chain.radius * scale;
+
+			bool inside = true;
+			for (int p = 0; p < 6 && inside; p++)
+				inside = glm::dot(glm::vec3(planes[p]), center) + planes[p].w > -radius;
+			if (!inside)
+				continue;
+			if (occlusion && !occlusion->IsVisible(center - glm::vec3(radius), center + glm::vec3(radius)))
+				continue;
+
+			int level = forced_level >= 0 ? std::min(forced_level, (int)chain.levels.size() - 1)
+				: SelectLOD(chain, scale, std::max(glm::length(center - camera) - radius, 0.0f), pixels_per_unit);
+			byLevel[level].push_back(instance);
+			drawnTriangles += chain.levels[level].count / 3;
+			fullTriangles += chain.levels[0].count / 3;
+		}
+
+		// One buffer, the instances of each level one after another
+		sorted.clear();
+		for (size_t l = 0; l < byLevel.size(); l++)
+		{
+			levelFirst[l] = (int)sorted.size();
+			sorted.insert(sorted.end(), byLevel[l].begin(), byLevel[l].end());
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+		glBufferData(GL_ARRAY_BUFFER, sorted.size() * sizeof(PropInstance), sorted.empty() ? nullptr : sorted.data(), GL_STREAM_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		instanceBuffer.SetMemorySize(int64_t(sorted.size() * sizeof(PropInstance)));
+	}
+
+	// One instanced draw per level. The terrain VAO is bound again afterwards.
+	void Draw() const
+	{
+		GLint previous = 0;
+		glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previous);
+		glBindVertexArray(VAO);
+		for (size_t l = 0; l < byLevel.size(); l++)
+		{
+			if (byLevel[l].empty())
+				continue;
+			const MeshLevel& level = chain.levels[l];
+			glDrawElementsInstancedBaseInstance(GL_TRIANGLES, (GLsizei)level.count, GL_UNSIGNED_INT,
+				(void*)(size_t(level.firstIndex) * sizeof(unsigned int)), (GLsizei)byLevel[l].size(), (GLuint)levelFirst[l]);
+		}
+		glBindVertexArray(previous);
+	}
+
+	const MeshLODChain& GetChain() const { return chain; }
+	int GetCount() const { return (int)instances.size(); }
+	int GetLevelCount() const { return (int)chain.levels.size(); }
+	// Instances drawn at level l by the latest Update
+	int GetDrawn(int l) const { return (int)byLevel[l].size(); }
+	size_t GetDrawnTriangles() const { return drawnTriangles; }
+	// What the same instances cost at full detail
+	size_t GetFullTriangles() const { return fullTriangles; }
+};
\ No newline at end of file
@@ -0,0 +1,123 @@
+#pragma once
+/*
+	Encapsulate OpenGL Query Objects (GL_SAMPLES_PASSED, GL_TIME_ELAPSED, GL_TIMESTAMP, ...).
+	Keeps a small ring of queries and reads the oldest one, so the CPU never waits for the GPU.
+*/
+
+#include <GL/glew.h>
+
+#include <vector>
+
+#include "GLResource.hpp"
+
+class Query
+{
+private:
+	static constexpr int ring_size = 3;
+
+	QueryHandle IDs[ring_size];
+	GLenum target;
+
+	unsigned int frame = 0;
+	GLuint64 lastResult = 0;
+public:
+	Query(GLenum _target)
+	{
+		this->target = _target;
+		for (QueryHandle& id : this->IDs)
+			id.Reset(GenQuery());
+	}
+
+	void Begin()
+	{
+		glBeginQuery(target, IDs[frame % ring_size]);
+	}
+
+	void End()
+	{
+		glEndQuery(target);
+		frame++;
+
+		// The next slot is the oldest one in flight: read it before Begin reuses it
+		if (frame >= ring_size)
+		{
+			GLint available = 0;
+			glGetQueryObjectiv(IDs[frame % ring_size], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (available)
+				glGetQueryObjectui64v(IDs[frame % ring_size], GL_QUERY_RESULT, &lastResult);
+		}
+	}
+
+	// Result of the latest query that finished, a few frames late
+	GLuint64 GetResult() const { return lastResult; }
+};
+
+// GPU timestamps at marks inside a frame (glQueryCounter), read a few frames late like Query.
+// Unlike GL_TIME_ELAPSED they may be taken while another timer query is running.
+class TimestampQueries
+{
+private:
+	static constexpr int ring_size = 3;
+
+	std::vector<QueryHandle> IDs[ring_size];
+	std::vector<bool> written[ring_size];
+
+	unsigned int frame = 0;
+	std::vector<GLuint64> lastResult;
+	std::vector<bool> lastWritten;
+public:
+	TimestampQueries(int mark_count)
+	{
+		for (int r = 0; r < ring_size; r++)
+		{
+			IDs[r].resize(mark_count);
+			for (QueryHandle& id : IDs[r])
+				id.Reset(GenQuery());
+			written[r].assign(mark_count, false);
+		}
+		lastResult.assign(mark_count, 0);
+		lastWritten.assign(mark_count, false);
+	}
+
+	void Mark(int index)
+	{
+		glQueryCounter(IDs[frame % ring_size][index], GL_TIMESTAMP);
+		written[frame % ring_size][index] = true;
+	}
+
+	// Call once per frame, after the last mark
+	void EndFrame()
+	{
+		frame++;
+		if (frame < ring_size)
+			return;
+
+		// The oldest frame in flight: keep it only when all of its marks are done
+		const int slot = frame % ring_size;
+		std::vector<bool>& marks = written[slot];
+		bool available = true;
+		for (size_t i = 0; i < marks.size() && available; i++)
+		{
+			GLint done = 1;
+			if (marks[i])
+				glGetQueryObjectiv(IDs[slot][i], GL_QUERY_RESULT_AVAILABLE, &done);
+			available = done != 0;
+		}
+		if (available)
+		{
+			for (size_t i = 0; i < marks.size(); i++)
+				if (marks[i])
+					glGetQueryObjectui64v(IDs[slot][i], GL_QUERY_RESULT, &lastResult[i]);
+			lastWritten = marks;
+		}
+		marks.assign(marks.size(), false);
+	}
+
+	// Nanoseconds between two marks of the latest frame read back, 0 when that frame skipped one of them
+	GLuint64 GetElapsed(int from, int to) const
+	{
+		if (!lastWritten[from] || !lastWritten[to] || lastResult[to] < lastResult[from])
+			return 0;
+		return lastResult[to] - lastResult[from];
+	}
+};
@@ -0,0 +1,706 @@
+#pragma once
+/*
+	CPU Reference of the Terrain Pipeline, without OpenGL.
+	Does what Terrain.tesc, Terrain.tese and Terrain.frag do, the slow and plain way: the tessellated grid,
+	the height decode, normals and band weights of every vertex, then a depth tested visibility buffer and
+	the shading of every pixel. Tiles of the screen are spread over every core; the image does not depend
+	on the thread count, so it can be diffed against GPU captures (TERRAIN_CAPTURE, tools/ImageDiff.cpp).
+	Only the terrain: shadows, flowers, props, water and the atmosphere are left out, the capture turns them off.
+*/
+
+#include <stdio.h>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Heightfield.hpp"
+#include "HorizonBaker.hpp"
+#include "TextureBaker.hpp"
+#include "Parallel.hpp"
+
+// Camera of a reference frame. main.cpp builds the GPU capture from the same one.
+struct ReferenceCamera
+{
+	glm::vec3 position = glm::vec3(40.0f, 10.0f, 40.0f);
+	glm::vec3 target = glm::vec3(0.0f, -30.0f, 0.0f);
+	// Degrees
+	float fovY = 45.0f;
+	float nearPlane = 0.1f;
+	float farPlane = 500.0f;
+	int width = 1920;
+	int height = 1080;
+
+	glm::mat4 View() const { return glm::lookAt(position, target, glm::vec3(0.0f, 1.0f, 0.0f)); }
+	glm::mat4 Projection() const { return glm::perspective(glm::radians(fovY), float(width) / float(height), nearPlane, farPlane); }
+
+	// "x,y,z,tx,ty,tz": position, then the point it looks at
+	bool Parse(const char* text)
+	{
+		glm::vec3 p, t;
+		if (sscanf(text, "%f,%f,%f,%f,%f,%f", &p.x, &p.y, &p.z, &t.x, &t.y, &t.z) != 6)
+			return false;
+		position = p;
+		target = t;
+		return true;
+	}
+
+	// "1920x1080"
+	bool ParseSize(const char* text)
+	{
+		int w, h;
+		if (sscanf(text, "%dx%d", &w, &h) != 2 || w <= 0 || h <= 0)
+			return false;
+		width = w;
+		height = h;
+		return true;
+	}
+};
+
+// Mip chain of float RGB texels, sampled like the GL textures of the terrain: GL_MIRRORED_REPEAT,
+// GL_LINEAR_MIPMAP_LINEAR when it has mips, GL_LINEAR else
+class ReferenceTexture
+{
+private:
+	struct Level
+	{
+		int width = 0;
+		int height = 0;
+		std::vector<float> texels;
+	};
+	std::vector<Level> levels;
+
+	// Wrapped texel index, GL_MIRRORED_REPEAT
+	static int mirror(int i, int size)
+	{
+		const int period = 2 * size;
+		i %= period;
+		if (i < 0)
+			i += period;
+		return i < size ? i : period - 1 - i;
+	}
+
+	const float* texel(const Level& level, int x, int y) const
+	{
+		return &level.texels[(size_t(mirror(y, level.height)) * level.width + mirror(x, level.width)) * 3];
+	}
+
+	glm::vec3 bilinear(const Level& level, glm::vec2 uv) const
+	{
+		float x = uv.x * float(level.width) - 0.5f;
+		float y = uv.y * float(level.height) - 0.5f;
+		int x0 = (int)std::floor(x), y0 = (int)std::floor(y);
+		float fx = x - float(x0), fy = y - float(y0);
+		const float* a = texel(level, x0, y0);
+		const float* b = texel(level, x0 + 1, y0);
+		const float* c = texel(level, x0, y0 + 1);
+		const float* d = texel(level, x0 + 1, y0 + 1);
+		glm::vec3 result;
+		for (int k = 0; k < 3; k++)
+		{
+			float top = a[k] + (b[k] - a[k]) * fx;
+			float bottom = c[k] + (d[k] - c[k]) * fx;
+			result[k] = top + (bottom - top) * fy;
+		}
+		return result;
+	}
+public:
+	// Levels as the GPU has them: uploaded baked blocks, or the image with its mips built on the CPU
+	void FromBaked(const BakedTexture& baked)
+	{
+		levels.clear();
+		for (const CompressedLevel& compressed : baked.levels)
+		{
+			Level level;
+			level.width = compressed.width;
+			level.height = compressed.height;
+			level.texels.assign(size_t(level.width) * level.height * 3, 0.0f);
+			const int blocksX = (level.width + 3) / 4, blocksY = (level.height + 3) / 4;
+			const int blockBytes = BlockBytes(baked.format);
+			for (int by = 0; by < blocksY; by++)
+			{
+				for (int bx = 0; bx < blocksX; bx++)
+				{
+					const unsigned char* in = &compressed.blocks[(size_t(by) * blocksX + bx) * blockBytes];
+					float rgb[16][3];
+					if (baked.format == BlockFormat::BC1)
+						bc::DecodeBC1Block(in, rgb);
+					else
+					{
+						// BC4 reads the same value in .rgb (swizzle in Texture.hpp), BC5 is not a terrain material
+						float r[16];
+						bc::DecodeBC4Block(in, r);
+						for (int p = 0; p < 16; p++)
+							rgb[p][0] = rgb[p][1] = rgb[p][2] = r[p];
+					}
+					for (int p = 0; p < 16; p++)
+					{
+						int x = bx * 4 + (p & 3), y = by * 4 + (p >> 2);
+						if (x >= level.width || y >= level.height)
+							continue;
+						for (int k = 0; k < 3; k++)
+							level.texels[(size_t(y) * level.width + x) * 3 + k] = rgb[p][k] / 255.0f;
+					}
+				}
+			}
+			levels.push_back(std::move(level));
+		}
+	}
+
+	// mipmaps: the whole chain (2x2 box filter, as close to glGenerateMipmap as it gets), or level 0 only
+	void FromImage(const Image& image, bool mipmaps = true)
+	{
+		levels.clear();
+		std::vector<Image> chain;
+		if (mipmaps)
+			chain = BuildMipChain(image);
+		else
+			chain.push_back(image);
+		for (const Image& mip : chain)
+		{
+			Level level;
+			level.width = mip.width;
+			level.height = mip.height;
+			level.texels.resize(size_t(level.width) * level.height * 3);
+			for (size_t i = 0; i < size_t(level.width) * level.height; i++)
+				for (int k = 0; k < 3; k++)
+					level.texels[i * 3 + k] = float(mip.pixels[i * mip.channels + std::min(k, mip.channels - 1)]) / 255.0f;
+			levels.push_back(std::move(level));
+		}
+	}
+
+	// duvdx, duvdy: screen derivatives of uv, for the level of detail
+	glm::vec3 Sample(glm::vec2 uv, glm::vec2 duvdx, glm::vec2 duvdy) const
+	{
+		const Level& base = levels[0];
+		const glm::vec2 size(float(base.width), float(base.height));
+		float rho = std::max(glm::length(duvdx * size), glm::length(duvdy * size));
+		float lambda = rho > 0.0f ? std::log2(rho) : 0.0f;
+		// Magnification, or a texture without mips
+		if (lambda <= 0.0f || levels.size() == 1)
+			return bilinear(base, uv);
+
+		const float last = float(levels.size() - 1);
+		if (lambda >= last)
+			return bilinear(levels.back(), uv);
+		int d = (int)lambda;
+		float f = lambda - float(d);
+		return bilinear(levels[d], uv) * (1.0f - f) + bilinear(levels[d + 1], uv) * f;
+	}
+
+	bool IsEmpty() const { return levels.empty(); }
+	int GetWidth() const { return levels.empty() ? 0 : levels[0].width; }
+	int GetHeight() const { return levels.empty() ? 0 : levels[0].height; }
+};
+
+// Material layers, in the order of tex_radio in Terrain.tese
+enum class ReferenceLayer { Grass = 0, Rock = 1, Snow = 2, Count = 3 };
+
+struct ReferenceSettings
+{
+	// Grid mesh of main.cpp
+	int points = 200;
+	float scale = 0.5f;
+	// Player view tessellation level
+	int tessLevel = 8;
+	// Pixels per side of a screen tile, one task each
+	int tileSize = 32;
+	glm::vec3 clearColor = glm::vec3(0.7f, 0.8f, 1.0f);
+	// Where the sun starts in main.cpp: it travels along lightPos
+	glm::vec3 lightPos = -glm::vec3(0.0f, std::sin(std::atan2(10.5f, 0.5f)), std::cos(std::atan2(10.5f, 0.5f))) * std::sqrt(10.5f * 10.5f + 0.5f * 0.5f);
+	bool ambientOcclusion = true;
+};
+
+struct ReferenceStats
+{
+	double vertexMs = 0.0;
+	double binMs = 0.0;
+	double rasterMs = 0.0;
+	size_t vertices = 0;
+	// Patches that reached a tile, and the pixels the terrain covers
+	size_t binnedPatches = 0;
+	size_t coveredPixels = 0;
+};
+
+class ReferenceRenderer
+{
+private:
+	// Tessellated vertex: window position (x, y snapped to 1/256 pixel, depth), 1/w, and what the shading reads
+	struct Vertex
+	{
+		float x, y, z, invW;
+		float height;
+		glm::vec3 normal;
+		bool valid;
+	};
+
+	// Attributes Terrain.tese hands to the fragment shader
+	struct Attributes
+	{
+		glm::vec2 uv;
+		glm::vec3 eye;
+		glm::vec3 normal;
+		glm::vec3 radio;
+	};
+
+	const HeightGrid* heights = nullptr;
+	const HorizonMap* horizon = nullptr;
+	ReferenceTexture diffuse[int(ReferenceLayer::Count)];
+	ReferenceTexture specular[int(ReferenceLayer::Count)];
+
+	// Per frame
+	int gridSize = 0;
+	std::vector<Vertex> vertices;
+	glm::mat4 view = glm::mat4(1.0f);
+	glm::vec3 lightDirection = glm::vec3(0.0f);
+	ReferenceStats stats;
+
+	// Nearest texel of the height map, GL_MIRRORED_REPEAT
+	float heightAt(glm::vec2 uv) const
+	{
+		auto wrap = [](float c, int size)
+		{
+			int i = (int)std::floor(c * float(size));
+			const int period = 2 * size;
+			i %= period;
+			if (i < 0)
+				i += period;
+			return i < size ? i : period - 1 - i;
+		};
+		return heights->At(wrap(uv.x, heights->width), wrap(uv.y, heights->height));
+	}
+
+	// Same as Terrain.tese, else-if chain included
+	static glm::vec2 checkBoundary(glm::vec2 p)
+	{
+		glm::vec2 res = p;
+		if (p.x < 0.0f) res.x = 0.0f;
+		else if (p.x > 1.0f) res.x = 1.0f;
+		else if (p.y < 0.0f) res.y = 0.0f;
+		else if (p.y > 1.0f) res.y = 1.0f;
+		return res;
+	}
+
+	static glm::vec3 bandWeights(float realHeight)
+	{
+		const float upheight = realHeight - terrain_y_shift;
+		if (realHeight > -50.0f && realHeight < -20.0f)
+			return glm::vec3((1 - upheight / 30.0f) + 0.2f, upheight / 30.0f - 0.2f, 0.0f);
+		if (realHeight >= -20.0f && realHeight < -10.0f)
+			return glm::vec3(0.0f, 1 - (upheight - 30.0f) / 10.0f, (upheight - 30.0f) / 10.0f);
+		return glm::vec3(0.0f, 0.0f, 1.0f);
+	}
+
+	// Grid vertex (I, J) of the tessellated patches: its patch, and where in it. The shared edges go to the lower patch.
+	void domain(int I, int J, glm::vec2& uv, float& x, float& z) const
+	{
+		const int n = settings.points, L = settings.tessLevel;
+		const int i = std::min(I / L, n - 2), j = std::min(J / L, n - 2);
+		// gl_TessCoord: u along the patch's j side, v along its i side
+		const float v = float(I - i * L) / float(L);
+		const float u = float(J - j * L) / float(L);
+
+		auto gridX = [&](int k) { return (settings.scale * float(k)) - (settings.scale * float(n)) / 2.0f; };
+		auto gridUV = [&](int k) { return (float(k) + 0.5f) / float(n - 1); };
+		x = gridX(i) + v * (gridX(i + 1) - gridX(i));
+		z = gridX(j) + u * (gridX(j + 1) - gridX(j));
+		uv = glm::vec2(gridUV(i) + v * (gridUV(i + 1) - gridUV(i)), gridUV(j) + u * (gridUV(j + 1) - gridUV(j)));
+	}
+
+	Attributes attributes(int index) const
+	{
+		Attributes a;
+		float x, z;
+		domain(index / gridSize, index % gridSize, a.uv, x, z);
+		const Vertex& vertex = vertices[index];
+		a.eye = -glm::vec3(view * glm::vec4(x, 0.0f, z, 1.0f));
+		a.normal = vertex.normal;
+		a.radio = bandWeights(vertex.height);
+		return a;
+	}
+
+	// Terrain.tese for every grid vertex, projected to the window
+	void transformVertices(const glm::mat4& viewProjection, int width, int height)
+	{
+		const float w = float(heights->width - 1);
+		const float h = float(heights->height - 1);
+		ParallelFor(gridSize, [&](int I)
+		{
+			for (int J = 0; J < gridSize; J++)
+			{
+				glm::vec2 uv;
+				float x, z;
+				domain(I, J, uv, x, z);
+				Vertex& vertex = vertices[size_t(I) * gridSize + J];
+				vertex.height = heightAt(uv);
+
+				float Nx = 0.0f;
+				for (int _y = -1; _y < 2; ++_y)
+				{
+					float left = heightAt(checkBoundary(glm::vec2(uv.x - 1 / w, uv.y + float(_y) / h)));
+					float right = heightAt(checkBoundary(glm::vec2(uv.x + 1 / w, uv.y + float(_y) / h)));
+					Nx += (left - right);
+				}
+				Nx /= 3.0f;
+				float Nz = 0.0f;
+				for (int _x = -1; _x < 2; ++_x)
+				{
+					float top = heightAt(checkBoundary(glm::vec2(uv.x + float(_x) / w, uv.y + 1 / h)));
+					float bot = heightAt(checkBoundary(glm::vec2(uv.x + float(_x) / w, uv.y - 1 / h)));
+					Nz += (top - bot);
+				}
+				Nz /= 3.0f;
+				vertex.normal = glm::normalize(glm::vec3(Nx, 0.02f, Nz));
+
+				// Triangles that cross the near or far plane are dropped, not clipped: keep the camera off the ground
+				glm::vec4 clip = viewProjection * glm::vec4(x, vertex.height, z, 1.0f);
+				vertex.valid = clip.w > 0.0f && clip.z >= -clip.w && clip.z <= clip.w;
+				if (!vertex.valid)
+					continue;
+				const float invW = 1.0f / clip.w;
+				// Sub-pixel precision of the rasterizer
+				vertex.x = std::round((clip.x * invW * 0.5f + 0.5f) * float(width) * 256.0f) / 256.0f;
+				vertex.y = std::round((clip.y * invW * 0.5f + 0.5f) * float(height) * 256.0f) / 256.0f;
+				vertex.z = clip.z * invW * 0.5f + 0.5f;
+				vertex.invW = invW;
+			}
+		});
+	}
+
+	// Corners of triangle t of the grid, counter clockwise seen from above: front facing
+	void triangleVertices(uint32_t t, int corners[3]) const
+	{
+		const uint32_t cell = t >> 1;
+		const int cells = gridSize - 1;
+		const int a = int(cell / cells), b = int(cell % cells);
+		const int v00 = a * gridSize + b, v10 = v00 + gridSize, v01 = v00 + 1, v11 = v10 + 1;
+		if ((t & 1) == 0)
+		{
+			corners[0] = v00; corners[1] = v01; corners[2] = v10;
+		}
+		else
+		{
+			corners[0] = v10; corners[1] = v01; corners[2] = v11;
+		}
+	}
+
+	// Edge function of a -> b at p, doubles: exact on snapped positions
+	static double edge(const Vertex& a, const Vertex& b, double px, double py)
+	{
+		return (double(b.x) - a.x) * (py - a.y) - (double(b.y) - a.y) * (px - a.x);
+	}
+
+	// Top-left fill rule for counter clockwise triangles, y up: left edges go down, top edges go left
+	static bool isTopLeft(const Vertex& a, const Vertex& b)
+	{
+		return (b.y < a.y) || (b.y == a.y && b.x < a.x);
+	}
+
+	// Perspective correct barycentrics of triangle c at a pixel center
+	void barycentrics(const int c[3], double px, double py, float out[3]) const
+	{
+		const Vertex& a = vertices[c[0]];
+		const Vertex& b = vertices[c[1]];
+		const Vertex& d = vertices[c[2]];
+		double area = edge(a, b, d.x, d.y);
+		double l0 = edge(b, d, px, py) / area;
+		double l1 = edge(d, a, px, py) / area;
+		double l2 = edge(a, b, px, py) / area;
+		double w0 = l0 * a.invW, w1 = l1 * b.invW, w2 = l2 * d.invW;
+		double sum = w0 + w1 + w2;
+		if (sum == 0.0)
+			sum = 1.0;
+		out[0] = float(w0 / sum);
+		out[1] = float(w1 / sum);
+		out[2] = float(w2 / sum);
+	}
+
+	// Terrain.frag, without the shadow and the atmosphere
+	glm::vec3 shade(const int c[3], int px, int py) const
+	{
+		const Attributes a0 = attributes(c[0]), a1 = attributes(c[1]), a2 = attributes(c[2]);
+		auto interpolateUV = [&](const float b[3]) { return a0.uv * b[0] + a1.uv * b[1] + a2.uv * b[2]; };
+
+		float b[3];
+		barycentrics(c, px + 0.5, py + 0.5, b);
+		const glm::vec2 uv = interpolateUV(b);
+		const glm::vec3 radio = a0.radio * b[0] + a1.radio * b[1] + a2.radio * b[2];
+		const glm::vec3 n = a0.normal * b[0] + a1.normal * b[1] + a2.normal * b[2];
+		const glm::vec3 eye = a0.eye * b[0] + a1.eye * b[1] + a2.eye * b[2];
+
+		// Coarse derivatives: the same across the 2x2 quad, from its lower left pixel
+		const int qx = px & ~1, qy = py & ~1;
+		float bq[3], bx[3], by[3];
+		barycentrics(c, qx + 0.5, qy + 0.5, bq);
+		barycentrics(c, qx + 1.5, qy + 0.5, bx);
+		barycentrics(c, qx + 0.5, qy + 1.5, by);
+		const glm::vec2 uvQuad = interpolateUV(bq);
+		const glm::vec2 duvdx = interpolateUV(bx) - uvQuad;
+		const glm::vec2 duvdy = interpolateUV(by) - uvQuad;
+
+		// textureSize(height) / textureSize(grass): integer division, as the ivec2 in the shader
+		const ReferenceTexture& grass = diffuse[int(ReferenceLayer::Grass)];
+		const glm::vec2 tiling(float(heights->width / std::max(grass.GetWidth(), 1)), float(heights->height / std::max(grass.GetHeight(), 1)));
+		const glm::vec2 normTexUV = tiling * uv;
+		const glm::vec2 dx = tiling * duvdx, dy = tiling * duvdy;
+
+		glm::vec3 materialDiffuse(0.0f), materialSpecular(0.0f);
+		for (int layer = 0; layer < int(ReferenceLayer::Count); layer++)
+		{
+			materialDiffuse += radio[layer] * diffuse[layer].Sample(normTexUV, dx, dy);
+			materialSpecular += radio[layer] * specular[layer].Sample(normTexUV, dx, dy);
+		}
+
+		float skyVisibility = 1.0f;
+		if (settings.ambientOcclusion && horizon)
+			skyVisibility = horizonAt(uv);
+		const glm::vec3 ambient = glm::vec3(0.2f) * materialDiffuse * skyVisibility;
+
+		const glm::vec3 l = glm::normalize(lightDirection);
+		const glm::vec3 e = glm::normalize(eye);
+		const float shininess = 1.0f;
+
+		float cosTheta = glm::clamp(glm::dot(n, l), 0.0f, 1.0f);
+		glm::vec3 diffuseColor = materialDiffuse * cosTheta;
+
+		glm::vec3 B = glm::normalize(l + e);
+		float cosB = glm::clamp(glm::dot(n, B), 0.0f, 1.0f);
+		cosB = glm::clamp(std::pow(cosB, shininess), 0.0f, 1.0f);
+		cosB = cosB * cosTheta * (shininess + 2) / (2 * 3.14159265f);
+		glm::vec3 specularColor = materialSpecular * cosB;
+
+		return ambient + diffuseColor + specularColor;
+	}
+
+	// Baked horizon visibility, R8 with GL_LINEAR and GL_MIRRORED_REPEAT
+	float horizonAt(glm::vec2 uv) const
+	{
+		const int w = horizon->GetWidth(), h = horizon->GetHeight();
+		auto wrap = [](int i, int size)
+		{
+			const int period = 2 * size;
+			i %= period;
+			if (i < 0)
+				i += period;
+			return i < size ? i : period - 1 - i;
+		};
+		float x = uv.x * float(w) - 0.5f, y = uv.y * float(h) - 0.5f;
+		int x0 = (int)std::floor(x), y0 = (int)std::floor(y);
+		float fx = x - float(x0), fy = y - float(y0);
+		auto at = [&](int tx, int ty) { return float(horizon->At(wrap(tx, w), wrap(ty, h))) / 255.0f; };
+		float top = at(x0, y0) + (at(x0 + 1, y0) - at(x0, y0)) * fx;
+		float bottom = at(x0, y0 + 1) + (at(x0 + 1, y0 + 1) - at(x0, y0 + 1)) * fx;
+		return top + (bottom - top) * fy;
+	}
+
+	// Pixel index of a window coordinate, kept in [lo, hi]: vertices close to w = 0 land far off screen
+	static int pixelClamped(float c, int lo, int hi)
+	{
+		return (int)std::min(std::max(c, float(lo)), float(hi));
+	}
+
+	static unsigned char toUnorm8(float c)
+	{
+		return (unsigned char)std::floor(glm::clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f);
+	}
+public:
+	ReferenceSettings settings;
+
+	ReferenceRenderer(const ReferenceSettings& _settings = ReferenceSettings())
+	{
+		settings = _settings;
+		settings.tessLevel = std::max(settings.tessLevel, 1);
+		settings.tileSize = std::max(settings.tileSize, 2) & ~1;
+	}
+
+	// Decoded height map, as the tese reads it. Kept by pointer.
+	void SetHeights(const HeightGrid& _heights) { heights = &_heights; }
+	// Baked ambient visibility, nullptr: none. Kept by pointer.
+	void SetHorizon(const HorizonMap* _horizon) { horizon = _horizon; }
+	ReferenceTexture& GetDiffuse(ReferenceLayer layer) { return diffuse[int(layer)]; }
+	ReferenceTexture& GetSpecular(ReferenceLayer layer) { return specular[int(layer)]; }
+
+	// One frame: BGR rows, bottom row first, as glReadPixels and BMP files have them
+	bool Render(const ReferenceCamera& camera, std::vector<unsigned char>& out)
+	{
+		using Clock = std::chrono::high_resolution_clock;
+		auto msSince = [](Clock::time_point start) { return std::chrono::duration<double, std::milli>(Clock::now() - start).count(); };
+
+		if (!heights || heights->width < 2 || heights->height < 2)
+		{
+			printf("Reference renderer: no height map\n");
+			return false;
+		}
+		for (int layer = 0; layer < int(ReferenceLayer::Count); layer++)
+		{
+			if (diffuse[layer].IsEmpty() || specular[layer].IsEmpty())
+			{
+				printf("Reference renderer: material layer %d is missing\n", layer);
+				return false;
+			}
+		}
+
+		const int width = camera.width, height = camera.height;
+		stats = ReferenceStats();
+		view = camera.View();
+		const glm::mat4 viewProjection = camera.Projection() * view;
+		lightDirection = -glm::vec3(view * glm::vec4(settings.lightPos, 1.0f));
+
+		// Vertices
+		auto start = Clock::now();
+		const int L = settings.tessLevel, patches = settings.points - 1;
+		gridSize = patches * L + 1;
+		vertices.resize(size_t(gridSize) * gridSize);
+		transformVertices(viewProjection, width, height);
+		stats.vertices = vertices.size();
+		stats.vertexMs = msSince(start);
+
+		// Bins: the patches over every tile, from the bounds of their vertices
+		start = Clock::now();
+		const int tile = settings.tileSize;
+		const int tilesX = (width + tile - 1) / tile, tilesY = (height + tile - 1) / tile;
+		struct PatchRect { int x0, y0, x1, y1; };
+		std::vector<PatchRect> rects(size_t(patches) * patches);
+		ParallelFor(patches, [&](int i)
+		{
+			for (int j = 0; j < patches; j++)
+			{
+				float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f;
+				bool any = false;
+				for (int a = 0; a <= L; a++)
+				{
+					for (int b = 0; b <= L; b++)
+					{
+						const Vertex& v = vertices[size_t(i * L + a) * gridSize + j * L + b];
+						if (!v.valid)
+							continue;
+						any = true;
+						minX = std::min(minX, v.x); maxX = std::max(maxX, v.x);
+						minY = std::min(minY, v.y); maxY = std::max(maxY, v.y);
+					}
+				}
+				PatchRect& r = rects[size_t(i) * patches + j];
+				r.x0 = pixelClamped(std::floor(minX), 0, width - 1) / tile;
+				r.y0 = pixelClamped(std::floor(minY), 0, height - 1) / tile;
+				r.x1 = pixelClamped(std::floor(maxX), 0, width - 1) / tile;
+				r.y1 = pixelClamped(std::floor(maxY), 0, height - 1) / tile;
+				if (!any || maxX < 0.0f || maxY < 0.0f || minX > float(width) || minY > float(height))
+					r.x1 = -1;
+			}
+		});
+		std::vector<std::vector<uint32_t>> bins(size_t(tilesX) * tilesY);
+		for (uint32_t p = 0; p < rects.size(); p++)
+		{
+			const PatchRect& r = rects[p];
+			for (int ty = r.y0; ty <= r.y1; ty++)
+				for (int tx = r.x0; tx <= r.x1; tx++)
+					bins[size_t(ty) * tilesX + tx].push_back(p);
+			if (r.x1 >= r.x0 && r.y1 >= r.y0)
+				stats.binnedPatches++;
+		}
+		stats.binMs = msSince(start);
+
+		// Tiles: visibility buffer, then one shading per covered pixel
+		start = Clock::now();
+		out.assign(size_t(width) * height * 3, 0);
+		const unsigned char clear[3] = { toUnorm8(settings.clearColor.z), toUnorm8(settings.clearColor.y), toUnorm8(settings.clearColor.x) };
+		std::vector<size_t> covered(bins.size(), 0);
+		ParallelFor((int)bins.size(), [&](int t)
+		{
+			const int x0 = (t % tilesX) * tile, y0 = (t / tilesX) * tile;
+			const int x1 = std::min(x0 + tile, width), y1 = std::min(y0 + tile, height);
+			std::vector<float> depth(size_t(tile) * tile, 1.0f);
+			std::vector<uint32_t> ids(size_t(tile) * tile, UINT32_MAX);
+
+			for (uint32_t p : bins[t])
+			{
+				const int i = int(p) / patches, j = int(p) % patches;
+				for (int a = 0; a < L; a++)
+				{
+					for (int b = 0; b < L; b++)
+					{
+						const uint32_t cell = uint32_t(i * L + a) * uint32_t(gridSize - 1) + uint32_t(j * L + b);
+						for (uint32_t half = 0; half < 2; half++)
+						{
+							const uint32_t id = cell * 2 + half;
+							int c[3];
+							triangleVertices(id, c);
+							const Vertex& v0 = vertices[c[0]];
+							const Vertex& v1 = vertices[c[1]];
+							const Vertex& v2 = vertices[c[2]];
+							if (!v0.valid || !v1.valid || !v2.valid)
+								continue;
+							// Back faces and zero area
+							const double area = edge(v0, v1, v2.x, v2.y);
+							if (area <= 0.0)
+								continue;
+
+							const int bx0 = pixelClamped(std::floor(std::min({ v0.x, v1.x, v2.x }) - 0.5f), x0, x1);
+							const int by0 = pixelClamped(std::floor(std::min({ v0.y, v1.y, v2.y }) - 0.5f), y0, y1);
+							const int bx1 = pixelClamped(std::ceil(std::max({ v0.x, v1.x, v2.x }) - 0.5f), x0 - 1, x1 - 1);
+							const int by1 = pixelClamped(std::ceil(std::max({ v0.y, v1.y, v2.y }) - 0.5f), y0 - 1, y1 - 1);
+							if (bx0 > bx1 || by0 > by1)
+								continue;
+
+							const bool tl0 = isTopLeft(v1, v2), tl1 = isTopLeft(v2, v0), tl2 = isTopLeft(v0, v1);
+							for (int py = by0; py <= by1; py++)
+							{
+								for (int px = bx0; px <= bx1; px++)
+								{
+									const double cx = px + 0.5, cy = py + 0.5;
+									const double e0 = edge(v1, v2, cx, cy), e1 = edge(v2, v0, cx, cy), e2 = edge(v0, v1, cx, cy);
+									if (e0 < 0.0 || e1 < 0.0 || e2 < 0.0)
+										continue;
+									if ((e0 == 0.0 && !tl0) || (e1 == 0.0 && !tl1) || (e2 == 0.0 && !tl2))
+										continue;
+									// Window depth is linear in screen space
+									const float z = float((e0 * v0.z + e1 * v1.z + e2 * v2.z) / area);
+									if (z < 0.0f || z > 1.0f)
+										continue;
+									// GL_LESS in draw order: equal depths go to the lower index
+									const size_t k = size_t(py - y0) * tile + (px - x0);
+									if (z < depth[k] || (z == depth[k] && id < ids[k]))
+									{
+										depth[k] = z;
+										ids[k] = id;
+									}
+								}
+							}
+						}
+					}
+				}
+			}
+
+			for (int py = y0; py < y1; py++)
+			{
+				for (int px = x0; px < x1; px++)
+				{
+					unsigned char* dst = &out[(size_t(py) * width + px) * 3];
+					const uint32_t id = ids[size_t(py - y0) * tile + (px - x0)];
+					if (id == UINT32_MAX)
+					{
+						dst[0] = clear[0]; dst[1] = clear[1]; dst[2] = clear[2];
+						continue;
+					}
+					int c[3];
+					triangleVertices(id, c);
+					const glm::vec3 color = shade(c, px, py);
+					dst[0] = toUnorm8(color.z);
+					dst[1] = toUnorm8(color.y);
+					dst[2] = toUnorm8(color.x);
+					covered[t]++;
+				}
+			}
+		});
+		for (size_t c : covered)
+			stats.coveredPixels += c;
+		stats.rasterMs = msSince(start);
+		return true;
+	}
+
+	const ReferenceStats& GetStats() const { return stats; }
+};
\ No newline at end of file
@@ -0,0 +1,69 @@
+#pragma once
+/*
+	Shared Textures.
+	Asking twice for the same file with the same options returns the same Texture,
+	which lives as long as somebody holds it.
+*/
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include "Texture.hpp"
+
+class ResourceRegistry
+{
+private:
+	std::map<std::string, std::weak_ptr<Texture>> textures;
+
+	template<typename Option>
+	std::shared_ptr<Texture> getOrLoad(const char* path, Option option, const char* kind)
+	{
+		std::string key = std::string(path) + "|" + kind + std::to_string(int(option));
+		std::shared_ptr<Texture> texture = textures[key].lock();
+		if (!texture)
+		{
+			texture = std::make_shared<Texture>(path, option);
+			textures[key] = texture;
+		}
+		return texture;
+	}
+public:
+	// Uncompressed RGB8, with the given min filter
+	std::shared_ptr<Texture> GetTexture(const char* path, GLenum filter = GL_LINEAR_MIPMAP_LINEAR)
+	{
+		return getOrLoad(path, filter, "filter");
+	}
+
+	// Block compressed, baked and cached on disk
+	std::shared_ptr<Texture> GetTexture(const char* path, BlockFormat format)
+	{
+		return getOrLoad(path, format, "bc");
+	}
+
+	// Forget the entries nobody holds any more
+	void Collect()
+	{
+		for (auto it = textures.begin(); it != textures.end();)
+		{
+			if (it->second.expired())
+				it = textures.erase(it);
+			else
+				++it;
+		}
+	}
+
+	int GetLiveCount() const
+	{
+		int count = 0;
+		for (const auto& entry : textures)
+			count += entry.second.expired() ? 0 : 1;
+		return count;
+	}
+};
+
+static inline ResourceRegistry& GetResourceRegistry()
+{
+	static ResourceRegistry registry;
+	return registry;
+}
\ No newline at end of file
@@ -11,18 +11,21 @@
 #include <filesystem>
 #include <unordered_map>
 
+#include "GLResource.hpp"
+
 
 class Shader
 {
 public:
 
-	unsigned int ID;
+	ProgramHandle ID;
 
 	const char* vertSource;
 	const char* tescSource;
 	const char* teseSource;
 	const char* geomSource;
 	const char* fragSource;
+	const char* compSource = nullptr;
 
 	Shader() = default;
 
@@ -36,10 +39,12 @@ public:
 		LoadShaders(vertSource, fragSource, tescSource, teseSource, geomSource);
 	}
 
-	// Cleanup Shader
-	~Shader()
+	// Compute only program
+	explicit Shader(const char* compute_file_path)
 	{
-		glDeleteProgram(this->ID);
+		vertSource = fragSource = tescSource = teseSource = geomSource = nullptr;
+		compSource = compute_file_path;
+		LoadComputeShader(compSource);
 	}
 
 private:
@@ -125,7 +130,7 @@ public:
 
 		// Link the program
 		printf("Linking program\n");
-		this->ID = glCreateProgram();
+		this->ID.Reset(glCreateProgram());
 		glAttachShader(this->ID, VertexShaderID);
 		glAttachShader(this->ID, FragmentShaderID);
 
@@ -164,5 +169,45 @@ public:
 		return true;
 	}
 
+	// Link a Compute Shader Program
+	bool LoadComputeShader(const char* compute_file_path)
+	{
+		GLuint ComputeShaderID = glCreateShader(GL_COMPUTE_SHADER);
+		readAndCompileShader(compute_file_path, ComputeShaderID);
+
+		GLint Result = GL_FALSE;
+		int InfoLogLength;
+
+		// Link the program
+		printf("Linking program\n");
+		this->ID.Reset(glCreateProgram());
+		glAttachShader(this->ID, ComputeShaderID);
+		glLinkProgram(this->ID);
+
+		// Check the program
+		glGetProgramiv(this->ID, GL_LINK_STATUS, &Result);
+		glGetProgramiv(this->ID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+		if (InfoLogLength > 0) {
+			std::vector<char> ProgramErrorMessage(InfoLogLength + 1);
+			glGetProgramInfoLog(this->ID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
+			printf("%s\n", &ProgramErrorMessage[0]);
+		}
+		std::cout << "Linking program: " << (Result == GL_TRUE ? "Success" : "Failed!") << std::endl;
+
+		glDeleteShader(ComputeShaderID);
+
+		return Result == GL_TRUE;
+	}
+
+	// Recompile from the same source files. The old program is deleted once no frame in flight uses it.
+	void Reload()
+	{
+		this->ID.Release();
+		if (compSource)
+			LoadComputeShader(compSource);
+		else
+			LoadShaders(vertSource, fragSource, tescSource, teseSource, geomSource);
+	}
+
 };
 
@@ -0,0 +1,251 @@
+#pragma once
+/*
+	Cascaded Shadow Maps for the directional light.
+	The terrain is static, so a cascade keeps its depth map as long as its slice of the
+	camera frustum stays inside the sphere it was rendered for, and the light does not turn.
+*/
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+#include "TerrainChunks.hpp"
+#include "GLResource.hpp"
+
+static constexpr int shadow_cascade_count = 4;
+
+class ShadowCascades
+{
+private:
+	struct Cascade
+	{
+		glm::vec3 center = glm::vec3(0.0f);
+		float coverRadius = 0.0f;
+		glm::mat4 matrix = glm::mat4(1.0f);
+		bool valid = false;
+		bool dirty = true;
+	};
+
+	TextureHandle textureID;
+	FramebufferHandle FBO;
+	int resolution = 0;
+
+	Cascade cascades[shadow_cascade_count];
+	float splits[shadow_cascade_count];
+	glm::vec3 cachedLightDirection = glm::vec3(0.0f);
+
+	// Fixed light view, the cascades only move inside it
+	glm::mat4 lightView = glm::mat4(1.0f);
+public:
+	// Shadows stop there, even if the far plane is further
+	float maxDistance = 150.0f;
+	// 0: uniform splits, 1: logarithmic splits
+	float splitLambda = 0.75f;
+	// Extra radius rendered around a slice: how far the camera may move before a re-render
+	float moveThreshold = 0.25f;
+	// Re-render everything when the light turns more than this (cosine)
+	float lightThreshold = 0.9999f;
+	// Depth range around the slice center, enough for the whole encodable terrain height
+	float depthRange = 400.0f;
+	// False: ignore the cache and re-render every cascade every frame
+	bool cacheStatic = true;
+
+	ShadowCascades() = default;
+
+	ShadowCascades(int _resolution)
+	{
+		resolution = _resolution;
+
+		textureID.Reset(GenTexture(), int64_t(resolution) * resolution * shadow_cascade_count * 4);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32F, resolution, resolution, shadow_cascade_count, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+		// Hardware 2x2 PCF through sampler2DArrayShadow
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+		FBO.Reset(GenFramebuffer());
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	// Fit the cascades to the camera. Returns the number of cascades that need a re-render.
+	int Update(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& light_direction)
+	{
+		// Near and far planes back from the perspective matrix
+		float n = projection[3][2] / (projection[2][2] - 1.0f);
+		float f = projection[3][2] / (projection[2][2] + 1.0f);
+		float shadowFar = std::min(f, maxDistance);
+
+		// Practical split scheme: blend of logarithmic and uniform splits
+		for (int i = 0; i < shadow_cascade_count; i++)
+		{
+			float p = float(i + 1) / float(shadow_cascade_count);
+			float logSplit = n * std::pow(shadowFar / n, p);
+			float uniformSplit = n + (shadowFar - n) * p;
+			splits[i] = splitLambda * logSplit + (1.0f - splitLambda) * uniformSplit;
+		}
+
+		glm::vec3 direction = glm::normalize(light_direction);
+		bool lightMoved = glm::dot(direction, cachedLightDirection) < lightThreshold;
+		if (lightMoved)
+		{
+			cachedLightDirection = direction;
+			glm::vec3 up = std::abs(direction.y) > 0.99f ? glm::vec3(0, 0, 1) : glm::vec3(0, 1, 0);
+			lightView = glm::lookAt(-direction, glm::vec3(0.0f), up);
+		}
+
+		// Frustum corners in world space, near plane then far plane
+		glm::mat4 invViewProjection = glm::inverse(projection * view);
+		glm::vec3 nearCorners[4], farCorners[4];
+		const glm::vec2 ndc[4] = { glm::vec2(-1, -1), glm::vec2(1, -1), glm::vec2(1, 1), glm::vec2(-1, 1) };
+		for (int c = 0; c < 4; c++)
+		{
+			glm::vec4 pn = invViewProjection * glm::vec4(ndc[c].x, ndc[c].y, -1.0f, 1.0f);
+			glm::vec4 pf = invViewProjection * glm::vec4(ndc[c].x, ndc[c].y, 1.0f, 1.0f);
+			nearCorners[c] = glm::vec3(pn) / pn.w;
+			farCorners[c] = glm::vec3(pf) / pf.w;
+		}
+
+		int dirtyCount = 0;
+		for (int i = 0; i < shadow_cascade_count; i++)
+		{
+			// Slice corners: points on a corner ray are linear in view depth
+			float t0 = ((i == 0 ? n : splits[i - 1]) - n) / (f - n);
+			float t1 = (splits[i] - n) / (f - n);
+			glm::vec3 corners[8];
+			glm::vec3 center(0.0f);
+			for (int c = 0; c < 4; c++)
+			{
+				corners[c] = glm::mix(nearCorners[c], farCorners[c], t0);
+				corners[c + 4] = glm::mix(nearCorners[c], farCorners[c], t1);
+				center += corners[c] + corners[c + 4];
+			}
+			center /= 8.0f;
+
+			// Bounding sphere keeps the same size when the camera turns
+			float radius = 0.0f;
+			for (int c = 0; c < 8; c++)
+				radius = std::max(radius, glm::length(corners[c] - center));
+			radius = std::ceil(radius * 16.0f) / 16.0f;
+
+			Cascade& cascade = cascades[i];
+			bool covered = cascade.valid && glm::length(center - cascade.center) + radius <= cascade.coverRadius;
+			if (covered && !lightMoved && cacheStatic)
+			{
+				// Still fits, but the terrain under it was edited
+				if (cascade.dirty)
+					dirtyCount++;
+				continue;
+			}
+
+			cascade.center = center;
+			cascade.coverRadius = radius * (1.0f + moveThreshold);
+
+			// Snap the center to whole texels, so re-renders do not shimmer
+			float texel = 2.0f * cascade.coverRadius / float(resolution);
+			glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1.0f));
+			lightCenter.x = std::floor(lightCenter.x / texel) * texel;
+			lightCenter.y = std::floor(lightCenter.y / texel) * texel;
+
+			glm::mat4 lightProjection = glm::ortho(
+				lightCenter.x - cascade.coverRadius, lightCenter.x + cascade.coverRadius,
+				lightCenter.y - cascade.coverRadius, lightCenter.y + cascade.coverRadius,
+				-lightCenter.z - depthRange, -lightCenter.z + depthRange);
+			cascade.matrix = lightProjection * lightView;
+			cascade.valid = true;
+			cascade.dirty = true;
+			dirtyCount++;
+		}
+		return dirtyCount;
+	}
+
+	// Chunks overlapping the cascade, in light clip space XY
+	void CullChunks(int cascade, const std::vector<TerrainChunk>& chunks, std::vector<unsigned int>& out_visible) const
+	{
+		out_visible.clear();
+		const glm::mat4& m = cascades[cascade].matrix;
+		for (unsigned int i = 0; i < chunks.size(); i++)
+		{
+			glm::vec2 lo(FLT_MAX), hi(-FLT_MAX);
+			for (int c = 0; c < 8; c++)
+			{
+				glm::vec3 corner(
+					(c & 1) ? chunks[i].boundsMax.x : chunks[i].boundsMin.x,
+					(c & 2) ? chunks[i].boundsMax.y : chunks[i].boundsMin.y,
+					(c & 4) ? chunks[i].boundsMax.z : chunks[i].boundsMin.z);
+				glm::vec4 p = m * glm::vec4(corner, 1.0f);
+				lo = glm::min(lo, glm::vec2(p.x, p.y));
+				hi = glm::max(hi, glm::vec2(p.x, p.y));
+			}
+			if (hi.x >= -1.0f && lo.x <= 1.0f && hi.y >= -1.0f && lo.y <= 1.0f)
+				out_visible.push_back(i);
+		}
+	}
+
+	// Geometry inside the box changed: re-render the cascades that can see it, keeping their fit
+	void InvalidateBox(const glm::vec3& box_min, const glm::vec3& box_max)
+	{
+		for (Cascade& cascade : cascades)
+		{
+			if (!cascade.valid)
+				continue;
+			glm::vec2 lo(FLT_MAX), hi(-FLT_MAX);
+			for (int c = 0; c < 8; c++)
+			{
+				glm::vec3 corner((c & 1) ? box_max.x : box_min.x, (c & 2) ? box_max.y : box_min.y, (c & 4) ? box_max.z : box_min.z);
+				glm::vec4 p = cascade.matrix * glm::vec4(corner, 1.0f);
+				lo = glm::min(lo, glm::vec2(p.x, p.y));
+				hi = glm::max(hi, glm::vec2(p.x, p.y));
+			}
+			if (hi.x >= -1.0f && lo.x <= 1.0f && hi.y >= -1.0f && lo.y <= 1.0f)
+				cascade.dirty = true;
+		}
+	}
+
+	// Render target: one layer of the array
+	void BindCascade(int cascade)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, textureID, 0, cascade);
+		glViewport(0, 0, resolution, resolution);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		cascades[cascade].dirty = false;
+	}
+
+	void UnBind()
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	void Active(unsigned int slot) const
+	{
+		glActiveTexture(GL_TEXTURE0 + slot);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+	}
+
+	// Matrices and split distances for the receivers
+	void SetShaderUniforms(unsigned int programID, unsigned int slot) const
+	{
+		glm::mat4 matrices[shadow_cascade_count];
+		for (int i = 0; i < shadow_cascade_count; i++)
+			matrices[i] = cascades[i].matrix;
+
+		glUniform1i(glGetUniformLocation(programID, "ShadowMap"), slot);
+		glUniformMatrix4fv(glGetUniformLocation(programID, "ShadowMatrices"), shadow_cascade_count, GL_FALSE, &matrices[0][0][0]);
+		glUniform4fv(glGetUniformLocation(programID, "CascadeSplits"), 1, splits);
+	}
+
+	bool IsDirty(int cascade) const { return cascades[cascade].dirty; }
+	const glm::mat4& GetMatrix(int cascade) const { return cascades[cascade].matrix; }
+};
\ No newline at end of file
@@ -0,0 +1,88 @@
+#pragma once
+/*
+	Sky and Aerial Perspective on the GPU, from the tables of Atmosphere.hpp.
+	The sky is a full screen triangle on the far plane, drawn after the opaque passes of a view.
+	The terrain shaders add the haze with one fetch of the aerial perspective volume per pixel.
+*/
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Atmosphere.hpp"
+#include "GLResource.hpp"
+
+class Sky
+{
+private:
+	TextureHandle skyViewID;
+	TextureHandle aerialID;
+
+	glm::vec3 sunDirection = glm::vec3(0.0f, 1.0f, 0.0f);
+	glm::vec3 sunColor = glm::vec3(1.0f);
+	float kmPerUnit = 0.0f;
+	float aerialDistance = 1.0f;
+public:
+	Sky()
+	{
+		skyViewID.Reset(GenTexture(), int64_t(sky_view_width) * sky_view_height * 6);
+		glBindTexture(GL_TEXTURE_2D, skyViewID);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, sky_view_width, sky_view_height, 0, GL_RGB, GL_FLOAT, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		aerialID.Reset(GenTexture(), int64_t(aerial_size) * aerial_size * aerial_size * 8);
+		glBindTexture(GL_TEXTURE_3D, aerialID);
+		glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA16F, aerial_size, aerial_size, aerial_size, 0, GL_RGBA, GL_FLOAT, nullptr);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	}
+
+	// Copy the tables of the latest Atmosphere::Bake
+	void Upload(const Atmosphere& atmosphere)
+	{
+		glBindTexture(GL_TEXTURE_2D, skyViewID);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, sky_view_width, sky_view_height, GL_RGB, GL_FLOAT, atmosphere.GetSkyView());
+		glBindTexture(GL_TEXTURE_3D, aerialID);
+		glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, aerial_size, aerial_size, aerial_size, GL_RGBA, GL_FLOAT, atmosphere.GetAerialPerspective());
+
+		sunDirection = atmosphere.GetSunDirection();
+		sunColor = atmosphere.SunColor();
+		kmPerUnit = atmosphere.GetSettings().kmPerUnit;
+		aerialDistance = atmosphere.GetSettings().aerialDistance;
+	}
+
+	// Sky view in slot, aerial perspective in slot + 1
+	void Active(unsigned int slot) const
+	{
+		glActiveTexture(GL_TEXTURE0 + slot);
+		glBindTexture(GL_TEXTURE_2D, skyViewID);
+		glActiveTexture(GL_TEXTURE0 + slot + 1);
+		glBindTexture(GL_TEXTURE_3D, aerialID);
+	}
+	void SetShaderUniforms(unsigned int programID, unsigned int slot, bool enabled) const
+	{
+		glUniform1i(glGetUniformLocation(programID, "SkyViewSampler"), slot);
+		glUniform1i(glGetUniformLocation(programID, "AerialPerspectiveSampler"), slot + 1);
+		glUniform3fv(glGetUniformLocation(programID, "SunDirection"), 1, &sunDirection[0]);
+		glUniform3fv(glGetUniformLocation(programID, "SunColor"), 1, &sunColor[0]);
+		glUniform1f(glGetUniformLocation(programID, "KmPerUnit"), kmPerUnit);
+		glUniform1f(glGetUniformLocation(programID, "AerialDistance"), aerialDistance);
+		glUniform1i(glGetUniformLocation(programID, "AtmosphereEnabled"), enabled ? 1 : 0);
+	}
+
+	// Only where nothing was drawn: the triangle sits on the far plane.
+	// The terrain VAO stays bound, the triangle reads no attribute.
+	void Draw() const
+	{
+		glDepthFunc(GL_LEQUAL);
+		glDepthMask(GL_FALSE);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		glDepthMask(GL_TRUE);
+		glDepthFunc(GL_LESS);
+	}
+};
\ No newline at end of file
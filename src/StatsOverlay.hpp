@@ -0,0 +1,240 @@
+#pragma once
+/*
+	On-Screen Stats: text lines and a bar graph over the scene, in window pixels from the top left.
+	The font is a built-in 5x7 bitmap (upper case, digits and some punctuation) in a small R8 atlas.
+	Every frame the quads are rebuilt on the CPU into one stream buffer and drawn in one call.
+*/
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <cctype>
+#include <cstddef>
+#include <algorithm>
+
+#include "GLResource.hpp"
+
+// 5x7 glyphs, rows from the top, X for a lit pixel
+struct OverlayGlyph
+{
+	char c;
+	const char* rows;
+};
+
+static const OverlayGlyph overlay_font[] = {
+	{ '0', ".XXX.X...XX..XXX.X.XXX..XX...X.XXX." },
+	{ '1', "..X...XX....X....X....X....X...XXX." },
+	{ '2', ".XXX.X...X....X..XX..X...X....XXXXX" },
+	{ '3', ".XXX.X...X....X..XX.....XX...X.XXX." },
+	{ '4', "...X...XX..X.X.X..X.XXXXX...X....X." },
+	{ '5', "XXXXXX....XXXX.....X....XX...X.XXX." },
+	{ '6', "..XX..X...X....XXXX.X...XX...X.XXX." },
+	{ '7', "XXXXX....X...X...X...X....X....X..." },
+	{ '8', ".XXX.X...XX...X.XXX.X...XX...X.XXX." },
+	{ '9', ".XXX.X...XX...X.XXXX....X...X..XX.." },
+	{ 'A', ".XXX.X...XX...XXXXXXX...XX...XX...X" },
+	{ 'B', "XXXX.X...XX...XXXXX.X...XX...XXXXX." },
+	{ 'C', ".XXX.X...XX....X....X....X...X.XXX." },
+	{ 'D', "XXX..X..X.X...XX...XX...XX..X.XXX.." },
+	{ 'E', "XXXXXX....X....XXXX.X....X....XXXXX" },
+	{ 'F', "XXXXXX....X....XXXX.X....X....X...." },
+	{ 'G', ".XXX.X...XX....X.XXXX...XX...X.XXXX" },
+	{ 'H', "X...XX...XX...XXXXXXX...XX...XX...X" },
+	{ 'I', ".XXX...X....X....X....X....X...XXX." },
+	{ 'J', "..XXX...X....X....X....X.X..X..XX.." },
+	{ 'K', "X...XX..X.X.X..XX...X.X..X..X.X...X" },
+	{ 'L', "X....X....X....X....X....X....XXXXX" },
+	{ 'M', "X...XXX.XXX.X.XX.X.XX...XX...XX...X" },
+	{ 'N', "X...XX...XXX..XX.X.XX..XXX...XX...X" },
+	{ 'O', ".XXX.X...XX...XX...XX...XX...X.XXX." },
+	{ 'P', "XXXX.X...XX...XXXXX.X....X....X...." },
+	{ 'Q', ".XXX.X...XX...XX...XX.X.XX..X..XX.X" },
+	{ 'R', "XXXX.X...XX...XXXXX.X.X..X..X.X...X" },
+	{ 'S', ".XXXXX....X.....XXX.....X....XXXXX." },
+	{ 'T', "XXXXX..X....X....X....X....X....X.." },
+	{ 'U', "X...XX...XX...XX...XX...XX...X.XXX." },
+	{ 'V', "X...XX...XX...XX...XX...X.X.X...X.." },
+	{ 'W', "X...XX...XX...XX.X.XX.X.XX.X.X.X.X." },
+	{ 'X', "X...XX...X.X.X...X...X.X.X...XX...X" },
+	{ 'Y', "X...XX...X.X.X...X....X....X....X.." },
+	{ 'Z', "XXXXX....X...X...X...X...X....XXXXX" },
+	{ '.', "..........................XX...XX.." },
+	{ ',', ".....................XX...XX...X..." },
+	{ ':', ".....XX...XX.........XX...XX......." },
+	{ '%', "XX...XX..X...X...X...X...X..XX...XX" },
+	{ '/', ".........X...X...X...X...X........." },
+	{ '-', "...............XXX................." },
+	{ '_', "..............................XXXXX" },
+	{ '+', ".......X....X..XXXXX..X....X......." },
+	{ '=', "..........XXXXX.....XXXXX.........." },
+	{ '(', "...X...X...X....X....X.....X.....X." },
+	{ ')', ".X.....X.....X....X....X...X...X..." },
+	{ '[', ".XXX..X....X....X....X....X....XXX." },
+	{ ']', ".XXX....X....X....X....X....X..XXX." },
+	{ '<', "...X...X...X...X.....X.....X.....X." },
+	{ '>', ".X.....X.....X.....X...X...X...X..." },
+	{ '*', ".......X..X.X.X.XXX.X.X.X..X......." },
+	{ '#', ".X.X..X.X.XXXXX.X.X.XXXXX.X.X..X.X." },
+	{ '\'', "..X....X...X......................." },
+	{ '!', "..X....X....X....X....X.........X.." },
+	{ '?', ".XXX.X...X....X...X...X.........X.." },
+	// Full cell, for panels and bars
+	{ '\x7f', "XXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX" },
+};
+
+class StatsOverlay
+{
+public:
+	// Glyph cell in the atlas and on screen (before the scale): 5x7 and one pixel of spacing
+	static constexpr int cell_width = 6;
+	static constexpr int cell_height = 9;
+	static constexpr int atlas_columns = 16;
+	static constexpr int atlas_rows = 6;
+private:
+	TextureHandle atlasID;
+	VertexArrayHandle VAO;
+	BufferHandle vertexBuffer;
+
+	// x, y in pixels, u, v in the atlas, rgba
+	struct Vertex
+	{
+		float x, y, u, v;
+		float r, g, b, a;
+	};
+	std::vector<Vertex> vertices;
+
+	// Atlas cell of every character, -1 for unknown ones
+	int cellOf[128];
+	int scale = 2;
+
+	void quad(float x0, float y0, float x1, float y1, float u0, float v0, float u1, float v1, const glm::vec4& color)
+	{
+		const Vertex corners[4] = {
+			{ x0, y0, u0, v0, color.x, color.y, color.z, color.w },
+			{ x1, y0, u1, v0, color.x, color.y, color.z, color.w },
+			{ x1, y1, u1, v1, color.x, color.y, color.z, color.w },
+			{ x0, y1, u0, v1, color.x, color.y, color.z, color.w } };
+		static const int order[6] = { 0, 1, 2, 0, 2, 3 };
+		for (int i : order)
+			vertices.push_back(corners[i]);
+	}
+public:
+	StatsOverlay()
+	{
+		for (int& c : cellOf)
+			c = -1;
+
+		const int width = atlas_columns * cell_width, height = atlas_rows * cell_height;
+		std::vector<unsigned char> atlas(size_t(width) * height, 0);
+		int cell = 0;
+		for (const OverlayGlyph& glyph : overlay_font)
+		{
+			const int cx = (cell % atlas_columns) * cell_width, cy = (cell / atlas_columns) * cell_height;
+			for (int y = 0; y < 7; y++)
+				for (int x = 0; x < 5; x++)
+					atlas[size_t(cy + y) * width + cx + x] = glyph.rows[y * 5 + x] == 'X' ? 255 : 0;
+			cellOf[(unsigned char)glyph.c] = cell++;
+		}
+
+		atlasID.Reset(GenTexture(), int64_t(width) * height);
+		glBindTexture(GL_TEXTURE_2D, atlasID);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, atlas.data());
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		// The terrain keeps its VAO bound, so put it back
+		GLint previous = 0;
+		glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previous);
+		VAO.Reset(GenVertexArray());
+		glBindVertexArray(VAO);
+		vertexBuffer.Reset(GenBuffer());
+		glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, x));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, u));
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, r));
+		glBindVertexArray(previous);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	void SetScale(int _scale) { scale = std::max(_scale, 1); }
+	int GetLineHeight() const { return cell_height * scale; }
+	int GetCharWidth() const { return cell_width * scale; }
+
+	// Start a new frame of quads
+	void Clear() { vertices.clear(); }
+
+	void Rect(float x, float y, float width, float height, const glm::vec4& color)
+	{
+		// Middle of the full cell: every texel around it is lit
+		const int cell = cellOf[0x7f];
+		const float u = ((cell % atlas_columns) * cell_width + 2.5f) / float(atlas_columns * cell_width);
+		const float v = ((cell / atlas_columns) * cell_height + 3.5f) / float(atlas_rows * cell_height);
+		quad(x, y, x + width, y + height, u, v, u, v, color);
+	}
+
+	// Lower case prints as upper case, unknown characters as blanks
+	void Text(float x, float y, const std::string& text, const glm::vec4& color)
+	{
+		const float atlasWidth = float(atlas_columns * cell_width), atlasHeight = float(atlas_rows * cell_height);
+		for (char ch : text)
+		{
+			int cell = cellOf[(unsigned char)std::toupper((unsigned char)ch) & 0x7f];
+			if (cell >= 0)
+			{
+				const float u = float((cell % atlas_columns) * cell_width), v = float((cell / atlas_columns) * cell_height);
+				quad(x, y, x + float(cell_width * scale), y + float(cell_height * scale),
+					u / atlasWidth, v / atlasHeight, (u + cell_width) / atlasWidth, (v + cell_height) / atlasHeight, color);
+			}
+			x += float(cell_width * scale);
+		}
+	}
+
+	// Bars from the bottom of the box, one per value; values at max_value fill the box
+	void Graph(float x, float y, float width, float height, const std::vector<float>& values, float max_value, const glm::vec4& color)
+	{
+		if (values.empty() || max_value <= 0.0f)
+			return;
+		const float bar = width / float(values.size());
+		for (size_t i = 0; i < values.size(); i++)
+		{
+			const float h = std::min(values[i] / max_value, 1.0f) * height;
+			Rect(x + bar * float(i), y + height - h, std::max(bar - 1.0f, 1.0f), h, color);
+		}
+	}
+
+	// Draw everything added since Clear, blended over the window
+	void Draw(GLuint program, int screen_width, int screen_height)
+	{
+		if (vertices.empty())
+			return;
+		glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STREAM_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		vertexBuffer.SetMemorySize(int64_t(vertices.size() * sizeof(Vertex)));
+
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, atlasID);
+		glUniform1i(glGetUniformLocation(program, "FontSampler"), 0);
+		glUniform2f(glGetUniformLocation(program, "ScreenSize"), float(screen_width), float(screen_height));
+
+		GLint previous = 0;
+		glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previous);
+		glBindVertexArray(VAO);
+		glDisable(GL_DEPTH_TEST);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glDrawArrays(GL_TRIANGLES, 0, (GLsizei)vertices.size());
+		glDisable(GL_BLEND);
+		glEnable(GL_DEPTH_TEST);
+		glBindVertexArray(previous);
+	}
+};
\ No newline at end of file
@@ -0,0 +1,138 @@
+#pragma once
+/*
+	Split the Terrain Patch Grid into Square Chunks.
+	Every Chunk is a contiguous range of the element buffer, so it can be drawn,
+	sorted and culled on its own.
+*/
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cfloat>
+
+#include "Heightfield.hpp"
+
+struct TerrainChunk
+{
+	// Range inside the element buffer, in indices
+	unsigned int firstIndex;
+	GLsizei count;
+
+	// World space bounds. Y covers the whole encodable range until FitChunkBounds sees the heights.
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+};
+
+// Build patch indices (4 per quad, CW) for a n_points x n_points grid, grouped in chunk_patches x chunk_patches chunks
+static inline void BuildPatchChunks(int n_points, int chunk_patches, const std::vector<glm::vec3>& vertices, std::vector<unsigned int>& out_indices, std::vector<TerrainChunk>& out_chunks)
+{
+	const int n_patches = n_points - 1;
+
+	for (int ci = 0; ci < n_patches; ci += chunk_patches)
+	{
+		for (int cj = 0; cj < n_patches; cj += chunk_patches)
+		{
+			TerrainChunk chunk;
+			chunk.firstIndex = (unsigned int)out_indices.size();
+			chunk.boundsMin = glm::vec3(FLT_MAX, terrain_y_shift, FLT_MAX);
+			chunk.boundsMax = glm::vec3(-FLT_MAX, terrain_y_max, -FLT_MAX);
+
+			for (int i = ci; i < std::min(ci + chunk_patches, n_patches); i++)
+			{
+				for (int j = cj; j < std::min(cj + chunk_patches, n_patches); j++)
+				{
+					int topLeft = i * n_points + j;
+					int topRight = topLeft + 1;
+					int bottomLeft = topLeft + n_points;
+					int bottomRight = bottomLeft + 1;
+					// CW
+					out_indices.push_back(topLeft);
+					out_indices.push_back(topRight);
+					out_indices.push_back(bottomRight);
+					out_indices.push_back(bottomLeft);
+
+					// Corners of the patch are enough to bound the chunk in XZ
+					for (int corner : { topLeft, bottomRight })
+					{
+						chunk.boundsMin.x = std::min(chunk.boundsMin.x, vertices[corner].x);
+						chunk.boundsMin.z = std::min(chunk.boundsMin.z, vertices[corner].z);
+						chunk.boundsMax.x = std::max(chunk.boundsMax.x, vertices[corner].x);
+						chunk.boundsMax.z = std::max(chunk.boundsMax.z, vertices[corner].z);
+					}
+				}
+			}
+
+			chunk.count = (GLsizei)(out_indices.size() - chunk.firstIndex);
+			out_chunks.push_back(chunk);
+		}
+	}
+}
+
+// Fit the Y bounds of the chunks whose height texels overlap dirty to the heights they sample
+static inline void FitChunkBounds(std::vector<TerrainChunk>& chunks, const HeightGrid& heights, const TerrainMapping& mapping, const TexelRect& dirty)
+{
+	for (TerrainChunk& chunk : chunks)
+	{
+		// One texel more on every side: the tessellator samples between texels
+		TexelRect footprint = mapping.WorldToTexels(chunk.boundsMin.x, chunk.boundsMin.z, chunk.boundsMax.x, chunk.boundsMax.z)
+			.Grown(1).Clipped(heights.width, heights.height);
+		TexelRect overlap = {
+			std::max(footprint.x0, dirty.x0), std::max(footprint.y0, dirty.y0),
+			std::min(footprint.x1, dirty.x1), std::min(footprint.y1, dirty.y1) };
+		if (footprint.Empty() || overlap.Empty())
+			continue;
+
+		float lo = FLT_MAX, hi = -FLT_MAX;
+		for (int y = footprint.y0; y < footprint.y1; y++)
+		{
+			for (int x = footprint.x0; x < footprint.x1; x++)
+			{
+				lo = std::min(lo, heights.At(x, y));
+				hi = std::max(hi, heights.At(x, y));
+			}
+		}
+		chunk.boundsMin.y = lo;
+		chunk.boundsMax.y = hi;
+	}
+}
+
+// Squared distance from a point to the chunk bounds, 0 when the point is inside
+static inline float ChunkDistance2(const TerrainChunk& chunk, const glm::vec3& p)
+{
+	glm::vec3 closest = glm::clamp(p, chunk.boundsMin, chunk.boundsMax);
+	glm::vec3 d = p - closest;
+	return glm::dot(d, d);
+}
+
+// Heuristic front-to-back order: nearest bounds first, so early-Z rejects the ridges behind.
+static inline void SortChunksFrontToBack(const std::vector<TerrainChunk>& chunks, const glm::vec3& eye, std::vector<unsigned int>& order)
+{
+	std::vector<float> keys(chunks.size());
+	for (size_t i = 0; i < chunks.size(); i++)
+	{
+		// Center distance breaks the ties between the chunks the camera is above
+		glm::vec3 center = 0.5f * (chunks[i].boundsMin + chunks[i].boundsMax);
+		keys[i] = ChunkDistance2(chunks[i], eye) + 1e-3f * glm::dot(center - eye, center - eye);
+	}
+
+	std::sort(order.begin(), order.end(), [&keys](unsigned int a, unsigned int b) { return keys[a] < keys[b]; });
+}
+
+// Submit a list of chunks with one multi draw call
+static inline void DrawTerrainChunks(const std::vector<TerrainChunk>& chunks, const std::vector<unsigned int>& order)
+{
+	static std::vector<GLsizei> counts;
+	static std::vector<const void*> offsets;
+	counts.clear();
+	offsets.clear();
+
+	for (unsigned int i : order)
+	{
+		counts.push_back(chunks[i].count);
+		offsets.push_back((const void*)(size_t(chunks[i].firstIndex) * sizeof(unsigned int)));
+	}
+
+	glMultiDrawElements(GL_PATCHES, counts.data(), GL_UNSIGNED_INT, offsets.data(), (GLsizei)order.size());
+}
\ No newline at end of file
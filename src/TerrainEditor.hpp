@@ -0,0 +1,178 @@
+#pragma once
+/*
+	Height Editing on the CPU copy of the height map.
+	Brushes change the heights and grow a dirty rectangle. The renderer then uploads only that
+	rectangle, and recomputes what depends on it for the texels around it.
+*/
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "Heightfield.hpp"
+
+enum class BrushMode
+{
+	Raise,
+	Lower,
+	Flatten,
+	Smooth,
+	Count
+};
+
+static inline const char* BrushModeName(BrushMode mode)
+{
+	static const char* names[] = { "Raise", "Lower", "Flatten", "Smooth" };
+	return names[int(mode)];
+}
+
+struct Brush
+{
+	BrushMode mode = BrushMode::Raise;
+	// World units
+	float radius = 3.0f;
+	// Raise and Lower: height change per second at the center, in world units
+	float strength = 8.0f;
+	// Flatten and Smooth: how fast heights move to their target, per second
+	float rate = 4.0f;
+	// Flatten target, picked when a stroke starts
+	float targetHeight = 0.0f;
+};
+
+class TerrainEditor
+{
+private:
+	HeightGrid& heights;
+	TerrainMapping mapping;
+	TexelRect dirty;
+
+	// Heights before a smoothing step, so the result does not depend on the texel order
+	HeightGrid before;
+
+	float sample(float x, float z) const
+	{
+		return heights.Bilinear(mapping.WorldToTexelX(x) - 0.5f, mapping.WorldToTexelY(z) - 0.5f);
+	}
+public:
+	TerrainEditor(HeightGrid& _heights, const TerrainMapping& _mapping) : heights(_heights), mapping(_mapping) {}
+
+	// First point where the ray goes below the terrain, marched at half a texel
+	bool Raycast(const glm::vec3& origin, const glm::vec3& direction, float max_distance, glm::vec3& out_hit) const
+	{
+		const float step = 0.5f * mapping.Spacing();
+		glm::vec3 dir = glm::normalize(direction);
+		float previous = 0.0f;
+		for (float t = 0.0f; t <= max_distance; t += step)
+		{
+			glm::vec3 p = origin + dir * t;
+			if (p.y <= sample(p.x, p.z))
+			{
+				// Bisection between the last point above and the first point below
+				float lo = previous, hi = t;
+				for (int i = 0; i < 12; i++)
+				{
+					float mid = 0.5f * (lo + hi);
+					glm::vec3 m = origin + dir * mid;
+					if (m.y <= sample(m.x, m.z))
+						hi = mid;
+					else
+						lo = mid;
+				}
+				out_hit = origin + dir * hi;
+				float tx = mapping.WorldToTexelX(out_hit.x), ty = mapping.WorldToTexelY(out_hit.z);
+				return tx >= 0.0f && ty >= 0.0f && tx < float(heights.width) && ty < float(heights.height);
+			}
+			previous = t;
+		}
+		return false;
+	}
+
+	// One brush step of seconds at world (x, z). Returns the texels it changed.
+	TexelRect Apply(const Brush& brush, float x, float z, float seconds)
+	{
+		const float cx = mapping.WorldToTexelX(x) - 0.5f;
+		const float cy = mapping.WorldToTexelY(z) - 0.5f;
+		const float radius = std::max(brush.radius / mapping.Spacing(), 1.0f);
+
+		TexelRect rect = TexelRect{ (int)std::floor(cx - radius), (int)std::floor(cy - radius),
+			(int)std::ceil(cx + radius) + 1, (int)std::ceil(cy + radius) + 1 }.Clipped(heights.width, heights.height);
+		if (rect.Empty())
+			return rect;
+
+		if (brush.mode == BrushMode::Smooth)
+		{
+			before.Resize(rect.Width() + 2, rect.Height() + 2);
+			for (int y = 0; y < before.height; y++)
+				for (int x = 0; x < before.width; x++)
+					before.At(x, y) = heights.Clamped(rect.x0 - 1 + x, rect.y0 - 1 + y);
+		}
+
+		for (int y = rect.y0; y < rect.y1; y++)
+		{
+			for (int x = rect.x0; x < rect.x1; x++)
+			{
+				float d = std::sqrt((float(x) - cx) * (float(x) - cx) + (float(y) - cy) * (float(y) - cy)) / radius;
+				if (d >= 1.0f)
+					continue;
+				// Smooth falloff to the rim
+				float w = 1.0f - d * d;
+				w *= w;
+
+				float& h = heights.At(x, y);
+				float blend = std::min(1.0f, brush.rate * seconds * w);
+				switch (brush.mode)
+				{
+				case BrushMode::Raise: h += brush.strength * seconds * w; break;
+				case BrushMode::Lower: h -= brush.strength * seconds * w; break;
+				case BrushMode::Flatten: h += (brush.targetHeight - h) * blend; break;
+				case BrushMode::Smooth:
+				{
+					int bx = x - rect.x0 + 1, by = y - rect.y0 + 1;
+					float average = 0.0f;
+					for (int j = -1; j <= 1; j++)
+						for (int i = -1; i <= 1; i++)
+							average += before.At(bx + i, by + j);
+					h += (average / 9.0f - h) * blend;
+					break;
+				}
+				default: break;
+				}
+				// Stay inside what the 24-bit encoding can store
+				h = std::min(std::max(h, terrain_y_shift), terrain_y_max);
+			}
+		}
+
+		dirty = dirty.Union(rect);
+		return rect;
+	}
+
+	// Texels changed since the last call
+	TexelRect TakeDirty()
+	{
+		TexelRect rect = dirty;
+		dirty = TexelRect();
+		return rect;
+	}
+
+	// Heights of rect as packed RGB, rows tightly packed, ready for glTexSubImage2D
+	void EncodeRegion(const TexelRect& rect, std::vector<unsigned char>& out) const
+	{
+		out.resize(size_t(rect.Width()) * rect.Height() * 3);
+		unsigned char* dst = out.data();
+		for (int y = rect.y0; y < rect.y1; y++)
+		{
+			for (int x = rect.x0; x < rect.x1; x++)
+			{
+				unsigned int code = EncodeHeight(heights.At(x, y));
+				*dst++ = (unsigned char)(code >> 16);
+				*dst++ = (unsigned char)(code >> 8);
+				*dst++ = (unsigned char)code;
+			}
+		}
+	}
+
+	float HeightAt(float x, float z) const { return sample(x, z); }
+	const TerrainMapping& GetMapping() const { return mapping; }
+};
\ No newline at end of file
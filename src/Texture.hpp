@@ -4,37 +4,141 @@
 */ 
 
 #include "BMPLoader.hpp"
+#include "TextureBaker.hpp"
+#include "GLResource.hpp"
+
+#include <string>
 
 class Texture
 {
 private:
-	unsigned int ID;
-	unsigned int slot;
+	// Owns the GL texture, and its video memory size (mip levels included)
+	TextureHandle ID;
+	unsigned int slot = 0;
+
+	std::string file_name;
+
+	int texWidth = 0;
+	int texHeight = 0;
+	// Channels of an uncompressed texture, 0 for block compressed ones
+	int texChannels = 0;
+	bool texMipmaps = false;
+
+	static GLenum byteFormat(int channels)
+	{
+		static const GLenum formats[4] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+		return formats[channels - 1];
+	}
+
+	static GLenum byteInternalFormat(int channels)
+	{
+		static const GLenum formats[4] = { GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 };
+		return formats[channels - 1];
+	}
+
+	// Upload baked levels as they are: No decompression, No glGenerateMipmap
+	void uploadCompressed(const BakedTexture& baked)
+	{
+		GLenum internal_format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		if (baked.format == BlockFormat::BC4) internal_format = GL_COMPRESSED_RED_RGTC1;
+		if (baked.format == BlockFormat::BC5) internal_format = GL_COMPRESSED_RG_RGTC2;
+
+		int64_t memorySize = 0;
+		this->ID.Reset(GenTexture());
+		glBindTexture(GL_TEXTURE_2D, this->ID);
+		for (size_t i = 0; i < baked.levels.size(); i++)
+		{
+			const CompressedLevel& level = baked.levels[i];
+			glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, internal_format, level.width, level.height, 0, (GLsizei)level.blocks.size(), level.blocks.data());
+			memorySize += level.blocks.size();
+		}
+		this->ID.SetMemorySize(memorySize);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)baked.levels.size() - 1);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 
-	const char* file_name;
+		// One channel maps read the same value in .rgb, like the grey RGB maps they replace
+		if (baked.format == BlockFormat::BC4)
+		{
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_RED);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
 
-	int texWidth;
-	int texHeight;
+		texWidth = baked.levels[0].width;
+		texHeight = baked.levels[0].height;
+	}
 public:
 	Texture() = default;
 	
-	Texture(const char* _name)
+	Texture(const char* _name) : Texture(_name, GL_LINEAR_MIPMAP_LINEAR)
 	{
-		this->file_name = _name;
-		this->ID  = loadBMP_custom(file_name, GL_LINEAR_MIPMAP_LINEAR, GL_MIRRORED_REPEAT, texWidth, texHeight);
 	}
 
 	Texture(const char* _name, GLenum tex_option)
 	{
 		this->file_name = _name;
-		this->ID = loadBMP_custom(file_name, tex_option, GL_MIRRORED_REPEAT, texWidth, texHeight);
+		unsigned int id = loadBMP_custom(file_name.c_str(), tex_option, GL_MIRRORED_REPEAT, texWidth, texHeight);
+		texChannels = 3;
+		texMipmaps = tex_option != GL_NEAREST;
+		// RGB8, and a full mip chain unless the filter never reads it
+		this->ID.Reset(id, int64_t(texWidth) * texHeight * 3 * (tex_option == GL_NEAREST ? 3 : 4) / 3);
+	}
+
+	// Block compressed texture, baked once and cached on disk
+	Texture(const char* _name, BlockFormat format)
+	{
+		this->file_name = _name;
+		BakedTexture baked;
+		if (BakeTexture(file_name.c_str(), format, baked))
+			uploadCompressed(baked);
 	}
 
-	~Texture()
+	// 8 bit texture made from memory, rows tightly packed. Mip mapped filters get a full mip chain.
+	Texture(int width, int height, int channels, const unsigned char* data, GLenum filter = GL_LINEAR_MIPMAP_LINEAR)
 	{
-		glDeleteTextures(1, &this->ID);
+		texWidth = width;
+		texHeight = height;
+		texChannels = channels;
+		texMipmaps = filter != GL_LINEAR && filter != GL_NEAREST;
+		this->ID.Reset(GenTexture(), int64_t(width) * height * channels * (texMipmaps ? 4 : 3) / 3);
+		glBindTexture(GL_TEXTURE_2D, this->ID);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, byteInternalFormat(channels), width, height, 0, byteFormat(channels), GL_UNSIGNED_BYTE, data);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter == GL_NEAREST ? GL_NEAREST : GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+		if (texMipmaps)
+			glGenerateMipmap(GL_TEXTURE_2D);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	// Replace a rectangle of an uncompressed texture. data: its first texel, RGB order, row_length texels
+	// per row (0: w). Only the rectangle is uploaded; textures with mips rebuild them all, so keep edited
+	// textures mip free.
+	void Update(int x, int y, int w, int h, const unsigned char* data, int row_length = 0)
+	{
+		if (texChannels == 0 || w <= 0 || h <= 0)
+			return;
+		glBindTexture(GL_TEXTURE_2D, this->ID);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, row_length);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, byteFormat(texChannels), GL_UNSIGNED_BYTE, data);
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		if (texMipmaps)
+			glGenerateMipmap(GL_TEXTURE_2D);
+		glBindTexture(GL_TEXTURE_2D, 0);
 	}
 
+	// Move only: the GL texture has one owner
+	Texture(Texture&&) = default;
+	Texture& operator=(Texture&&) = default;
+
 	void Active(unsigned int _slot)
 	{
 		slot = _slot;
@@ -56,4 +160,7 @@ public:
 
 	int GetWidth() const { return texWidth; }
 	int GetHeight() const { return texHeight; }
+	size_t GetMemorySize() const { return (size_t)ID.GetMemorySize(); }
+	unsigned int GetID() const { return ID; }
+	const std::string& GetFileName() const { return file_name; }
 };
\ No newline at end of file
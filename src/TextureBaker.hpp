@@ -0,0 +1,193 @@
+#pragma once
+/*
+	Bake BMP textures into block compressed mip chains, cached on disk next to the source.
+	First run: decode, build the mips, compress on all cores, write "<image>.bcN".
+	Next runs: read the cache, as long as the source file has not changed.
+*/
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+
+#include "BMPReader.hpp"
+#include "TextureCompressor.hpp"
+
+struct BakedTexture
+{
+	BlockFormat format = BlockFormat::BC1;
+	std::vector<CompressedLevel> levels;
+};
+
+namespace baker
+{
+	static constexpr uint32_t cache_magic = 0x4342544C; // "LTBC"
+	static constexpr uint32_t cache_version = 1;
+
+	// Identifies the source file: the cache is stale when any of this changes
+	struct SourceStamp
+	{
+		uint64_t size = 0;
+		int64_t time = 0;
+	};
+
+	static inline bool GetSourceStamp(const char* path, SourceStamp& stamp)
+	{
+		std::error_code error;
+		stamp.size = (uint64_t)std::filesystem::file_size(path, error);
+		if (error)
+			return false;
+		stamp.time = (int64_t)std::filesystem::last_write_time(path, error).time_since_epoch().count();
+		return !error;
+	}
+
+	static inline std::string CachePath(const char* path, BlockFormat format)
+	{
+		return std::string(path) + ".bc" + std::to_string(int(format));
+	}
+
+	static inline bool ReadCache(const std::string& cache_path, const SourceStamp& stamp, BlockFormat format, BakedTexture& out)
+	{
+		FILE* file = fopen(cache_path.c_str(), "rb");
+		if (!file)
+			return false;
+
+		uint32_t header[4];
+		SourceStamp cached;
+		bool ok = fread(header, sizeof(header), 1, file) == 1
+			&& fread(&cached, sizeof(cached), 1, file) == 1
+			&& header[0] == cache_magic && header[1] == cache_version && header[2] == uint32_t(format)
+			&& cached.size == stamp.size && cached.time == stamp.time;
+
+		out.format = format;
+		out.levels.clear();
+		for (uint32_t i = 0; ok && i < header[3]; i++)
+		{
+			int32_t size[2];
+			uint64_t bytes;
+			ok = fread(size, sizeof(size), 1, file) == 1 && fread(&bytes, sizeof(bytes), 1, file) == 1;
+			if (!ok)
+				break;
+
+			CompressedLevel level;
+			level.width = size[0];
+			level.height = size[1];
+			level.blocks.resize(bytes);
+			ok = fread(level.blocks.data(), 1, bytes, file) == bytes;
+			out.levels.push_back(std::move(level));
+		}
+
+		fclose(file);
+		return ok && !out.levels.empty();
+	}
+
+	static inline void WriteCache(const std::string& cache_path, const SourceStamp& stamp, const BakedTexture& baked)
+	{
+		FILE* file = fopen(cache_path.c_str(), "wb");
+		if (!file)
+		{
+			printf("Could not write the texture cache %s\n", cache_path.c_str());
+			return;
+		}
+
+		uint32_t header[4] = { cache_magic, cache_version, uint32_t(baked.format), uint32_t(baked.levels.size()) };
+		fwrite(header, sizeof(header), 1, file);
+		fwrite(&stamp, sizeof(stamp), 1, file);
+		for (const CompressedLevel& level : baked.levels)
+		{
+			int32_t size[2] = { level.width, level.height };
+			uint64_t bytes = level.blocks.size();
+			fwrite(size, sizeof(size), 1, file);
+			fwrite(&bytes, sizeof(bytes), 1, file);
+			fwrite(level.blocks.data(), 1, level.blocks.size(), file);
+		}
+		fclose(file);
+	}
+}
+
+// Decode a 24 bit BMP into the channels a format needs: RGB for BC1, the mean of RGB for BC4, RG for BC5
+static inline bool LoadBMPImage(const char* path, BlockFormat format, Image& out)
+{
+	std::vector<unsigned char> data;
+	if (!readBMP_custom(path, out.width, out.height, data))
+		return false;
+
+	// Rows are padded to 4 bytes in the file
+	size_t stride = (size_t(out.width) * 3 + 3) & ~size_t(3);
+	if (data.size() < stride * out.height)
+		stride = size_t(out.width) * 3;
+	if (data.size() < stride * out.height)
+	{
+		printf("%s is truncated\n", path);
+		return false;
+	}
+
+	out.channels = BlockChannels(format);
+	out.pixels.resize(size_t(out.width) * out.height * out.channels);
+	for (int y = 0; y < out.height; y++)
+	{
+		for (int x = 0; x < out.width; x++)
+		{
+			const unsigned char* bgr = &data[y * stride + size_t(x) * 3];
+			unsigned char* dst = &out.pixels[(size_t(y) * out.width + x) * out.channels];
+			if (format == BlockFormat::BC4)
+				dst[0] = (unsigned char)((int(bgr[0]) + bgr[1] + bgr[2] + 1) / 3);
+			else
+			{
+				dst[0] = bgr[2];
+				dst[1] = bgr[1];
+				if (out.channels > 2)
+					dst[2] = bgr[0];
+			}
+		}
+	}
+	return true;
+}
+
+// Compress a whole mip chain, and report its quality and speed
+static inline void BakeImage(const Image& base, BlockFormat format, BakedTexture& out, const char* name)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	std::vector<Image> chain = BuildMipChain(base);
+	out.format = format;
+	out.levels.clear();
+	size_t pixels = 0;
+	for (const Image& mip : chain)
+	{
+		out.levels.push_back(CompressImage(mip, format));
+		pixels += size_t(mip.width) * mip.height;
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	printf("Baked %s: BC%d, %d levels, %.2f dB PSNR, %.1f MPixels/s\n", name, int(format), (int)out.levels.size(),
+		ComputePSNR(base, out.levels[0], format), double(pixels) / (seconds * 1e6));
+}
+
+// Baked levels of a BMP file, from the disk cache when it is still valid
+static inline bool BakeTexture(const char* path, BlockFormat format, BakedTexture& out)
+{
+	baker::SourceStamp stamp;
+	if (!baker::GetSourceStamp(path, stamp))
+	{
+		printf("%s could not be opened. Are you in the right directory ? !\n", path);
+		return false;
+	}
+
+	std::string cachePath = baker::CachePath(path, format);
+	if (baker::ReadCache(cachePath, stamp, format, out))
+	{
+		printf("Reading baked image %s\n", cachePath.c_str());
+		return true;
+	}
+
+	Image base;
+	if (!LoadBMPImage(path, format, base))
+		return false;
+
+	BakeImage(base, format, out, path);
+	baker::WriteCache(cachePath, stamp, out);
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,447 @@
+#pragma once
+/*
+	CPU Block Compression: BC1 for colors, BC4 for one channel, BC5 for two channels (normals).
+	Blocks are encoded on every core, and the palette searches use SSE2 when the compiler has it.
+	No OpenGL here, so the offline tools can use it too.
+*/
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cfloat>
+#include <algorithm>
+
+#include "Parallel.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TEXTURE_COMPRESSOR_SSE2 1
+#endif
+
+enum class BlockFormat
+{
+	BC1 = 1,	// RGB, 4 bits per pixel
+	BC4 = 4,	// R, 4 bits per pixel
+	BC5 = 5,	// RG, 8 bits per pixel
+};
+
+// Uncompressed image: 8 bits per channel, tightly packed rows, first row first
+struct Image
+{
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+	std::vector<unsigned char> pixels;
+};
+
+// One compressed mip level
+struct CompressedLevel
+{
+	int width = 0;
+	int height = 0;
+	std::vector<unsigned char> blocks;
+};
+
+static inline int BlockBytes(BlockFormat format)
+{
+	return format == BlockFormat::BC5 ? 16 : 8;
+}
+
+// Channels a format keeps from the source image
+static inline int BlockChannels(BlockFormat format)
+{
+	return format == BlockFormat::BC1 ? 3 : (format == BlockFormat::BC4 ? 1 : 2);
+}
+
+// 2x2 box filter, odd sizes clamp to the edge
+static inline Image DownsampleImage(const Image& src)
+{
+	Image dst;
+	dst.width = std::max(1, src.width / 2);
+	dst.height = std::max(1, src.height / 2);
+	dst.channels = src.channels;
+	dst.pixels.resize(size_t(dst.width) * dst.height * dst.channels);
+
+	for (int y = 0; y < dst.height; y++)
+	{
+		int y0 = std::min(2 * y, src.height - 1), y1 = std::min(2 * y + 1, src.height - 1);
+		for (int x = 0; x < dst.width; x++)
+		{
+			int x0 = std::min(2 * x, src.width - 1), x1 = std::min(2 * x + 1, src.width - 1);
+			for (int c = 0; c < dst.channels; c++)
+			{
+				int sum = src.pixels[(size_t(y0) * src.width + x0) * src.channels + c]
+					+ src.pixels[(size_t(y0) * src.width + x1) * src.channels + c]
+					+ src.pixels[(size_t(y1) * src.width + x0) * src.channels + c]
+					+ src.pixels[(size_t(y1) * src.width + x1) * src.channels + c];
+				dst.pixels[(size_t(y) * dst.width + x) * dst.channels + c] = (unsigned char)((sum + 2) / 4);
+			}
+		}
+	}
+	return dst;
+}
+
+// Full mip chain down to 1x1, base level included
+static inline std::vector<Image> BuildMipChain(const Image& base)
+{
+	std::vector<Image> chain;
+	chain.push_back(base);
+	while (chain.back().width > 1 || chain.back().height > 1)
+		chain.push_back(DownsampleImage(chain.back()));
+	return chain;
+}
+
+namespace bc
+{
+	static inline uint16_t Pack565(const float c[3])
+	{
+		int r = std::min(31, std::max(0, int(c[0] * (31.0f / 255.0f) + 0.5f)));
+		int g = std::min(63, std::max(0, int(c[1] * (63.0f / 255.0f) + 0.5f)));
+		int b = std::min(31, std::max(0, int(c[2] * (31.0f / 255.0f) + 0.5f)));
+		return (uint16_t)((r << 11) | (g << 5) | b);
+	}
+
+	static inline void Unpack565(uint16_t v, float out[3])
+	{
+		int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+		out[0] = float((r << 3) | (r >> 2));
+		out[1] = float((g << 2) | (g >> 4));
+		out[2] = float((b << 3) | (b >> 2));
+	}
+
+	// Nearest palette entry for 16 pixels (planar r, g, b). Returns the squared error.
+	static inline float SelectIndices4(const float* r, const float* g, const float* b, const float palette[4][3], int indices[16])
+	{
+		float error = 0.0f;
+#ifdef TEXTURE_COMPRESSOR_SSE2
+		// 4 pixels at once, against each palette entry
+		for (int p = 0; p < 16; p += 4)
+		{
+			__m128 R = _mm_loadu_ps(r + p), G = _mm_loadu_ps(g + p), B = _mm_loadu_ps(b + p);
+			__m128 bestD = _mm_set1_ps(FLT_MAX);
+			__m128i bestI = _mm_setzero_si128();
+			for (int k = 0; k < 4; k++)
+			{
+				__m128 dr = _mm_sub_ps(R, _mm_set1_ps(palette[k][0]));
+				__m128 dg = _mm_sub_ps(G, _mm_set1_ps(palette[k][1]));
+				__m128 db = _mm_sub_ps(B, _mm_set1_ps(palette[k][2]));
+				__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db));
+				__m128i closer = _mm_castps_si128(_mm_cmplt_ps(d, bestD));
+				bestD = _mm_min_ps(d, bestD);
+				bestI = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(k)), _mm_andnot_si128(closer, bestI));
+			}
+			_mm_storeu_si128((__m128i*)(indices + p), bestI);
+			float d[4];
+			_mm_storeu_ps(d, bestD);
+			error += d[0] + d[1] + d[2] + d[3];
+		}
+#else
+		for (int p = 0; p < 16; p++)
+		{
+			float bestD = FLT_MAX;
+			for (int k = 0; k < 4; k++)
+			{
+				float dr = r[p] - palette[k][0], dg = g[p] - palette[k][1], db = b[p] - palette[k][2];
+				float d = dr * dr + dg * dg + db * db;
+				if (d < bestD) { bestD = d; indices[p] = k; }
+			}
+			error += bestD;
+		}
+#endif
+		return error;
+	}
+
+	// Quantize two endpoints and pick the indices. Returns the squared error.
+	static inline float FitBC1(const float* r, const float* g, const float* b, const float end0[3], const float end1[3], uint16_t& c0, uint16_t& c1, uint32_t& bits, int indices[16])
+	{
+		c0 = Pack565(end0);
+		c1 = Pack565(end1);
+		// 4 color mode needs c0 > c1; equal endpoints mean a flat block
+		if (c0 < c1)
+			std::swap(c0, c1);
+
+		float palette[4][3];
+		Unpack565(c0, palette[0]);
+		Unpack565(c1, palette[1]);
+		for (int c = 0; c < 3; c++)
+		{
+			palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+			palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+		}
+		if (c0 == c1)
+		{
+			// 3 color mode: only index 0 is safe
+			palette[1][0] = palette[2][0] = palette[3][0] = FLT_MAX;
+		}
+
+		float error = SelectIndices4(r, g, b, palette, indices);
+		bits = 0;
+		for (int p = 0; p < 16; p++)
+			bits |= uint32_t(indices[p]) << (2 * p);
+		return error;
+	}
+
+	static inline void EncodeBC1Block(const float* r, const float* g, const float* b, unsigned char out[8])
+	{
+		// Principal axis of the colors, by power iteration on the covariance
+		float mean[3] = { 0, 0, 0 };
+		for (int p = 0; p < 16; p++) { mean[0] += r[p]; mean[1] += g[p]; mean[2] += b[p]; }
+		for (int c = 0; c < 3; c++) mean[c] /= 16.0f;
+
+		float cov[6] = { 0, 0, 0, 0, 0, 0 };
+		for (int p = 0; p < 16; p++)
+		{
+			float d[3] = { r[p] - mean[0], g[p] - mean[1], b[p] - mean[2] };
+			cov[0] += d[0] * d[0]; cov[1] += d[0] * d[1]; cov[2] += d[0] * d[2];
+			cov[3] += d[1] * d[1]; cov[4] += d[1] * d[2]; cov[5] += d[2] * d[2];
+		}
+		float axis[3] = { 1.0f, 1.0f, 1.0f };
+		for (int it = 0; it < 8; it++)
+		{
+			float next[3] = {
+				cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+				cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+				cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2] };
+			float len = std::max(std::max(std::abs(next[0]), std::abs(next[1])), std::abs(next[2]));
+			if (len < 1e-6f)
+				break;
+			for (int c = 0; c < 3; c++) axis[c] = next[c] / len;
+		}
+
+		// Extreme pixels along the axis are the first endpoints
+		float lo = FLT_MAX, hi = -FLT_MAX;
+		int loP = 0, hiP = 0;
+		for (int p = 0; p < 16; p++)
+		{
+			float t = r[p] * axis[0] + g[p] * axis[1] + b[p] * axis[2];
+			if (t < lo) { lo = t; loP = p; }
+			if (t > hi) { hi = t; hiP = p; }
+		}
+		float end0[3] = { r[hiP], g[hiP], b[hiP] };
+		float end1[3] = { r[loP], g[loP], b[loP] };
+
+		uint16_t c0, c1;
+		uint32_t bits;
+		int indices[16];
+		float error = FitBC1(r, g, b, end0, end1, c0, c1, bits, indices);
+
+		// One least squares refinement of the endpoints, for the chosen indices
+		if (c0 != c1)
+		{
+			static const float weight[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+			float aa = 0, ab = 0, bb = 0, ax[3] = { 0, 0, 0 }, bx[3] = { 0, 0, 0 };
+			for (int p = 0; p < 16; p++)
+			{
+				float w = weight[indices[p]], v = 1.0f - w;
+				aa += w * w; ab += w * v; bb += v * v;
+				ax[0] += w * r[p]; ax[1] += w * g[p]; ax[2] += w * b[p];
+				bx[0] += v * r[p]; bx[1] += v * g[p]; bx[2] += v * b[p];
+			}
+			float det = aa * bb - ab * ab;
+			if (std::abs(det) > 1e-6f)
+			{
+				float refined0[3], refined1[3];
+				for (int c = 0; c < 3; c++)
+				{
+					refined0[c] = std::min(255.0f, std::max(0.0f, (ax[c] * bb - bx[c] * ab) / det));
+					refined1[c] = std::min(255.0f, std::max(0.0f, (bx[c] * aa - ax[c] * ab) / det));
+				}
+				uint16_t rc0, rc1;
+				uint32_t rbits;
+				int rindices[16];
+				float refinedError = FitBC1(r, g, b, refined0, refined1, rc0, rc1, rbits, rindices);
+				if (refinedError < error)
+				{
+					c0 = rc0; c1 = rc1; bits = rbits;
+				}
+			}
+		}
+
+		out[0] = (unsigned char)(c0 & 0xFF); out[1] = (unsigned char)(c0 >> 8);
+		out[2] = (unsigned char)(c1 & 0xFF); out[3] = (unsigned char)(c1 >> 8);
+		for (int i = 0; i < 4; i++)
+			out[4 + i] = (unsigned char)((bits >> (8 * i)) & 0xFF);
+	}
+
+	static inline void EncodeBC4Block(const float* v, unsigned char out[8])
+	{
+		float lo = v[0], hi = v[0];
+		for (int p = 1; p < 16; p++) { lo = std::min(lo, v[p]); hi = std::max(hi, v[p]); }
+
+		int a0 = int(hi + 0.5f), a1 = int(lo + 0.5f);
+		out[0] = (unsigned char)a0;
+		out[1] = (unsigned char)a1;
+		for (int i = 2; i < 8; i++)
+			out[i] = 0;
+		// Flat block: every index 0 is a0
+		if (a0 == a1)
+			return;
+
+		// 8 value mode (a0 > a1): the values are evenly spaced, so the nearest one is a rounding.
+		// Step k from a0 (k = 0) to a1 (k = 7) is code 0 for k = 0, 1 for k = 7, k + 1 otherwise.
+		int steps[16];
+		float scale = 7.0f / float(a0 - a1);
+#ifdef TEXTURE_COMPRESSOR_SSE2
+		for (int p = 0; p < 16; p += 4)
+		{
+			__m128 t = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(float(a0)), _mm_loadu_ps(v + p)), _mm_set1_ps(scale));
+			t = _mm_min_ps(_mm_max_ps(_mm_add_ps(t, _mm_set1_ps(0.5f)), _mm_setzero_ps()), _mm_set1_ps(7.0f));
+			_mm_storeu_si128((__m128i*)(steps + p), _mm_cvttps_epi32(t));
+		}
+#else
+		for (int p = 0; p < 16; p++)
+			steps[p] = std::min(7, std::max(0, int((float(a0) - v[p]) * scale + 0.5f)));
+#endif
+		uint64_t bits = 0;
+		for (int p = 0; p < 16; p++)
+		{
+			int k = steps[p];
+			uint64_t code = k == 0 ? 0 : (k == 7 ? 1 : k + 1);
+			bits |= code << (3 * p);
+		}
+		for (int i = 0; i < 6; i++)
+			out[2 + i] = (unsigned char)((bits >> (8 * i)) & 0xFF);
+	}
+
+	static inline void DecodeBC1Block(const unsigned char in[8], float out[16][3])
+	{
+		uint16_t c0 = uint16_t(in[0] | (in[1] << 8)), c1 = uint16_t(in[2] | (in[3] << 8));
+		float palette[4][3];
+		Unpack565(c0, palette[0]);
+		Unpack565(c1, palette[1]);
+		for (int c = 0; c < 3; c++)
+		{
+			if (c0 > c1)
+			{
+				palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+				palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+			}
+			else
+			{
+				palette[2][c] = (palette[0][c] + palette[1][c]) / 2.0f;
+				palette[3][c] = 0.0f;
+			}
+		}
+		uint32_t bits = uint32_t(in[4]) | (uint32_t(in[5]) << 8) | (uint32_t(in[6]) << 16) | (uint32_t(in[7]) << 24);
+		for (int p = 0; p < 16; p++)
+			for (int c = 0; c < 3; c++)
+				out[p][c] = palette[(bits >> (2 * p)) & 3][c];
+	}
+
+	static inline void DecodeBC4Block(const unsigned char in[8], float out[16])
+	{
+		float a0 = in[0], a1 = in[1];
+		float palette[8] = { a0, a1 };
+		for (int i = 2; i < 8; i++)
+		{
+			if (in[0] > in[1])
+				palette[i] = (float(8 - i) * a0 + float(i - 1) * a1) / 7.0f;
+			else
+				palette[i] = i < 6 ? (float(6 - i) * a0 + float(i - 1) * a1) / 5.0f : (i == 6 ? 0.0f : 255.0f);
+		}
+		uint64_t bits = 0;
+		for (int i = 0; i < 6; i++)
+			bits |= uint64_t(in[2 + i]) << (8 * i);
+		for (int p = 0; p < 16; p++)
+			out[p] = palette[(bits >> (3 * p)) & 7];
+	}
+
+	// Planar 4x4 block of one channel, clamped to the image
+	static inline void FetchBlock(const Image& image, int bx, int by, int channel, float out[16])
+	{
+		for (int y = 0; y < 4; y++)
+		{
+			int sy = std::min(by * 4 + y, image.height - 1);
+			for (int x = 0; x < 4; x++)
+			{
+				int sx = std::min(bx * 4 + x, image.width - 1);
+				out[y * 4 + x] = image.pixels[(size_t(sy) * image.width + sx) * image.channels + channel];
+			}
+		}
+	}
+}
+
+// Compress one image, one row of blocks per parallel item. max_workers: 0 for every core
+static inline CompressedLevel CompressImage(const Image& image, BlockFormat format, unsigned int max_workers = 0)
+{
+	CompressedLevel level;
+	level.width = image.width;
+	level.height = image.height;
+
+	int blocksX = (image.width + 3) / 4;
+	int blocksY = (image.height + 3) / 4;
+	int blockBytes = BlockBytes(format);
+	level.blocks.resize(size_t(blocksX) * blocksY * blockBytes);
+
+	ParallelFor(blocksY, [&](int by)
+	{
+		float planes[3][16];
+		for (int bx = 0; bx < blocksX; bx++)
+		{
+			unsigned char* out = &level.blocks[(size_t(by) * blocksX + bx) * blockBytes];
+			switch (format)
+			{
+			case BlockFormat::BC1:
+				for (int c = 0; c < 3; c++)
+					bc::FetchBlock(image, bx, by, std::min(c, image.channels - 1), planes[c]);
+				bc::EncodeBC1Block(planes[0], planes[1], planes[2], out);
+				break;
+			case BlockFormat::BC4:
+				bc::FetchBlock(image, bx, by, 0, planes[0]);
+				bc::EncodeBC4Block(planes[0], out);
+				break;
+			case BlockFormat::BC5:
+				bc::FetchBlock(image, bx, by, 0, planes[0]);
+				bc::FetchBlock(image, bx, by, std::min(1, image.channels - 1), planes[1]);
+				bc::EncodeBC4Block(planes[0], out);
+				bc::EncodeBC4Block(planes[1], out + 8);
+				break;
+			}
+		}
+	}, max_workers);
+	return level;
+}
+
+// PSNR in dB of a compressed level against its source, over the channels the format keeps
+static inline double ComputePSNR(const Image& image, const CompressedLevel& level, BlockFormat format)
+{
+	int blocksX = (level.width + 3) / 4;
+	int blocksY = (level.height + 3) / 4;
+	int blockBytes = BlockBytes(format);
+	int channels = BlockChannels(format);
+
+	double squaredError = 0.0;
+	for (int by = 0; by < blocksY; by++)
+	{
+		for (int bx = 0; bx < blocksX; bx++)
+		{
+			const unsigned char* in = &level.blocks[(size_t(by) * blocksX + bx) * blockBytes];
+			float decoded[2][16];
+			float rgb[16][3];
+			if (format == BlockFormat::BC1)
+				bc::DecodeBC1Block(in, rgb);
+			else
+			{
+				bc::DecodeBC4Block(in, decoded[0]);
+				if (format == BlockFormat::BC5)
+					bc::DecodeBC4Block(in + 8, decoded[1]);
+			}
+
+			for (int p = 0; p < 16; p++)
+			{
+				int x = bx * 4 + (p & 3), y = by * 4 + (p >> 2);
+				if (x >= image.width || y >= image.height)
+					continue;
+				for (int c = 0; c < channels; c++)
+				{
+					float value = format == BlockFormat::BC1 ? rgb[p][c] : decoded[c][p];
+					double d = double(value) - double(image.pixels[(size_t(y) * image.width + x) * image.channels + std::min(c, image.channels - 1)]);
+					squaredError += d * d;
+				}
+			}
+		}
+	}
+
+	double mse = squaredError / (double(image.width) * image.height * channels);
+	return mse <= 0.0 ? 99.0 : 10.0 * std::log10(255.0 * 255.0 / mse);
+}
\ No newline at end of file
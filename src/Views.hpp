@@ -0,0 +1,184 @@
+#pragma once
+/*
+	Several Cameras in one Frame.
+	A View bundles a camera, a viewport and a render target. All the views of a frame share one
+	uniform buffer, an array of ViewData uploaded once and indexed by ViewIndex in the shaders,
+	and one culling pass that tests every chunk against every view.
+*/
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "TerrainChunks.hpp"
+#include "GLResource.hpp"
+
+// Size of the Views array in the shaders
+static constexpr int max_views = 4;
+// Binding point of the Views uniform block
+static constexpr unsigned int views_binding = 0;
+
+// One element of the std140 Views block
+struct ViewData
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 viewProjection;
+	glm::vec4 cameraPosition;	// xyz: world position
+	glm::vec4 params;			// x: terrain tessellation level, y: atmosphere fade distance, z: clip height
+};
+
+struct View
+{
+	const char* name = "";
+
+	// Camera
+	glm::mat4 view = glm::mat4(1.0f);
+	glm::mat4 projection = glm::mat4(1.0f);
+	glm::vec3 position = glm::vec3(0.0f);
+
+	// Viewport, in pixels of the render target
+	int x = 0;
+	int y = 0;
+	int width = 1;
+	int height = 1;
+	// Render target, 0: the window
+	GLuint framebuffer = 0;
+
+	// Level of detail: tessellation level of every terrain patch
+	float tessLevel = 8.0f;
+	// Small views skip the flowers
+	bool flowers = true;
+	// The terrain fades into the sky before this distance, 0: no fade
+	float farDistance = 0.0f;
+	// With GL_CLIP_DISTANCE0 enabled, the terrain under this height is clipped (water reflection)
+	float clipHeight = 0.0f;
+
+	// Chunks inside the frustum, filled by ViewSet::Cull
+	std::vector<unsigned int> visible;
+};
+
+// Tessellation level of a view from its size: patches cover fewer pixels in a small viewport
+static inline float ViewTessLevel(int viewport_height, int reference_height, float full_level)
+{
+	float level = full_level * float(viewport_height) / float(reference_height);
+	// Even levels, as fractional_even_spacing rounds to them
+	return std::min(std::max(2.0f * std::ceil(level * 0.5f), 2.0f), full_level);
+}
+
+class ViewSet
+{
+private:
+	BufferHandle UBO;
+	std::vector<View> views;
+
+	// Frustum planes of every view, xyz: normal, w: distance. Inside: dot(n, p) + w >= 0.
+	std::vector<glm::vec4> planes;
+public:
+	ViewSet()
+	{
+		UBO.Reset(GenBuffer(), max_views * sizeof(ViewData));
+		glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+		glBufferData(GL_UNIFORM_BUFFER, max_views * sizeof(ViewData), nullptr, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+
+	// Views keep their chunk lists between frames, only their cameras change
+	void Resize(int count)
+	{
+		views.resize(std::min(std::max(count, 1), max_views));
+	}
+
+	// Every chunk is tested once against all the views, its bounds are read once
+	void Cull(const std::vector<TerrainChunk>& chunks)
+	{
+		const int count = (int)views.size();
+		planes.resize(size_t(count) * 6);
+		for (int v = 0; v < count; v++)
+		{
+			// Gribb-Hartmann: the planes are sums of the rows of the clip matrix
+			const glm::mat4 m = views[v].projection * views[v].view;
+			glm::vec4 rows[4];
+			for (int r = 0; r < 4; r++)
+				rows[r] = glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]);
+			for (int p = 0; p < 3; p++)
+			{
+				planes[v * 6 + p * 2] = rows[3] + rows[p];
+				planes[v * 6 + p * 2 + 1] = rows[3] - rows[p];
+			}
+			views[v].visible.clear();
+		}
+
+		for (unsigned int i = 0; i < chunks.size(); i++)
+		{
+			const glm::vec3 center = 0.5f * (chunks[i].boundsMax + chunks[i].boundsMin);
+			const glm::vec3 extent = 0.5f * (chunks[i].boundsMax - chunks[i].boundsMin);
+			for (int v = 0; v < count; v++)
+			{
+				bool inside = true;
+				for (int p = 0; p < 6 && inside; p++)
+				{
+					const glm::vec4& plane = planes[v * 6 + p];
+					glm::vec3 n(plane);
+					inside = glm::dot(n, center) + glm::dot(glm::abs(n), extent) + plane.w >= 0.0f;
+				}
+				if (inside)
+					views[v].visible.push_back(i);
+			}
+		}
+	}
+
+	// Cameras of every view, in one upload
+	void Upload()
+	{
+		ViewData data[max_views];
+		for (size_t v = 0; v < views.size(); v++)
+		{
+			data[v].view = views[v].view;
+			data[v].projection = views[v].projection;
+			data[v].viewProjection = views[v].projection * views[v].view;
+			data[v].cameraPosition = glm::vec4(views[v].position, 1.0f);
+			data[v].params = glm::vec4(views[v].tessLevel, views[v].farDistance, views[v].clipHeight, 0.0f);
+		}
+		glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, views.size() * sizeof(ViewData), data);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		glBindBufferBase(GL_UNIFORM_BUFFER, views_binding, UBO);
+	}
+
+	// Link a program's Views block to the buffer. Programs that do not declare it are left alone.
+	static void BindBlock(GLuint programID)
+	{
+		GLuint block = glGetUniformBlockIndex(programID, "Views");
+		if (block != GL_INVALID_INDEX)
+			glUniformBlockBinding(programID, block, views_binding);
+	}
+
+	// Render target and viewport of view i; clear_scissored clears only its rectangle
+	void Begin(int i, bool clear_scissored) const
+	{
+		const View& v = views[i];
+		glBindFramebuffer(GL_FRAMEBUFFER, v.framebuffer);
+		glViewport(v.x, v.y, v.width, v.height);
+		if (clear_scissored)
+		{
+			glEnable(GL_SCISSOR_TEST);
+			glScissor(v.x, v.y, v.width, v.height);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			glDisable(GL_SCISSOR_TEST);
+		}
+	}
+
+	// Index of view i in the Views block
+	static void SetViewIndex(GLuint programID, int i)
+	{
+		glUniform1i(glGetUniformLocation(programID, "ViewIndex"), i);
+	}
+
+	View& operator[](int i) { return views[i]; }
+	const View& operator[](int i) const { return views[i]; }
+	int GetCount() const { return (int)views.size(); }
+};
\ No newline at end of file
@@ -0,0 +1,207 @@
+#pragma once
+/*
+	Water Plane over the Lowest Height Band.
+	One quad at the water level, drawn after the sky of the player view. Reflections are ray marched in
+	screen space through a copy of the finished view (color and depth), so nothing is rendered twice.
+	Rays that leave the screen or find nothing fall back to an optional planar reflection: the terrain
+	seen from under the plane, at a fraction of the resolution and a low tessellation level, re-rendered
+	only every few frames and reprojected in between. Without it they fall back to the sky.
+*/
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <stdio.h>
+#include <cmath>
+#include <algorithm>
+
+#include "GLResource.hpp"
+#include "Views.hpp"
+
+// Upper bound of SSRSteps in Water.frag
+static constexpr int max_ssr_steps = 64;
+
+struct WaterSettings
+{
+	// Height of the plane, a few units over the bottom of the lowest band
+	float level = -47.0f;
+	// Screen space reflection: march steps per pixel and longest ray, in world units. 0 steps: no march.
+	int ssrSteps = 32;
+	float ssrDistance = 80.0f;
+	// Planar reflection: framebuffer size / divisor, tessellation level, frames between updates (0: off)
+	int reflectionDivisor = 4;
+	float reflectionTessLevel = 2.0f;
+	int reflectionInterval = 4;
+};
+
+class Water
+{
+private:
+	// The finished player view, read by the water pixels
+	TextureHandle sceneColor;
+	TextureHandle sceneDepth;
+
+	// Planar reflection target
+	FramebufferHandle reflectionFBO;
+	TextureHandle reflectionColor;
+	TextureHandle reflectionDepth;
+
+	int width = 0;
+	int height = 0;
+	int reflectionWidth = 0;
+	int reflectionHeight = 0;
+
+	// Camera and viewport of the latest reflection update, to reproject it in later frames
+	glm::mat4 reflectionVP = glm::mat4(1.0f);
+	glm::vec2 reflectionScale = glm::vec2(1.0f);
+	bool reflectionValid = false;
+	int framesSinceReflection = 0;
+
+	static void createTarget(TextureHandle& target, GLenum internal_format, GLenum format, GLenum type, int w, int h, int bytes_per_texel, GLint filter)
+	{
+		target.Reset(GenTexture(), int64_t(w) * h * bytes_per_texel);
+		glBindTexture(GL_TEXTURE_2D, target);
+		glTexImage2D(GL_TEXTURE_2D, 0, internal_format, w, h, 0, format, type, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+public:
+	WaterSettings settings;
+
+	Water(int _width, int _height, const WaterSettings& _settings = WaterSettings())
+	{
+		width = _width;
+		height = _height;
+		settings = _settings;
+		settings.reflectionDivisor = std::max(settings.reflectionDivisor, 1);
+		reflectionWidth = std::max(width / settings.reflectionDivisor, 1);
+		reflectionHeight = std::max(height / settings.reflectionDivisor, 1);
+
+		// Same depth format as the window, so the copy is a plain copy
+		createTarget(sceneColor, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height, 4, GL_LINEAR);
+		createTarget(sceneDepth, GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, width, height, 4, GL_NEAREST);
+
+		createTarget(reflectionColor, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, reflectionWidth, reflectionHeight, 4, GL_LINEAR);
+		createTarget(reflectionDepth, GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT, reflectionWidth, reflectionHeight, 4, GL_NEAREST);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		reflectionFBO.Reset(GenFramebuffer());
+		glBindFramebuffer(GL_FRAMEBUFFER, reflectionFBO);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, reflectionColor, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, reflectionDepth, 0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			printf("Water reflection target is not complete!\n");
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	// Reflection about the plane y = level. Its determinant is -1: it turns the winding around.
+	static glm::mat4 MirrorMatrix(float level)
+	{
+		glm::mat4 m(1.0f);
+		m[1][1] = -1.0f;
+		m[3][1] = 2.0f * level;
+		return m;
+	}
+
+	// Counts the frames; true when the planar reflection is due this frame
+	bool ReflectionDue()
+	{
+		if (settings.reflectionInterval <= 0)
+		{
+			reflectionValid = false;
+			return false;
+		}
+		if (reflectionValid && ++framesSinceReflection < settings.reflectionInterval)
+			return false;
+		framesSinceReflection = 0;
+		return true;
+	}
+
+	// The player camera mirrored under the water, into the reflection target. Only what is over the
+	// water is kept (clipHeight). No flowers, and the coarse tessellation: the reflection is small and rippled.
+	// An oblique near plane would save the clip distance, but with the camera just over the water
+	// it pulls the far plane in to a few dozen units.
+	void SetupReflectionView(View& reflection, const View& player) const
+	{
+		const glm::mat4 mirror = MirrorMatrix(settings.level);
+		reflection.name = "Water reflection";
+		reflection.view = player.view * mirror;
+		reflection.position = glm::vec3(mirror * glm::vec4(player.position, 1.0f));
+		reflection.projection = player.projection;
+		reflection.clipHeight = settings.level;
+		reflection.framebuffer = reflectionFBO;
+		reflection.x = reflection.y = 0;
+		reflection.width = std::min(std::max(player.width / settings.reflectionDivisor, 1), reflectionWidth);
+		reflection.height = std::min(std::max(player.height / settings.reflectionDivisor, 1), reflectionHeight);
+		reflection.tessLevel = settings.reflectionTessLevel;
+		reflection.flowers = false;
+		reflection.farDistance = player.farDistance;
+	}
+
+	// Around the terrain of the reflection view: mirrored triangles face the other way, and what is
+	// under the water is clipped. The sky goes after EndReflection, it does not write clip distances.
+	void BeginReflection() const
+	{
+		glFrontFace(GL_CW);
+		glEnable(GL_CLIP_DISTANCE0);
+	}
+	void EndReflection(const View& reflection)
+	{
+		glDisable(GL_CLIP_DISTANCE0);
+		glFrontFace(GL_CCW);
+		reflectionVP = reflection.projection * reflection.view;
+		reflectionScale = glm::vec2(float(reflection.width) / float(reflectionWidth), float(reflection.height) / float(reflectionHeight));
+		reflectionValid = true;
+	}
+
+	// Copy the finished view from the window, before the water covers it
+	void CopyScene(int x, int y, int w, int h) const
+	{
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+		glBindTexture(GL_TEXTURE_2D, sceneColor);
+		glCopyTexSubImage2D(GL_TEXTURE_2D, 0, x, y, x, y, w, h);
+		glBindTexture(GL_TEXTURE_2D, sceneDepth);
+		glCopyTexSubImage2D(GL_TEXTURE_2D, 0, x, y, x, y, w, h);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	// Scene color, scene depth and reflection in slot, slot + 1 and slot + 2
+	void Active(unsigned int slot) const
+	{
+		const unsigned int targets[3] = { sceneColor, sceneDepth, reflectionColor };
+		for (unsigned int i = 0; i < 3; i++)
+		{
+			glActiveTexture(GL_TEXTURE0 + slot + i);
+			glBindTexture(GL_TEXTURE_2D, targets[i]);
+		}
+	}
+	// viewport: the player view inside the window, in pixels. bounds: xz corners of the plane.
+	void SetShaderUniforms(unsigned int programID, unsigned int slot, const glm::ivec4& viewport, const glm::vec4& bounds, float time) const
+	{
+		glUniform1i(glGetUniformLocation(programID, "SceneColorSampler"), slot);
+		glUniform1i(glGetUniformLocation(programID, "SceneDepthSampler"), slot + 1);
+		glUniform1i(glGetUniformLocation(programID, "ReflectionSampler"), slot + 2);
+		glUniform1i(glGetUniformLocation(programID, "ReflectionEnabled"), reflectionValid ? 1 : 0);
+		glUniformMatrix4fv(glGetUniformLocation(programID, "ReflectionVP"), 1, GL_FALSE, &reflectionVP[0][0]);
+		glUniform2f(glGetUniformLocation(programID, "ReflectionScale"), reflectionScale.x, reflectionScale.y);
+		glUniform4f(glGetUniformLocation(programID, "Viewport"), float(viewport.x), float(viewport.y), float(viewport.z), float(viewport.w));
+		glUniform2f(glGetUniformLocation(programID, "SceneSize"), float(width), float(height));
+		glUniform1i(glGetUniformLocation(programID, "SSRSteps"), std::min(std::max(settings.ssrSteps, 0), max_ssr_steps));
+		glUniform1f(glGetUniformLocation(programID, "SSRDistance"), settings.ssrDistance);
+		glUniform1f(glGetUniformLocation(programID, "WaterLevel"), settings.level);
+		glUniform4f(glGetUniformLocation(programID, "WaterBounds"), bounds.x, bounds.y, bounds.z, bounds.w);
+		glUniform1f(glGetUniformLocation(programID, "Time"), time);
+	}
+
+	// Both sides, depth tested against the scene. The terrain VAO stays bound, the quad reads no attribute.
+	void Draw() const
+	{
+		glDisable(GL_CULL_FACE);
+		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+		glEnable(GL_CULL_FACE);
+	}
+
+	bool IsReflectionValid() const { return reflectionValid; }
+};
\ No newline at end of file
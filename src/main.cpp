@@ -26,7 +26,25 @@ using namespace glm;
 
 // Using Texture Class Instead of Writing A lot of OpenGL Sentences
 #include "Texture.hpp"
+#include "ResourceRegistry.hpp"
 #include "Shader.hpp"
+#include "Query.hpp"
+#include "TerrainChunks.hpp"
+#include "GBuffer.hpp"
+#include "PointLights.hpp"
+#include "ShadowCascades.hpp"
+#include "HorizonBaker.hpp"
+#include "TerrainEditor.hpp"
+#include "Views.hpp"
+#include "Sky.hpp"
+#include "OcclusionCulling.hpp"
+#include "OBJLoader.hpp"
+#include "Props.hpp"
+#include "Water.hpp"
+#include "Metrics.hpp"
+#include "StatsOverlay.hpp"
+#include "ReferenceRenderer.hpp"
+#include "FrameCapture.hpp"
 
 // Init Width and Height of the window
 static constexpr int window_width = 1920;
@@ -35,6 +53,12 @@ static constexpr int window_height = 1080;
 //
 static constexpr int n_points = 200;
 static constexpr float m_scale = 0.5f;
+// Patches per chunk side
+static constexpr int chunk_patches = 16;
+// Props scattered over the terrain
+static constexpr int prop_count = 1500;
+// Material layers as BC1 (diffuse) and BC4 (specular). The height map always stays exact RGB8.
+static constexpr bool compress_textures = true;
 
 //Variables
 
@@ -48,106 +72,16 @@ std::vector<glm::vec2> uvs;
 std::vector<glm::vec3> normals;
 
 // VAO
-GLuint VertexArrayID;
+VertexArrayHandle VertexArrayID;
 
 // Buffers for VAO
-GLuint vertexbuffer;
-GLuint uvbuffer;
-GLuint normalbuffer;
-GLuint elementbuffer;
+BufferHandle vertexbuffer;
+BufferHandle uvbuffer;
+BufferHandle normalbuffer;
+BufferHandle elementbuffer;
 
-// Load OBJ files from Hard Disk
-bool loadOBJ(const char* path, std::vector<glm::vec3>& out_vertices, std::vector<glm::vec2>& out_uvs, std::vector<glm::vec3>& out_normals, std::vector<unsigned int>& out_indices) {
-	printf("Loading OBJ file %s...\n", path);
-
-	std::vector<unsigned int> vertexIndices, uvIndices, normalIndices;
-	std::vector<glm::vec3> temp_vertices;
-	std::vector<glm::vec2> temp_uvs;
-	std::vector<glm::vec3> temp_normals;
-
-
-	FILE* file = fopen(path, "r");
-	if (file == NULL) {
-		printf("Impossible to open the file ! Are you in the right path ?\n");
-		return false;
-	}
-
-	while (1) {
-
-		char lineHeader[128];
-		// read the first word of the line
-		int res = fscanf(file, "%s", lineHeader);
-		if (res == EOF)
-			break; // EOF = End Of File. Quit the loop.
-
-		// else : parse lineHeader
-
-		if (strcmp(lineHeader, "v") == 0) {
-			glm::vec3 vertex;
-			fscanf(file, "%f %f %f\n", &vertex.x, &vertex.y, &vertex.z);
-			temp_vertices.push_back(vertex);
-		}
-		else if (strcmp(lineHeader, "vt") == 0) {
-			glm::vec2 uv;
-			fscanf(file, "%f %f\n", &uv.x, &uv.y);
-			temp_uvs.push_back(uv);
-		}
-		else if (strcmp(lineHeader, "vn") == 0) {
-			glm::vec3 normal;
-			fscanf(file, "%f %f %f\n", &normal.x, &normal.y, &normal.z);
-			temp_normals.push_back(normal);
-		}
-		else if (strcmp(lineHeader, "f") == 0) {
-			std::string vertex1, vertex2, vertex3;
-			unsigned int vertexIndex[3], uvIndex[3], normalIndex[3];
-			int matches = fscanf(file, "%d/%d/%d %d/%d/%d %d/%d/%d\n", &vertexIndex[0], &uvIndex[0], &normalIndex[0], &vertexIndex[1], &uvIndex[1], &normalIndex[1], &vertexIndex[2], &uvIndex[2], &normalIndex[2]);
-			if (matches != 9) {
-				printf("File can't be read by our simple parser :-( Try exporting with other options\n");
-				fclose(file);
-				return false;
-			}
-
-			vertexIndices.push_back(vertexIndex[0]);
-			vertexIndices.push_back(vertexIndex[1]);
-			vertexIndices.push_back(vertexIndex[2]);
-			uvIndices.push_back(uvIndex[0]);
-			uvIndices.push_back(uvIndex[1]);
-			uvIndices.push_back(uvIndex[2]);
-			normalIndices.push_back(normalIndex[0]);
-			normalIndices.push_back(normalIndex[1]);
-			normalIndices.push_back(normalIndex[2]);
-
-		}
-		else {
-			// Probably a comment, eat up the rest of the line
-			char stupidBuffer[1000];
-			fgets(stupidBuffer, 1000, file);
-		}
-
-	}
-
-	// For each vertex of each triangle
-	for (unsigned int i = 0; i < vertexIndices.size(); i++) {
-
-		// Get the indices of its attributes
-		unsigned int vertexIndex = vertexIndices[i];
-		unsigned int uvIndex = uvIndices[i];
-		unsigned int normalIndex = normalIndices[i];
-
-		// Get the attributes thanks to the index
-		glm::vec3 vertex = temp_vertices[vertexIndex - 1];
-		glm::vec2 uv = temp_uvs[uvIndex - 1];
-		glm::vec3 normal = temp_normals[normalIndex - 1];
-
-		// Put the attributes in buffers
-		out_vertices.push_back(vertex);
-		out_uvs.push_back(uv);
-		out_normals.push_back(normal);
-		out_indices.push_back(i);
-	}
-	fclose(file);
-	return true;
-}
+// Terrain chunks, ranges of elementbuffer
+std::vector<TerrainChunk> chunks;
 
 // initialize GLFW & GLEW with Basic Information
 int initializeGLFW()
@@ -165,6 +99,9 @@ int initializeGLFW()
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // To make MacOS happy; should not be needed
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	// A capture run renders offscreen: no window on screen
+	if (getenv("TERRAIN_CAPTURE"))
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
 	// Open a window and create its OpenGL context
 	window = glfwCreateWindow(window_width, window_height, "OpenGLRenderer", NULL, NULL);
@@ -202,7 +139,7 @@ int initializeGLFW()
 void LoadModel(std::string path, GLint mode)
 {
 
-	glGenVertexArrays(1, &VertexArrayID);
+	VertexArrayID.Reset(GenVertexArray());
 	glBindVertexArray(VertexArrayID);
 
 	// If path is empty, using internal points. else Load Obj from Disk
@@ -250,28 +187,8 @@ void LoadModel(std::string path, GLint mode)
 		}
 		else if (mode == GL_PATCHES)
 		{
-			// Now Do a TCS strip
-			int n = 0;
-			for (int i = 0; i < n_points; i++)
-			{
-				for (int j = 0; j < n_points; j++)
-				{
-					if (j != n_points - 1 && i != n_points - 1)
-					{
-						int topLeft = n;
-						int topRight = topLeft + 1;
-						int bottomLeft = topLeft + n_points;
-						int bottomRight = bottomLeft + 1;
-						// CW
-						indices.push_back(topLeft);
-						indices.push_back(topRight);
-						indices.push_back(bottomRight);
-						indices.push_back(bottomLeft);
-					}
-					n++;
-
-				}
-			}
+			// Now Do a TCS strip, chunk by chunk so chunks can be sorted and drawn alone
+			BuildPatchChunks(n_points, chunk_patches, vertices, indices, chunks);
 		}
 		else {
 			std::cout << "Can't process that mode..." << std::endl;
@@ -287,7 +204,7 @@ void LoadModel(std::string path, GLint mode)
 	// Load it into a VBO
 
 	glEnableVertexAttribArray(0);
-	glGenBuffers(1, &vertexbuffer);
+	vertexbuffer.Reset(GenBuffer(), vertices.size() * sizeof(glm::vec3));
 	glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
 	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), &vertices[0], GL_STATIC_DRAW);
 	glVertexAttribPointer(
@@ -300,7 +217,7 @@ void LoadModel(std::string path, GLint mode)
 	);
 
 	glEnableVertexAttribArray(1);
-	glGenBuffers(1, &uvbuffer);
+	uvbuffer.Reset(GenBuffer(), uvs.size() * sizeof(glm::vec2));
 	glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
 	glBufferData(GL_ARRAY_BUFFER, uvs.size() * sizeof(glm::vec2), &uvs[0], GL_STATIC_DRAW);
 	glVertexAttribPointer(
@@ -313,7 +230,7 @@ void LoadModel(std::string path, GLint mode)
 	);
 
 	glEnableVertexAttribArray(2);
-	glGenBuffers(1, &normalbuffer);
+	normalbuffer.Reset(GenBuffer(), normals.size() * sizeof(glm::vec3));
 	glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
 	glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(glm::vec3), &normals[0], GL_STATIC_DRAW);
 	glVertexAttribPointer(
@@ -328,7 +245,7 @@ void LoadModel(std::string path, GLint mode)
 
 
 	// Generate a buffer for the indices as well
-	glGenBuffers(1, &elementbuffer);
+	elementbuffer.Reset(GenBuffer(), indices.size() * sizeof(unsigned int));
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
 }
@@ -337,19 +254,16 @@ void LoadModel(std::string path, GLint mode)
 void UnloadModel()
 {
 	// Cleanup VBO and shader
-	glDeleteBuffers(1, &vertexbuffer);
-	glDeleteBuffers(1, &uvbuffer);
-	glDeleteBuffers(1, &normalbuffer);
-	glDeleteBuffers(1, &elementbuffer);
-	glDeleteVertexArrays(1, &VertexArrayID);
+	vertexbuffer.Release();
+	uvbuffer.Release();
+	normalbuffer.Release();
+	elementbuffer.Release();
+	VertexArrayID.Release();
 }
 
-// Main Function | Rendering Loop
-int main(void)
+// Rendering Loop. Every GL object created in here is released when it returns.
+void RunTerrain()
 {
-	// Initialize and create a window.
-	if (initializeGLFW() != 0) return -1;
-
  	// Gray background
 	glClearColor(0.7f, 0.8f, 1.0f, 0.0f);
 	// Enable depth test
@@ -364,60 +278,549 @@ int main(void)
 	// Use my customized shader Class
 	Shader terrainShader("Terrain.vert", "Terrain.frag", "Terrain.tesc", "Terrain.tese");
 	Shader elecfrogShader("Flower.vert", "Flower.frag", nullptr, nullptr,"Flower.geom");
+	// Depth only terrain, for the optional depth pre-pass
+	Shader terrainDepthShader("Terrain.vert", "TerrainDepth.frag", "Terrain.tesc", "TerrainDepth.tese");
+	// Deferred path: G-Buffer writers, tiled light culling and the lighting pass
+	Shader terrainGBufferShader("Terrain.vert", "TerrainGBuffer.frag", "Terrain.tesc", "Terrain.tese");
+	Shader elecfrogGBufferShader("Flower.vert", "FlowerGBuffer.frag", nullptr, nullptr, "Flower.geom");
+	Shader lightCullShader("LightCull.comp");
+	// Shadow casters: fewer triangles, depth only
+	Shader terrainShadowShader("Terrain.vert", "TerrainDepth.frag", "TerrainShadow.tesc", "TerrainDepth.tese");
+	Shader deferredLightingShader("DeferredLighting.vert", "DeferredLighting.frag");
+	Shader skyShader("Sky.vert", "Sky.frag");
+	Shader propShader("Prop.vert", "Prop.frag");
+	Shader waterShader("Water.vert", "Water.frag");
+	Shader overlayShader("Overlay.vert", "Overlay.frag");
+	// Programs that read their camera from the Views block
+	Shader* viewShaders[] = { &terrainShader, &elecfrogShader, &terrainDepthShader, &terrainGBufferShader, &elecfrogGBufferShader, &skyShader, &propShader, &waterShader };
+	for (Shader* shader : viewShaders)
+		ViewSet::BindBlock(shader->ID);
 	//Shader elecfrogShader("Flower.vert", "Flower.frag");
 
-	// Use my customized Texture Class
-	std::vector<Texture*> textures;
+	// Use my customized Texture Class, shared through the registry
+	ResourceRegistry& registry = GetResourceRegistry();
+	std::vector<std::shared_ptr<Texture>> textures;
 	// height map
-	textures.emplace_back(new Texture("mountains_height.bmp", GL_NEAREST));
-	// diffuse
-	textures.emplace_back(new Texture("rocks.bmp"));
-	textures.emplace_back(new Texture("grass.bmp"));
-	textures.emplace_back(new Texture("snow.bmp"));	
-	// specular	
-	textures.emplace_back(new Texture("rocks-s.bmp"));
-	textures.emplace_back(new Texture("grass-s.bmp"));
-	textures.emplace_back(new Texture("snow-s.bmp"));
+	textures.push_back(registry.GetTexture("mountains_height.bmp", GL_NEAREST));
+	if (compress_textures)
+	{
+		// diffuse: BC1, baked on first run and cached next to the image
+		textures.push_back(registry.GetTexture("rocks.bmp", BlockFormat::BC1));
+		textures.push_back(registry.GetTexture("grass.bmp", BlockFormat::BC1));
+		textures.push_back(registry.GetTexture("snow.bmp", BlockFormat::BC1));
+		// specular: BC4
+		textures.push_back(registry.GetTexture("rocks-s.bmp", BlockFormat::BC4));
+		textures.push_back(registry.GetTexture("grass-s.bmp", BlockFormat::BC4));
+		textures.push_back(registry.GetTexture("snow-s.bmp", BlockFormat::BC4));
+	}
+	else
+	{
+		// diffuse
+		textures.push_back(registry.GetTexture("rocks.bmp"));
+		textures.push_back(registry.GetTexture("grass.bmp"));
+		textures.push_back(registry.GetTexture("snow.bmp"));
+		// specular	
+		textures.push_back(registry.GetTexture("rocks-s.bmp"));
+		textures.push_back(registry.GetTexture("grass-s.bmp"));
+		textures.push_back(registry.GetTexture("snow-s.bmp"));
+	}
+
+	size_t textureMemory = 0;
+	for (const auto& t : textures)
+		textureMemory += t->GetMemorySize();
+	printf("Texture memory: %.1f MB\n", double(textureMemory) / (1024.0 * 1024.0));
+
+	// Heights on the CPU, and their ambient visibility baked once on all cores
+	HeightGrid terrainHeights;
+	HeightmapSource heightSource;
+	if (!heightSource.Open("mountains_height.bmp") || !heightSource.ReadRegion(0, 0, heightSource.GetWidth(), heightSource.GetHeight(), terrainHeights))
+		terrainHeights.Resize(1, 1);
+	TerrainMapping terrainMapping(n_points, m_scale, terrainHeights.width, terrainHeights.height);
+	HorizonSettings horizonSettings;
+	horizonSettings.spacing = terrainMapping.Spacing();
+	HorizonMap horizon(horizonSettings);
+	double bakeStart = glfwGetTime();
+	horizon.Bake(terrainHeights);
+	printf("Horizon occlusion: %d x %d texels baked in %.1f ms\n", horizon.GetWidth(), horizon.GetHeight(), (glfwGetTime() - bakeStart) * 1000.0);
+	// No mips, so an edit only uploads the texels it changed
+	Texture horizonTexture(horizon.GetWidth(), horizon.GetHeight(), 1, horizon.GetData(), GL_LINEAR);
 
 	//LoadModel("banana.obj", GL_TRIANGLES);
 
 
 	// Load an empty string to show the texture, Using Patch
 	LoadModel("", GL_PATCHES);
-
-	// Our light position is fixed
-	glm::vec3 lightPos = glm::vec3(0, -10.5, -0.5);
+	FitChunkBounds(chunks, terrainHeights, terrainMapping, { 0, 0, terrainHeights.width, terrainHeights.height });
+
+	// Occluders for the player view: the terrain itself, rasterized on the CPU at low resolution
+	const float terrainMin = -m_scale * n_points / 2.0f;
+	const float terrainMax = m_scale * (n_points - 1) - m_scale * n_points / 2.0f;
+	OcclusionCuller occlusion(256, 128);
+	occlusion.Build(terrainHeights, terrainMapping, terrainMin, terrainMin, terrainMax, terrainMax);
+
+	// Props on the lower slopes: banana.obj when it is there, else a procedural rock, with its chain of levels of detail
+	double propsStart = glfwGetTime();
+	Mesh propMesh;
+	if (!loadOBJ("banana.obj", propMesh.positions, propMesh.uvs, propMesh.normals, propMesh.indices))
+		propMesh = MakeRockMesh(5, 7u);
+	Props props(BuildLODChain(propMesh));
+	props.Scatter(prop_count, terrainHeights, terrainMapping, terrainMax - 1.0f, -50.0f, -20.0f);
+	printf("Props: %d placed, %d levels built in %.1f ms\n", props.GetCount(), props.GetLevelCount(), (glfwGetTime() - propsStart) * 1000.0);
+	for (const MeshLevel& level : props.GetChain().levels)
+		printf("  %7u triangles, error %.4f, %.3f cache misses per triangle\n", level.count / 3, level.error, level.acmr);
+
+	// Deferred path targets, at the real framebuffer size
+	int framebufferWidth, framebufferHeight;
+	glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+	GBuffer gbuffer(framebufferWidth, framebufferHeight);
+	PointLights pointLights(framebufferWidth, framebufferHeight);
+
+	// Cascaded shadow maps of the directional light, cached while the terrain stays covered
+	ShadowCascades shadows(2048);
+	static constexpr float shadow_tess_level = 2.0f;
+	std::vector<unsigned int> shadowChunks;
+	// Night-time street lights, just above the valleys
+	static constexpr int light_counts[] = { 0, 128, 512, 1024 };
+	int lightCountIndex = 1;
+	pointLights.Scatter(light_counts[lightCountIndex], m_scale * n_points / 2.0f, -48.0f, -30.0f);
+
+	// Lakes in the lowest height band. KEY R: planar reflection every few frames, or screen space only.
+	Water water(framebufferWidth, framebufferHeight);
+	const glm::vec4 waterBounds(terrainMin, terrainMin, terrainMax, terrainMax);
+	static constexpr int reflection_intervals[] = { 0, 1, 4, 16 };
+	int reflectionIntervalIndex = 2;
+	water.settings.reflectionInterval = reflection_intervals[reflectionIntervalIndex];
+	bool toggleReflection = false;
+	Query reflectionTime(GL_TIME_ELAPSED);
+	int reflectionUpdates = 0;
+
+	printf("OpenGL objects:\n");
+	GetResourceStats().Print();
+
+	// The light is the sun. KEY PAGE UP / PAGE DOWN: sun elevation, it starts where the fixed light was.
+	const float lightDistance = std::sqrt(10.5f * 10.5f + 0.5f * 0.5f);
+	float sunElevation = std::atan2(10.5f, 0.5f);
+	auto sunFromElevation = [](float elevation) { return glm::vec3(0.0f, std::sin(elevation), std::cos(elevation)); };
+	glm::vec3 lightPos = -sunFromElevation(sunElevation) * lightDistance;
 //	glm::vec3 lightPos = glm::vec3(0, 4, 4);
+
+	// Sky and aerial perspective tables, baked on all cores. Only the sky view and the aerial
+	// perspective follow the sun; transmittance and multiple scattering are baked once.
+	// KEY A: atmosphere, or the flat background color.
+	double atmosphereStart = glfwGetTime();
+	Atmosphere atmosphere{ AtmosphereSettings() };
+	atmosphere.Bake(sunFromElevation(sunElevation));
+	Sky sky;
+	sky.Upload(atmosphere);
+	printf("Atmosphere: tables baked in %.1f ms\n", (glfwGetTime() - atmosphereStart) * 1000.0);
+	float bakedSunElevation = sunElevation;
+	bool atmosphereEnabled = true;
+	bool toggleAtmosphere = false;
+	// Re-bake once the sun moved this far, radians
+	static constexpr float sun_rebake_angle = 0.25f * 3.14159265f / 180.0f;
+	// Far plane of the player, as in controls.cpp
+	static constexpr float far_plane = 500.0f;
 	bool n = false;
 	bool reloadShaders = false;
+
+	// KEY P: depth pre-pass, then shade with GL_EQUAL. KEY O: front-to-back chunk order.
+	bool depthPrePass = false;
+	bool frontToBack = false;
+	bool togglePrePass = false;
+	bool toggleOrder = false;
+
+	// KEY G: deferred shading. KEY L: cycle the point light count (deferred only).
+	bool deferred = false;
+	bool toggleDeferred = false;
+	bool toggleLights = false;
+
+	// KEY K: shadows. KEY J: cache static cascades, or re-render them every frame.
+	bool shadowsEnabled = true;
+	bool toggleShadows = false;
+	bool toggleShadowCache = false;
+	int shadowRenders = 0;
+
+	// KEY C: occlusion culling of the player's chunks and flowers, behind the ridges
+	bool occlusionCulling = true;
+	bool toggleOcclusion = false;
+	std::vector<unsigned int> flowerChunks;
+	double occlusionMilliseconds = 0.0;
+	size_t occlusionTested = 0;
+	size_t occlusionHidden = 0;
+	// Flower billboards stand out of the chunk bounds by about this much
+	static constexpr float flower_extent = 1.0f;
+
+	// KEY M: prop level of detail, picked per prop or one level for all (-1: picked)
+	int propLevel = -1;
+	bool togglePropLevel = false;
+	double propMilliseconds = 0.0;
+	size_t propTriangles = 0;
+	size_t propFullTriangles = 0;
+
+	// KEY H: baked ambient occlusion
+	bool ambientOcclusion = true;
+	bool toggleAmbientOcclusion = false;
+
+	// Left mouse button: sculpt where the screen center points. KEY B: brush mode. KEY [ ]: brush radius.
+	TerrainEditor editor(terrainHeights, terrainMapping);
+	Brush brush;
+	bool stroking = false;
+	bool toggleBrush = false;
+	std::vector<unsigned char> editTexels;
+	double lastEditTime = glfwGetTime();
+	double editMilliseconds = 0.0;
+	int editUpdates = 0;
+
+	// KEY V: view layout. The player view comes first and owns the shadow cascades and the deferred path.
+	enum ViewLayout { SingleView, MinimapAndInset, SplitScreen, ViewLayoutCount };
+	static const char* view_layout_names[] = { "Single", "Minimap + inset camera", "Split screen" };
+	int viewLayout = SingleView;
+	bool toggleLayout = false;
+	// Views on screen; the water reflection, when it is updated, comes after them
+	int screenViews = 1;
+	ViewSet views;
+	Query playerViewTime(GL_TIME_ELAPSED);
+	Query extraViewsTime(GL_TIME_ELAPSED);
+
+	// TERRAIN_CAPTURE=frame.bmp: one frame of the terrain alone, offscreen, then quit. The camera is
+	// TERRAIN_CAPTURE_CAMERA ("x,y,z,tx,ty,tz") at TERRAIN_CAPTURE_SIZE ("1920x1080"), the same one
+	// tools/ReferenceRender.cpp takes, so tools/ImageDiff.cpp can compare both. The reference has no
+	// shadows, atmosphere, flowers, props or water: they are off here too.
+	const char* capturePath = getenv("TERRAIN_CAPTURE");
+	const bool capturing = capturePath != nullptr;
+	ReferenceCamera captureCamera;
+	std::unique_ptr<FrameCapture> capture;
+	if (capturing)
+	{
+		const char* camera = getenv("TERRAIN_CAPTURE_CAMERA");
+		const char* size = getenv("TERRAIN_CAPTURE_SIZE");
+		if (camera && !captureCamera.Parse(camera))
+			printf("TERRAIN_CAPTURE_CAMERA: expected x,y,z,tx,ty,tz\n");
+		if (size && !captureCamera.ParseSize(size))
+			printf("TERRAIN_CAPTURE_SIZE: expected WIDTHxHEIGHT\n");
+		capture = std::make_unique<FrameCapture>(captureCamera.width, captureCamera.height);
+		shadowsEnabled = false;
+		atmosphereEnabled = false;
+		occlusionCulling = false;
+		water.settings.reflectionInterval = 0;
+		printf("Capture: %d x %d from (%.2f, %.2f, %.2f) to %s\n", captureCamera.width, captureCamera.height,
+			captureCamera.position.x, captureCamera.position.y, captureCamera.position.z, capturePath);
+	}
+
+	// Textures and lighting of the terrain shading programs, the same for every view
+	auto setTerrainInputs = [&](const Shader& pass)
+	{
+		// Set Mountain Hight Map
+		textures[0]->Active(0);
+		textures[0]->SetShaderUniform(glGetUniformLocation(pass.ID, "DiffuseTextureSampler"));
+
+		// Set Three Types of Diffuse textures: Rock Grass and Snow
+		textures[1]->Active(1);
+		textures[1]->SetShaderUniform(glGetUniformLocation(pass.ID, "rt.rock"));
+
+		textures[2]->Active(2);
+		textures[2]->SetShaderUniform(glGetUniformLocation(pass.ID, "rt.grass"));
+
+		textures[3]->Active(3);
+		textures[3]->SetShaderUniform(glGetUniformLocation(pass.ID, "rt.snow"));
+
+		// Set Three Types of Specular textures: Rock Grass and Snow
+		textures[4]->Active(4);
+		textures[4]->SetShaderUniform(glGetUniformLocation(pass.ID, "rt.rock_s"));
+
+		textures[5]->Active(5);
+		textures[5]->SetShaderUniform(glGetUniformLocation(pass.ID, "rt.grass_s"));
+
+		textures[6]->Active(6);
+		textures[6]->SetShaderUniform(glGetUniformLocation(pass.ID, "rt.snow_s"));
+
+		// Shadow cascades
+		shadows.Active(7);
+		shadows.SetShaderUniforms(pass.ID, 7);
+		glUniform1i(glGetUniformLocation(pass.ID, "ShadowsEnabled"), shadowsEnabled);
+
+		// Baked ambient visibility, same UV as the height map
+		horizonTexture.Active(8);
+		horizonTexture.SetShaderUniform(glGetUniformLocation(pass.ID, "HorizonSampler"));
+		glUniform1i(glGetUniformLocation(pass.ID, "AmbientOcclusionEnabled"), ambientOcclusion);
+
+		glUniform3f(glGetUniformLocation(pass.ID, "LightPosition_worldspace"), lightPos.x, lightPos.y, lightPos.z);
+
+		// Aerial perspective, and the sky the far terrain fades into
+		sky.Active(9);
+		sky.SetShaderUniforms(pass.ID, 9, atmosphereEnabled);
+	};
+
+	// Sky of view i, behind what the view drew
+	auto drawSky = [&](int i)
+	{
+		if (!atmosphereEnabled)
+			return;
+		skyShader.Bind();
+		sky.Active(0);
+		sky.SetShaderUniforms(skyShader.ID, 0, true);
+		ViewSet::SetViewIndex(skyShader.ID, i);
+		sky.Draw();
+		skyShader.UnBind();
+	};
+
+	// Fragments that reach the terrain shading pass, to measure overdraw
+	Query samplesPassed(GL_SAMPLES_PASSED);
+	GLuint64 shadedSamples = 0;
+
+	// Metrics, recorded only while the overlay is shown or exported. KEY I: stats overlay.
+	// TERRAIN_METRICS=metrics.csv, metrics.jsonl or udp:127.0.0.1:8125 writes a snapshot every
+	// TERRAIN_METRICS_INTERVAL seconds (1 by default), for soak runs.
+	MetricsRegistry& metrics = GetMetrics();
+	MetricsExporter metricsExporter;
+	double metricsInterval = 1.0;
+	if (const char* target = getenv("TERRAIN_METRICS"))
+	{
+		if (metricsExporter.Open(target))
+			printf("Metrics: exporting to %s\n", target);
+		if (const char* interval = getenv("TERRAIN_METRICS_INTERVAL"))
+			metricsInterval = std::max(atof(interval), 0.1);
+	}
+	bool overlayVisible = false;
+	bool toggleOverlay = false;
+	metrics.SetEnabled(metricsExporter.IsOpen(), glfwGetTime());
+
+	Counter& framesMetric = metrics.GetCounter("frames");
+	Histogram& frameTimeMetric = metrics.GetHistogram("frame.cpu_ms", "ms");
+	Counter& terrainTrianglesMetric = metrics.GetCounter("terrain.triangles");
+	Counter& patchesDrawnMetric = metrics.GetCounter("terrain.patches_drawn");
+	Counter& patchesCulledMetric = metrics.GetCounter("terrain.patches_culled");
+	Counter& propTrianglesMetric = metrics.GetCounter("props.triangles");
+	Gauge& textureMemoryMetric = metrics.GetGauge("memory.textures_mb", "MB");
+	Gauge& bufferMemoryMetric = metrics.GetGauge("memory.buffers_mb", "MB");
+	// There is no background loader: the queue that builds up is the GL objects waiting for their frame fence
+	Gauge& deletionQueueMetric = metrics.GetGauge("queue.gl_deletions");
+	Gauge& metricsCostMetric = metrics.GetGauge("metrics.cpu_ms", "ms");
+
+	// GPU time of every pass: timestamps between consecutive marks
+	enum GpuMark { MarkFrameStart, MarkReflection, MarkShadows, MarkTerrain, MarkFlowers, MarkLighting, MarkProps, MarkSky, MarkWater, MarkOtherViews, MarkOverlay, MarkCount };
+	static const char* gpu_pass_names[MarkCount] = { "gpu.frame_ms", "gpu.reflection_ms", "gpu.shadows_ms", "gpu.terrain_ms", "gpu.flowers_ms", "gpu.lighting_ms",
+		"gpu.props_ms", "gpu.sky_ms", "gpu.water_ms", "gpu.other_views_ms", "gpu.overlay_ms" };
+	TimestampQueries gpuMarks(MarkCount);
+	Gauge* gpuPassMetrics[MarkCount];
+	for (int m = 0; m < MarkCount; m++)
+		gpuPassMetrics[m] = &metrics.GetGauge(gpu_pass_names[m], "ms");
+	Query primitivesGenerated(GL_PRIMITIVES_GENERATED);
+
+	StatsOverlay overlay;
+	std::vector<std::string> overlayLines;
+	std::vector<float> frameTimes;
+	static constexpr size_t frame_graph_size = 240;
+	double previousFrameTime = glfwGetTime();
+
 	// For speed computation
 	double lastTime = glfwGetTime();
 	int nbFrames = 0;
 	do {
-		
+		// Recording stays on or off for the whole frame
+		const bool recording = metrics.IsEnabled();
+		auto markGpu = [&](int mark) { if (recording) gpuMarks.Mark(mark); };
+		{
+			double now = glfwGetTime();
+			frameTimeMetric.Record((now - previousFrameTime) * 1000.0);
+			framesMetric.Add();
+			if (recording)
+			{
+				frameTimes.push_back(float((now - previousFrameTime) * 1000.0));
+				if (frameTimes.size() > frame_graph_size)
+					frameTimes.erase(frameTimes.begin());
+			}
+			previousFrameTime = now;
+		}
+
 		if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
 			reloadShaders = true;
 		}
 		if (reloadShaders && glfwGetKey(window, GLFW_KEY_S) == GLFW_RELEASE) {
-			terrainShader.~Shader();
-			elecfrogShader.~Shader();
-			//LoadShaders(programID, vertShader, fragShader, tescShader, teseShader);
-			terrainShader.LoadShaders(terrainShader.vertSource, terrainShader.fragSource, terrainShader.tescSource, terrainShader.teseSource);
-			elecfrogShader.LoadShaders(elecfrogShader.vertSource, elecfrogShader.fragSource,nullptr,nullptr, elecfrogShader.geomSource);
+			terrainShader.Reload();
+			elecfrogShader.Reload();
+			terrainDepthShader.Reload();
+			terrainGBufferShader.Reload();
+			elecfrogGBufferShader.Reload();
+			lightCullShader.Reload();
+			deferredLightingShader.Reload();
+			terrainShadowShader.Reload();
+			skyShader.Reload();
+			propShader.Reload();
+			waterShader.Reload();
+			overlayShader.Reload();
+			for (Shader* shader : viewShaders)
+				ViewSet::BindBlock(shader->ID);
 			reloadShaders = false;
 		}
-		
+
+		if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS) {
+			togglePrePass = true;
+		}
+		if (togglePrePass && glfwGetKey(window, GLFW_KEY_P) == GLFW_RELEASE) {
+			depthPrePass = !depthPrePass;
+			printf("Depth pre-pass: %s\n", depthPrePass ? "On" : "Off");
+			togglePrePass = false;
+		}
+
+		if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS) {
+			toggleOrder = true;
+		}
+		if (toggleOrder && glfwGetKey(window, GLFW_KEY_O) == GLFW_RELEASE) {
+			frontToBack = !frontToBack;
+			printf("Front-to-back chunks: %s\n", frontToBack ? "On" : "Off");
+			toggleOrder = false;
+		}
+
+		if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS) {
+			toggleDeferred = true;
+		}
+		if (toggleDeferred && glfwGetKey(window, GLFW_KEY_G) == GLFW_RELEASE) {
+			deferred = !deferred;
+			printf("Shading path: %s\n", deferred ? "Deferred" : "Forward");
+			toggleDeferred = false;
+		}
+
+		if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS) {
+			toggleLights = true;
+		}
+		if (toggleLights && glfwGetKey(window, GLFW_KEY_L) == GLFW_RELEASE) {
+			lightCountIndex = (lightCountIndex + 1) % (int)(sizeof(light_counts) / sizeof(light_counts[0]));
+			pointLights.Scatter(light_counts[lightCountIndex], m_scale * n_points / 2.0f, -48.0f, -30.0f);
+			printf("Point lights: %d\n", pointLights.GetCount());
+			toggleLights = false;
+		}
+
+		if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS) {
+			toggleShadows = true;
+		}
+		if (toggleShadows && glfwGetKey(window, GLFW_KEY_K) == GLFW_RELEASE) {
+			shadowsEnabled = !shadowsEnabled;
+			printf("Shadows: %s\n", shadowsEnabled ? "On" : "Off");
+			toggleShadows = false;
+		}
+
+		if (glfwGetKey(window, GLFW_KEY_J) == GLFW_PRESS) {
+			toggleShadowCache = true;
+		}
+		if (toggleShadowCache && glfwGetKey(window, GLFW_KEY_J) == GLFW_RELEASE) {
+			shadows.cacheStatic = !shadows.cacheStatic;
+			printf("Shadow cascade cache: %s\n", shadows.cacheStatic ? "On" : "Off");
+			toggleShadowCache = false;
+		}
+
+		if (glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS) {
+			toggleAmbientOcclusion = true;
+		}
+		if (toggleAmbientOcclusion && glfwGetKey(window, GLFW_KEY_H) == GLFW_RELEASE) {
+			ambientOcclusion = !ambientOcclusion;
+			printf("Ambient occlusion: %s\n", ambientOcclusion ? "On" : "Off");
+			toggleAmbientOcclusion = false;
+		}
+
+		if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS) {
+			toggleBrush = true;
+		}
+		if (toggleBrush && glfwGetKey(window, GLFW_KEY_B) == GLFW_RELEASE) {
+			brush.mode = BrushMode((int(brush.mode) + 1) % int(BrushMode::Count));
+			printf("Brush: %s, radius %.1f\n", BrushModeName(brush.mode), brush.radius);
+			toggleBrush = false;
+		}
+
+		if (glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS) {
+			toggleLayout = true;
+		}
+		if (toggleLayout && glfwGetKey(window, GLFW_KEY_V) == GLFW_RELEASE) {
+			viewLayout = (viewLayout + 1) % ViewLayoutCount;
+			printf("Views: %s\n", view_layout_names[viewLayout]);
+			toggleLayout = false;
+		}
+
+		if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS) {
+			toggleOcclusion = true;
+		}
+		if (toggleOcclusion && glfwGetKey(window, GLFW_KEY_C) == GLFW_RELEASE) {
+			occlusionCulling = !occlusionCulling;
+			printf("Occlusion culling: %s\n", occlusionCulling ? "on" : "off");
+			toggleOcclusion = false;
+		}
+
+		if (glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS) {
+			togglePropLevel = true;
+		}
+		if (togglePropLevel && glfwGetKey(window, GLFW_KEY_M) == GLFW_RELEASE) {
+			propLevel = propLevel + 1 < props.GetLevelCount() ? propLevel + 1 : -1;
+			if (propLevel < 0)
+				printf("Prop detail: picked per prop\n");
+			else
+				printf("Prop detail: level %d for all\n", propLevel);
+			togglePropLevel = false;
+		}
+		if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS) {
+			toggleReflection = true;
+		}
+		if (toggleReflection && glfwGetKey(window, GLFW_KEY_R) == GLFW_RELEASE) {
+			reflectionIntervalIndex = (reflectionIntervalIndex + 1) % (int)(sizeof(reflection_intervals) / sizeof(reflection_intervals[0]));
+			water.settings.reflectionInterval = reflection_intervals[reflectionIntervalIndex];
+			if (water.settings.reflectionInterval == 0)
+				printf("Water reflection: screen space only\n");
+			else
+				printf("Water reflection: planar every %d frames\n", water.settings.reflectionInterval);
+			toggleReflection = false;
+		}
+		if (glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS) {
+			toggleOverlay = true;
+		}
+		if (toggleOverlay && glfwGetKey(window, GLFW_KEY_I) == GLFW_RELEASE) {
+			overlayVisible = !overlayVisible;
+			metrics.SetEnabled(overlayVisible || metricsExporter.IsOpen(), glfwGetTime());
+			printf("Stats overlay: %s\n", overlayVisible ? "on" : "off");
+			toggleOverlay = false;
+		}
+		if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
+			toggleAtmosphere = true;
+		}
+		if (toggleAtmosphere && glfwGetKey(window, GLFW_KEY_A) == GLFW_RELEASE) {
+			atmosphereEnabled = !atmosphereEnabled;
+			printf("Atmosphere: %s\n", atmosphereEnabled ? "on" : "off");
+			toggleAtmosphere = false;
+		}
+
+		// The G-Buffer and the light tiles cover the whole window: half a window is shaded forward
+		const bool deferredFrame = deferred && viewLayout != SplitScreen;
 
 		// Measure speed
 		double currentTime = glfwGetTime();
 		nbFrames++;
+		shadedSamples += samplesPassed.GetResult();
 		if (currentTime - lastTime >= 1.0) { // If last prinf() was more than 1sec ago
 			// printf and reset
-			printf("%f ms/frame\n", 1000.0 / double(nbFrames));
+			printf("%f ms/frame, %llu terrain fragments/frame, %d shadow cascades rendered\n", 1000.0 / double(nbFrames), (unsigned long long)(shadedSamples / nbFrames), shadowRenders);
+			if (screenViews > 1)
+				printf("GPU: player view %.2f ms, %d other views %.2f ms\n", double(playerViewTime.GetResult()) * 1e-6, screenViews - 1, double(extraViewsTime.GetResult()) * 1e-6);
+			if (reflectionUpdates > 0)
+				printf("Water: %d reflection updates, %.2f ms GPU each\n", reflectionUpdates, double(reflectionTime.GetResult()) * 1e-6);
+			if (occlusionCulling)
+				printf("Occlusion: %.1f of %.1f chunks in view hidden, %.2f ms CPU\n", double(occlusionHidden) / nbFrames, double(occlusionTested) / nbFrames, occlusionMilliseconds / nbFrames);
+			printf("Props: %.2f M triangles, %.2f M at full detail, %.2f ms CPU\n", double(propTriangles) * 1e-6 / nbFrames,
+				double(propFullTriangles) * 1e-6 / nbFrames, propMilliseconds / nbFrames);
+			occlusionMilliseconds = 0.0;
+			occlusionTested = 0;
+			occlusionHidden = 0;
+			propMilliseconds = 0.0;
+			propTriangles = 0;
+			propFullTriangles = 0;
 			nbFrames = 0;
+			shadedSamples = 0;
+			shadowRenders = 0;
+			reflectionUpdates = 0;
 			lastTime += 1.0;
 		}
 
+		// Deferred: every geometry pass writes into the G-Buffer
+		if (deferredFrame)
+			gbuffer.Bind();
+
 		// Clear the screen
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -425,53 +828,277 @@ int main(void)
 		computeMatricesFromInputs();
 		glm::mat4 ProjectionMatrix = getProjectionMatrix();
 		glm::mat4 ViewMatrix = getViewMatrix();
+		if (viewLayout == SplitScreen)
+			ProjectionMatrix = glm::perspective(glm::radians(45.0f), float(framebufferWidth / 2) / float(framebufferHeight), 0.1f, far_plane);
+		if (capturing)
+		{
+			ProjectionMatrix = captureCamera.Projection();
+			ViewMatrix = captureCamera.View();
+		}
 		glm::mat4 ModelMatrix = glm::mat4(1.0);
 		glm::mat4 ModelViewMatrix = ViewMatrix * ModelMatrix;
 		glm::mat3 ModelView3x3Matrix = glm::mat3(ModelViewMatrix);
 		glm::mat4 MVP = ProjectionMatrix * ViewMatrix * ModelMatrix;
 
-		// First pass: Base mesh
-		terrainShader.Bind();
+		// Terrain editing. Heights change on the CPU; the GPU copies get the dirty texels only.
+		double editTime = glfwGetTime();
+		float editSeconds = (float)std::min(editTime - lastEditTime, 0.1);
+		lastEditTime = editTime;
+		if (glfwGetKey(window, GLFW_KEY_RIGHT_BRACKET) == GLFW_PRESS)
+			brush.radius = std::min(brush.radius * std::pow(2.0f, editSeconds), 25.0f);
+		if (glfwGetKey(window, GLFW_KEY_LEFT_BRACKET) == GLFW_PRESS)
+			brush.radius = std::max(brush.radius * std::pow(0.5f, editSeconds), 0.5f);
+
+		// Sun elevation, from below the horizon to the zenith. The tables follow it in steps.
+		if (glfwGetKey(window, GLFW_KEY_PAGE_UP) == GLFW_PRESS)
+			sunElevation = std::min(sunElevation + 0.2f * editSeconds, 0.5f * 3.14159265f);
+		if (glfwGetKey(window, GLFW_KEY_PAGE_DOWN) == GLFW_PRESS)
+			sunElevation = std::max(sunElevation - 0.2f * editSeconds, -0.1f);
+		lightPos = -sunFromElevation(sunElevation) * lightDistance;
+		if (std::abs(sunElevation - bakedSunElevation) > sun_rebake_angle)
+		{
+			double bakeStart = glfwGetTime();
+			atmosphere.Bake(sunFromElevation(sunElevation));
+			sky.Upload(atmosphere);
+			bakedSunElevation = sunElevation;
+			printf("Atmosphere: sun at %.1f degrees, sky baked in %.1f ms\n", sunElevation * 180.0f / 3.14159265f, (glfwGetTime() - bakeStart) * 1000.0);
+		}
 
-		// Set Mountain Hight Map
-		textures[0]->Active(0);
-		textures[0]->SetShaderUniform(glGetUniformLocation(terrainShader.ID, "DiffuseTextureSampler"));
+		if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS)
+		{
+			glm::vec3 forward = -glm::vec3(ViewMatrix[0][2], ViewMatrix[1][2], ViewMatrix[2][2]);
+			glm::vec3 hit;
+			if (editor.Raycast(getCameraPosition(), forward, 200.0f, hit))
+			{
+				// Flatten to the height under the cursor when the stroke started
+				if (!stroking)
+					brush.targetHeight = editor.HeightAt(hit.x, hit.z);
+				editor.Apply(brush, hit.x, hit.z, editSeconds);
+			}
+			stroking = true;
+		}
+		else
+			stroking = false;
 
-		// Set Three Types of Diffuse textures: Rock Grass and Snow
-		textures[1]->Active(1);
-		textures[1]->SetShaderUniform(glGetUniformLocation(terrainShader.ID, "rt.rock"));
+		TexelRect edited = editor.TakeDirty();
+		if (!edited.Empty())
+		{
+			double updateStart = glfwGetTime();
+			editor.EncodeRegion(edited, editTexels);
+			textures[0]->Update(edited.x0, edited.y0, edited.Width(), edited.Height(), editTexels.data());
+
+			// Horizons reach further than the edit
+			TexelRect occluded = horizon.Update(terrainHeights, edited);
+			horizonTexture.Update(occluded.x0, occluded.y0, occluded.Width(), occluded.Height(),
+				horizon.GetData() + size_t(occluded.y0) * horizon.GetWidth() + occluded.x0, horizon.GetWidth());
+
+			FitChunkBounds(chunks, terrainHeights, terrainMapping, edited);
+			occlusion.Update(terrainHeights, terrainMapping, edited);
+			props.Settle(terrainHeights, terrainMapping);
+
+			// Old and new surface both cast shadows: the whole height range over the changed texels
+			glm::vec3 boxMin(terrainMapping.TexelToWorldX(float(edited.x0) - 1.0f), terrain_y_shift, terrainMapping.TexelToWorldZ(float(edited.y0) - 1.0f));
+			glm::vec3 boxMax(terrainMapping.TexelToWorldX(float(edited.x1) + 1.0f), terrain_y_max, terrainMapping.TexelToWorldZ(float(edited.y1) + 1.0f));
+			shadows.InvalidateBox(boxMin, boxMax);
+
+			editMilliseconds += (glfwGetTime() - updateStart) * 1000.0;
+			editUpdates++;
+		}
+		if (!stroking && editUpdates > 0)
+		{
+			printf("Terrain edit: %d updates, %.2f ms each\n", editUpdates, editMilliseconds / editUpdates);
+			editMilliseconds = 0.0;
+			editUpdates = 0;
+		}
 
-		textures[2]->Active(2);
-		textures[2]->SetShaderUniform(glGetUniformLocation(terrainShader.ID, "rt.grass"));
+		// Views of this frame
+		screenViews = viewLayout == SingleView ? 1 : viewLayout == MinimapAndInset ? 3 : 2;
+		const bool reflecting = water.ReflectionDue();
+		views.Resize(screenViews + (reflecting ? 1 : 0));
+		{
+			View& player = views[0];
+			player.name = "Player";
+			player.view = ViewMatrix;
+			player.projection = ProjectionMatrix;
+			player.position = capturing ? captureCamera.position : getCameraPosition();
+			player.x = player.y = 0;
+			player.width = viewLayout == SplitScreen ? framebufferWidth / 2 : framebufferWidth;
+			player.height = framebufferHeight;
+			player.framebuffer = 0;
+			if (capturing)
+			{
+				player.width = capture->GetWidth();
+				player.height = capture->GetHeight();
+				player.framebuffer = capture->GetFramebuffer();
+			}
+			player.tessLevel = 8.0f;
+			player.flowers = true;
+			player.farDistance = far_plane;
+		}
+		if (viewLayout == MinimapAndInset)
+		{
+			// Top down map of the whole terrain, in the top right corner
+			const float half = m_scale * n_points / 2.0f;
+			const int size = framebufferHeight / 4;
+			View& minimap = views[1];
+			minimap.name = "Minimap";
+			minimap.position = glm::vec3(0.0f, 200.0f, 0.0f);
+			minimap.view = glm::lookAt(minimap.position, glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f));
+			minimap.projection = glm::ortho(-half, half, -half, half, 1.0f, 400.0f);
+			minimap.x = framebufferWidth - size - 16;
+			minimap.y = framebufferHeight - size - 16;
+			minimap.width = minimap.height = size;
+			minimap.tessLevel = ViewTessLevel(size, framebufferHeight, 8.0f);
+			minimap.flowers = false;
+			minimap.farDistance = 0.0f;
+
+			// Fixed camera on a ridge, under the minimap
+			View& inset = views[2];
+			inset.name = "Inset";
+			inset.position = glm::vec3(40.0f, 10.0f, 40.0f);
+			inset.view = glm::lookAt(inset.position, glm::vec3(0.0f, -30.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+			inset.width = framebufferWidth / 4;
+			inset.height = framebufferHeight / 4;
+			inset.projection = glm::perspective(glm::radians(60.0f), float(inset.width) / float(inset.height), 0.1f, far_plane);
+			inset.x = framebufferWidth - inset.width - 16;
+			inset.y = minimap.y - inset.height - 16;
+			inset.tessLevel = ViewTessLevel(inset.height, framebufferHeight, 8.0f);
+			inset.flowers = false;
+			inset.farDistance = far_plane;
+		}
+		else if (viewLayout == SplitScreen)
+		{
+			// Second player: circles the valley
+			float angle = float(glfwGetTime()) * 0.1f;
+			View& second = views[1];
+			second.name = "Second player";
+			second.position = glm::vec3(45.0f * std::cos(angle), 5.0f, 45.0f * std::sin(angle));
+			second.view = glm::lookAt(second.position, glm::vec3(0.0f, -30.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+			second.projection = ProjectionMatrix;
+			second.x = framebufferWidth / 2;
+			second.y = 0;
+			second.width = framebufferWidth - framebufferWidth / 2;
+			second.height = framebufferHeight;
+			second.tessLevel = 8.0f;
+			second.flowers = true;
+			second.farDistance = far_plane;
+		}
+		if (reflecting)
+			water.SetupReflectionView(views[screenViews], views[0]);
 
-		textures[3]->Active(3);
-		textures[3]->SetShaderUniform(glGetUniformLocation(terrainShader.ID, "rt.snow"));
-		
-		// Set Three Types of Specular textures: Rock Grass and Snow
-		textures[4]->Active(4);
-		textures[4]->SetShaderUniform(glGetUniformLocation(terrainShader.ID, "rt.rock_s"));
+		// One culling pass for every view after the edits moved the bounds, one upload of their cameras
+		views.Cull(chunks);
+		views.Upload();
 
-		textures[5]->Active(5);
-		textures[5]->SetShaderUniform(glGetUniformLocation(terrainShader.ID, "rt.grass_s"));
+		// Player chunk order: grid order, or nearest chunks first
+		std::vector<unsigned int>& chunkOrder = views[0].visible;
 
-		textures[6]->Active(6);
-		textures[6]->SetShaderUniform(glGetUniformLocation(terrainShader.ID, "rt.snow_s"));
+		// Occlusion: drop the chunks the nearer ridges hide, from the camera of this frame
+		flowerChunks = chunkOrder;
+		if (occlusionCulling)
+		{
+			double occlusionStart = glfwGetTime();
+			occlusion.Render(ProjectionMatrix * ViewMatrix);
+			const glm::vec3 flowerMargin(flower_extent);
+			flowerChunks.erase(std::remove_if(flowerChunks.begin(), flowerChunks.end(), [&](unsigned int i)
+				{ return !occlusion.IsVisible(chunks[i].boundsMin - flowerMargin, chunks[i].boundsMax + flowerMargin); }), flowerChunks.end());
+			const size_t inView = chunkOrder.size();
+			chunkOrder.erase(std::remove_if(chunkOrder.begin(), chunkOrder.end(), [&](unsigned int i)
+				{ return !occlusion.IsVisible(chunks[i].boundsMin, chunks[i].boundsMax); }), chunkOrder.end());
+			occlusionTested += inView;
+			occlusionHidden += inView - chunkOrder.size();
+			occlusionMilliseconds += (glfwGetTime() - occlusionStart) * 1000.0;
+		}
+		if (frontToBack)
+			SortChunksFrontToBack(chunks, getCameraPosition(), chunkOrder);
 
-		// Get a handle for our uniforms
-		GLuint MatrixID = glGetUniformLocation(terrainShader.ID, "MVP");
-		GLuint ViewMatrixID = glGetUniformLocation(terrainShader.ID, "V");
-		GLuint ModelMatrixID = glGetUniformLocation(terrainShader.ID, "M");
-		GLuint ModelView3x3MatrixID = glGetUniformLocation(terrainShader.ID, "MV3x3");
-		GLuint LightID = glGetUniformLocation(terrainShader.ID, "LightPosition_worldspace");
+		// Props of the player view: a level each from the size of its error on screen, P[1][1] = 1 / tan(fov / 2)
+		{
+			double propStart = glfwGetTime();
+			props.Update(ProjectionMatrix * ViewMatrix, getCameraPosition(), 0.5f * float(views[0].height) * ProjectionMatrix[1][1],
+				propLevel, occlusionCulling ? &occlusion : nullptr);
+			propMilliseconds += (glfwGetTime() - propStart) * 1000.0;
+			propTriangles += props.GetDrawnTriangles();
+			propFullTriangles += props.GetFullTriangles();
+			propTrianglesMetric.Add(props.GetDrawnTriangles());
+		}
+		if (recording)
+		{
+			// 4 indices per patch
+			size_t drawnPatches = 0;
+			for (unsigned int c : chunkOrder)
+				drawnPatches += chunks[c].count / 4;
+			patchesDrawnMetric.Add(drawnPatches);
+			patchesCulledMetric.Add(indices.size() / 4 - drawnPatches);
+		}
 
-		// Send our transformation to the currently bound shader, 
-		glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);
-		glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-		glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &ViewMatrix[0][0]);
-		glUniformMatrix3fv(ModelView3x3MatrixID, 1, GL_FALSE, &ModelView3x3Matrix[0][0]);
-		
-		// Set the light position
-		glUniform3f(LightID, lightPos.x, lightPos.y, lightPos.z);
+		markGpu(MarkFrameStart);
+
+		// Water reflection: the player camera under the plane, small and coarse, every few frames.
+		// In between, the water reprojects the last one.
+		if (reflecting)
+		{
+			const int r = screenViews;
+			reflectionTime.Begin();
+			views.Begin(r, true);
+			water.BeginReflection();
+			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+			terrainShader.Bind();
+			setTerrainInputs(terrainShader);
+			glUniform1i(glGetUniformLocation(terrainShader.ID, "ShadowsEnabled"), 0);
+			glUniformMatrix4fv(glGetUniformLocation(terrainShader.ID, "M"), 1, GL_FALSE, &ModelMatrix[0][0]);
+			ViewSet::SetViewIndex(terrainShader.ID, r);
+			DrawTerrainChunks(chunks, views[r].visible);
+			terrainShader.UnBind();
+			water.EndReflection(views[r]);
+			drawSky(r);
+			reflectionTime.End();
+			reflectionUpdates++;
+
+			// Back to the frame target
+			if (deferredFrame)
+				gbuffer.Bind();
+		}
+		markGpu(MarkReflection);
+
+		// Shadow pass: only the cascades the camera or the light moved out of.
+		// lightPos is the direction the light travels, as Terrain.tese uses it.
+		if (shadowsEnabled && shadows.Update(ViewMatrix, ProjectionMatrix, lightPos) > 0)
+		{
+			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+			glEnable(GL_POLYGON_OFFSET_FILL);
+			glPolygonOffset(2.0f, 4.0f);
+
+			terrainShadowShader.Bind();
+			textures[0]->Active(0);
+			textures[0]->SetShaderUniform(glGetUniformLocation(terrainShadowShader.ID, "DiffuseTextureSampler"));
+			glUniform1f(glGetUniformLocation(terrainShadowShader.ID, "ShadowTessLevel"), shadow_tess_level);
+
+			for (int i = 0; i < shadow_cascade_count; i++)
+			{
+				if (!shadows.IsDirty(i))
+					continue;
+
+				shadows.BindCascade(i);
+				shadows.CullChunks(i, chunks, shadowChunks);
+				glUniformMatrix4fv(glGetUniformLocation(terrainShadowShader.ID, "MVP"), 1, GL_FALSE, &shadows.GetMatrix(i)[0][0]);
+				DrawTerrainChunks(chunks, shadowChunks);
+				shadowRenders++;
+			}
+
+			terrainShadowShader.UnBind();
+			shadows.UnBind();
+			glDisable(GL_POLYGON_OFFSET_FILL);
+
+			// Back to the frame target
+			if (deferredFrame)
+				gbuffer.Bind();
+		}
+		if (!deferredFrame)
+			views.Begin(0, capturing);
+		markGpu(MarkShadows);
+		playerViewTime.Begin();
 
 		// KEY W Wire frame Mode
 		if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) 
@@ -483,35 +1110,73 @@ int main(void)
 			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 		}
 
-		//Draw the triangles !
-		glDrawElements(
-			GL_PATCHES,      // mode
-			(GLsizei)indices.size(),    // count
-			GL_UNSIGNED_INT, // type
-			(void*)0           // element array buffer offset
-		);
+		// Pre-pass: depth only terrain, so the shading pass runs once per visible pixel
+		if (depthPrePass)
+		{
+			terrainDepthShader.Bind();
+
+			textures[0]->Active(0);
+			textures[0]->SetShaderUniform(glGetUniformLocation(terrainDepthShader.ID, "DiffuseTextureSampler"));
+			glUniformMatrix4fv(glGetUniformLocation(terrainDepthShader.ID, "MVP"), 1, GL_FALSE, &MVP[0][0]);
+			// Tessellation level of the player view
+			ViewSet::SetViewIndex(terrainDepthShader.ID, 0);
+
+			glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+			DrawTerrainChunks(chunks, chunkOrder);
+			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+			// Depth is final: only shade the fragments that won it
+			glDepthFunc(GL_EQUAL);
+			glDepthMask(GL_FALSE);
+
+			terrainDepthShader.UnBind();
+		}
+
+		// First pass: Base mesh, shaded or written to the G-Buffer
+		Shader& terrainPass = deferredFrame ? terrainGBufferShader : terrainShader;
+		terrainPass.Bind();
+		setTerrainInputs(terrainPass);
+
+		// Get a handle for our uniforms. The camera comes from the Views block.
+		GLuint ModelMatrixID = glGetUniformLocation(terrainPass.ID, "M");
+		GLuint ModelView3x3MatrixID = glGetUniformLocation(terrainPass.ID, "MV3x3");
+
+		// Send our transformation to the currently bound shader, 
+		glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
+		glUniformMatrix3fv(ModelView3x3MatrixID, 1, GL_FALSE, &ModelView3x3Matrix[0][0]);
+		ViewSet::SetViewIndex(terrainPass.ID, 0);
+
+		//Draw the patches, chunk by chunk !
+		samplesPassed.Begin();
+		if (recording)
+			primitivesGenerated.Begin();
+		DrawTerrainChunks(chunks, chunkOrder);
+		if (recording)
+			primitivesGenerated.End();
+		samplesPassed.End();
+
+		terrainPass.UnBind();
+		markGpu(MarkTerrain);
 
-		terrainShader.UnBind();
+		// Back to the default depth state for the next passes
+		glDepthFunc(GL_LESS);
+		glDepthMask(GL_TRUE);
 
-		elecfrogShader.Bind();
+		Shader& elecfrogPass = deferredFrame ? elecfrogGBufferShader : elecfrogShader;
+		elecfrogPass.Bind();
 
 		// Set Mountain Hight Map
 		textures[0]->Active(0);
-		textures[0]->SetShaderUniform(glGetUniformLocation(elecfrogShader.ID, "DiffuseTextureSampler"));
+		textures[0]->SetShaderUniform(glGetUniformLocation(elecfrogPass.ID, "DiffuseTextureSampler"));
 		// Get a handle for our uniforms
-		MatrixID = glGetUniformLocation(elecfrogShader.ID, "MVP");
-		ViewMatrixID = glGetUniformLocation(elecfrogShader.ID, "V");
-		unsigned int ProjectionMatrixID = glGetUniformLocation(elecfrogShader.ID, "P");
-		ModelMatrixID = glGetUniformLocation(elecfrogShader.ID, "M");
-		ModelView3x3MatrixID = glGetUniformLocation(elecfrogShader.ID, "MV3x3");
-		LightID = glGetUniformLocation(elecfrogShader.ID, "LightPosition_worldspace");
+		ModelMatrixID = glGetUniformLocation(elecfrogPass.ID, "M");
+		ModelView3x3MatrixID = glGetUniformLocation(elecfrogPass.ID, "MV3x3");
+		GLuint LightID = glGetUniformLocation(elecfrogPass.ID, "LightPosition_worldspace");
 
 		// Send our transformation to the currently bound shader, 
-		glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);		
-		glUniformMatrix4fv(ProjectionMatrixID, 1, GL_FALSE, &ProjectionMatrix[0][0]);
 		glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-		glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &ViewMatrix[0][0]);
 		glUniformMatrix3fv(ModelView3x3MatrixID, 1, GL_FALSE, &ModelView3x3Matrix[0][0]);
+		ViewSet::SetViewIndex(elecfrogPass.ID, 0);
 
 		// Set the light position
 		glUniform3f(LightID, lightPos.x, lightPos.y, lightPos.z);
@@ -526,19 +1191,201 @@ int main(void)
 			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 		}
 
-		//Draw the triangles !
-		glDrawElements(
-			GL_PATCHES,      // mode
-			(GLsizei)indices.size(),    // count
-			GL_UNSIGNED_INT, // type
-			(void*)0           // element array buffer offset
-		);
+		//Draw the triangles ! Only the chunks in view, and not behind a ridge
+		if (!capturing)
+			DrawTerrainChunks(chunks, flowerChunks);
+
+
+		elecfrogPass.UnBind();
+		markGpu(MarkFlowers);
+
+		if (deferredFrame)
+		{
+			gbuffer.UnBind();
+			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+			glm::mat4 InverseProjectionMatrix = glm::inverse(ProjectionMatrix);
+			glm::mat4 InverseViewMatrix = glm::inverse(ViewMatrix);
+
+			// Tiled light culling against the G-Buffer depth
+			pointLights.BindBuffers();
+			lightCullShader.Bind();
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, gbuffer.depthID);
+			glUniform1i(glGetUniformLocation(lightCullShader.ID, "DepthSampler"), 0);
+			glUniformMatrix4fv(glGetUniformLocation(lightCullShader.ID, "V"), 1, GL_FALSE, &ViewMatrix[0][0]);
+			glUniformMatrix4fv(glGetUniformLocation(lightCullShader.ID, "invP"), 1, GL_FALSE, &InverseProjectionMatrix[0][0]);
+			glUniform1i(glGetUniformLocation(lightCullShader.ID, "lightCount"), pointLights.GetCount());
+			glUniform2i(glGetUniformLocation(lightCullShader.ID, "screenSize"), gbuffer.GetWidth(), gbuffer.GetHeight());
+			pointLights.DispatchCulling();
+			lightCullShader.UnBind();
+
+			// One full screen lighting pass
+			deferredLightingShader.Bind();
+			gbuffer.ActiveTargets(0);
+			glUniform1i(glGetUniformLocation(deferredLightingShader.ID, "gAlbedo"), 0);
+			glUniform1i(glGetUniformLocation(deferredLightingShader.ID, "gNormal"), 1);
+			glUniform1i(glGetUniformLocation(deferredLightingShader.ID, "gSpecular"), 2);
+			glUniform1i(glGetUniformLocation(deferredLightingShader.ID, "gDepth"), 3);
+			glUniformMatrix4fv(glGetUniformLocation(deferredLightingShader.ID, "V"), 1, GL_FALSE, &ViewMatrix[0][0]);
+			glUniformMatrix4fv(glGetUniformLocation(deferredLightingShader.ID, "invV"), 1, GL_FALSE, &InverseViewMatrix[0][0]);
+			glUniformMatrix4fv(glGetUniformLocation(deferredLightingShader.ID, "invP"), 1, GL_FALSE, &InverseProjectionMatrix[0][0]);
+			glUniform3f(glGetUniformLocation(deferredLightingShader.ID, "LightPosition_worldspace"), lightPos.x, lightPos.y, lightPos.z);
+			glUniform3f(glGetUniformLocation(deferredLightingShader.ID, "ClearColor"), 0.7f, 0.8f, 1.0f);
+			glUniform1i(glGetUniformLocation(deferredLightingShader.ID, "tilesX"), pointLights.GetTilesX());
+			shadows.Active(4);
+			shadows.SetShaderUniforms(deferredLightingShader.ID, 4);
+			glUniform1i(glGetUniformLocation(deferredLightingShader.ID, "ShadowsEnabled"), shadowsEnabled);
+			sky.Active(5);
+			sky.SetShaderUniforms(deferredLightingShader.ID, 5, atmosphereEnabled);
+			glUniform1f(glGetUniformLocation(deferredLightingShader.ID, "FadeDistance"), views[0].farDistance);
+
+			// The terrain VAO stays bound, the full screen triangle reads no attribute.
+			// It also writes the G-Buffer depth to every pixel, for the forward passes after it
+			// (no blit: the float G-Buffer depth does not match the D24S8 window depth)
+			glDepthFunc(GL_ALWAYS);
+			glDepthMask(GL_TRUE);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+			glDepthFunc(GL_LESS);
+			deferredLightingShader.UnBind();
+		}
+		markGpu(MarkLighting);
+
+		// Props, forward in both paths
+		propShader.Bind();
+		sky.Active(0);
+		sky.SetShaderUniforms(propShader.ID, 0, atmosphereEnabled);
+		glUniform3f(glGetUniformLocation(propShader.ID, "LightPosition_worldspace"), lightPos.x, lightPos.y, lightPos.z);
+		glUniform3f(glGetUniformLocation(propShader.ID, "PropColor"), 0.45f, 0.42f, 0.38f);
+		ViewSet::SetViewIndex(propShader.ID, 0);
+		if (!capturing)
+			props.Draw();
+		propShader.UnBind();
+		markGpu(MarkProps);
+
+		// The sky covers the background only, in both paths
+		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		drawSky(0);
+		markGpu(MarkSky);
+
+		// Water over the finished view: the plane reads a copy of it for the refraction and the reflections
+		if (!capturing)
+		{
+			const View& player = views[0];
+			water.CopyScene(player.x, player.y, player.width, player.height);
+			waterShader.Bind();
+			water.Active(0);
+			water.SetShaderUniforms(waterShader.ID, 0, glm::ivec4(player.x, player.y, player.width, player.height), waterBounds, float(glfwGetTime()));
+			sky.Active(3);
+			sky.SetShaderUniforms(waterShader.ID, 3, atmosphereEnabled);
+			glUniform3f(glGetUniformLocation(waterShader.ID, "LightPosition_worldspace"), lightPos.x, lightPos.y, lightPos.z);
+			ViewSet::SetViewIndex(waterShader.ID, 0);
+			water.Draw();
+			waterShader.UnBind();
+		}
+		playerViewTime.End();
+		markGpu(MarkWater);
+
+		if (capturing)
+		{
+			if (capture->Save(capturePath))
+				printf("Capture: written to %s\n", capturePath);
+			break;
+		}
+
+		// Other views: forward, on the shared cascades, culling and camera buffer, at their own level of detail.
+		// The cascades follow the player, so these views are not shadowed.
+		extraViewsTime.Begin();
+		for (int v = 1; v < screenViews; v++)
+		{
+			views.Begin(v, true);
+
+			terrainShader.Bind();
+			setTerrainInputs(terrainShader);
+			glUniform1i(glGetUniformLocation(terrainShader.ID, "ShadowsEnabled"), 0);
+			ViewSet::SetViewIndex(terrainShader.ID, v);
+			DrawTerrainChunks(chunks, views[v].visible);
+			terrainShader.UnBind();
+
+			if (views[v].flowers)
+			{
+				elecfrogShader.Bind();
+				textures[0]->Active(0);
+				textures[0]->SetShaderUniform(glGetUniformLocation(elecfrogShader.ID, "DiffuseTextureSampler"));
+				ViewSet::SetViewIndex(elecfrogShader.ID, v);
+				DrawTerrainChunks(chunks, views[v].visible);
+				elecfrogShader.UnBind();
+			}
+
+			drawSky(v);
+		}
+		extraViewsTime.End();
+		glViewport(0, 0, framebufferWidth, framebufferHeight);
+		markGpu(MarkOtherViews);
+
+		// Metrics of this frame, a snapshot once per interval, then the overlay on top of everything
+		if (recording)
+		{
+			double metricsStart = glfwGetTime();
+			// Results of a frame a few frames back, like every query here
+			terrainTrianglesMetric.Add(primitivesGenerated.GetResult());
+			gpuPassMetrics[MarkFrameStart]->Set(double(gpuMarks.GetElapsed(MarkFrameStart, MarkOverlay)) * 1e-6);
+			for (int m = MarkReflection; m < MarkCount; m++)
+				gpuPassMetrics[m]->Set(double(gpuMarks.GetElapsed(m - 1, m)) * 1e-6);
+			textureMemoryMetric.Set(double(GetResourceStats().GetBytes(ResourceType::Texture)) / (1024.0 * 1024.0));
+			bufferMemoryMetric.Set(double(GetResourceStats().GetBytes(ResourceType::Buffer)) / (1024.0 * 1024.0));
+			deletionQueueMetric.Set(double(GetDeletionQueue().GetPendingCount()));
+
+			if (metrics.Snapshot(glfwGetTime(), metricsInterval))
+			{
+				if (metricsExporter.IsOpen())
+					metricsExporter.Write(metrics.GetSnapshotTime(), metrics.GetSnapshot());
+
+				// Text of the overlay changes once per snapshot
+				overlayLines.clear();
+				for (const MetricSample& sample : metrics.GetSnapshot())
+				{
+					char line[160];
+					if (sample.kind == MetricKind::Histogram)
+						snprintf(line, sizeof(line), "%-22s mean %6.2f p95 %6.2f p99 %6.2f max %6.2f %s", sample.name->c_str(), sample.value, sample.p95, sample.p99, sample.max, sample.unit->c_str());
+					else if (sample.kind == MetricKind::Counter)
+						snprintf(line, sizeof(line), "%-22s %10.4g /s %12.6g total", sample.name->c_str(), sample.value, sample.total);
+					else
+						snprintf(line, sizeof(line), "%-22s %10.4g %s", sample.name->c_str(), sample.value, sample.unit->c_str());
+					overlayLines.push_back(line);
+				}
+			}
 
+			if (overlayVisible)
+			{
+				const float lineHeight = float(overlay.GetLineHeight());
+				const float panelWidth = float(overlay.GetCharWidth() * 72);
+				const float graphHeight = 80.0f;
+				overlay.Clear();
+				overlay.Rect(8.0f, 8.0f, panelWidth + 16.0f, lineHeight * float(overlayLines.size()) + graphHeight + 24.0f, glm::vec4(0.0f, 0.0f, 0.0f, 0.6f));
+				for (size_t i = 0; i < overlayLines.size(); i++)
+					overlay.Text(16.0f, 16.0f + lineHeight * float(i), overlayLines[i], glm::vec4(1.0f));
+				// Frame times against 33 ms; the line marks 16.7 ms
+				const float graphY = 16.0f + lineHeight * float(overlayLines.size()) + 4.0f;
+				overlay.Graph(16.0f, graphY, panelWidth, graphHeight, frameTimes, 33.3f, glm::vec4(0.3f, 0.9f, 0.4f, 0.9f));
+				overlay.Rect(16.0f, graphY + graphHeight * 0.5f, panelWidth, 1.0f, glm::vec4(1.0f, 1.0f, 1.0f, 0.5f));
+
+				glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+				overlayShader.Bind();
+				overlay.Draw(overlayShader.ID, framebufferWidth, framebufferHeight);
+				overlayShader.UnBind();
+			}
+			metricsCostMetric.Set((glfwGetTime() - metricsStart) * 1000.0);
+		}
+		markGpu(MarkOverlay);
 
-		elecfrogShader.UnBind();
 
 		// Swap buffers
 		glfwSwapBuffers(window);
+		// Objects released frames_in_flight frames ago are now safe to delete
+		GetDeletionQueue().EndFrame();
+		if (recording)
+			gpuMarks.EndFrame();
 		glfwPollEvents();
 
 	} 
@@ -548,16 +1395,27 @@ int main(void)
 
 
 	UnloadModel();
-	//UnloadTextures();
-	for (const auto& t : textures)
+}
+
+// Main Function
+int main(void)
+{
+	// Initialize and create a window.
+	if (initializeGLFW() != 0) return -1;
+
+	RunTerrain();
+
+	// Shaders, textures and targets are gone with RunTerrain: delete what is still queued
+	GetDeletionQueue().Flush();
+	GetResourceRegistry().Collect();
+	if (GetResourceStats().GetTotalCount() != 0)
 	{
-		t->~Texture();
+		printf("Leaked OpenGL objects:\n");
+		GetResourceStats().Print();
 	}
-	terrainShader.~Shader();
 
 	// Close OpenGL window and terminate GLFW
 	glfwTerminate();
 
 	return 0;
-}
-
+}
\ No newline at end of file
@@ -0,0 +1,315 @@
+/*
+	Heightmap Preprocessing Tool.
+	Decodes a 24-bit RGB height map and writes, next to the given output prefix:
+		<prefix>_height_L<n>.lth	float height pyramid, level 0 is the decoded map
+		<prefix>_minmax_L<n>.lth	min/max mips (RG float), from level 1
+		<prefix>_normal.lth		world space normals (RGB unorm8)
+		<prefix>_horizon.lth		horizon visibility (R unorm8), unless --no-horizon
+	The map is processed in square tiles on every core, so memory stays bounded by the tile size,
+	whatever the size of the input.
+
+	Build: g++ -O2 -std=c++17 -pthread -Isrc tools/HeightmapTool.cpp -o HeightmapTool
+	Usage: HeightmapTool <height.bmp> <output prefix> [--tile 512] [--ridge 0.5] [--extent 100]
+		[--no-horizon] [--directions 16] [--radius 32]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+
+#include "Heightfield.hpp"
+#include "HorizonBaker.hpp"
+#include "Parallel.hpp"
+
+struct Options
+{
+	const char* input = nullptr;
+	std::string output;
+	// Tile side in texels, a power of two
+	int tile = 512;
+	// Pyramid downsampling: 0 box filter, 1 keep ridges and valleys
+	float ridge = 0.5f;
+	// World size of the whole map, the renderer draws 200 x 0.5 units
+	float extent = 100.0f;
+	bool horizon = true;
+	int directions = 16;
+	int radius = 32;
+};
+
+enum Stage { StageDecode, StageNormals, StageHorizon, StagePyramid, StageWrite, StageCount };
+static const char* stage_names[StageCount] = { "decode", "normals", "horizon", "pyramid", "write" };
+
+// Thread seconds and texels per stage, summed over all tiles
+struct StageStats
+{
+	std::atomic<int64_t> nanoseconds[StageCount] = {};
+	std::atomic<int64_t> texels[StageCount] = {};
+};
+
+class StageTimer
+{
+private:
+	StageStats& stats;
+	std::chrono::high_resolution_clock::time_point start;
+public:
+	StageTimer(StageStats& _stats) : stats(_stats), start(std::chrono::high_resolution_clock::now()) {}
+
+	// Charge the time since the last call to stage
+	void Lap(Stage stage, int64_t texels)
+	{
+		auto now = std::chrono::high_resolution_clock::now();
+		stats.nanoseconds[stage] += std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count();
+		stats.texels[stage] += texels;
+		start = now;
+	}
+};
+
+static bool ParseOptions(int argc, char** argv, Options& options)
+{
+	if (argc < 3)
+		return false;
+	options.input = argv[1];
+	options.output = argv[2];
+	for (int i = 3; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (!strcmp(argv[i], "--tile") && hasValue) options.tile = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--ridge") && hasValue) options.ridge = (float)atof(argv[++i]);
+		else if (!strcmp(argv[i], "--extent") && hasValue) options.extent = (float)atof(argv[++i]);
+		else if (!strcmp(argv[i], "--directions") && hasValue) options.directions = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--radius") && hasValue) options.radius = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--no-horizon")) options.horizon = false;
+		else
+		{
+			printf("Unknown option %s\n", argv[i]);
+			return false;
+		}
+	}
+
+	if (options.tile < 16 || (options.tile & (options.tile - 1)))
+	{
+		printf("--tile must be a power of two, 16 or more\n");
+		return false;
+	}
+	options.ridge = std::min(std::max(options.ridge, 0.0f), 1.0f);
+	options.directions = std::max(options.directions, 1);
+	options.radius = std::max(options.radius, 1);
+	return true;
+}
+
+static std::string LevelPath(const std::string& prefix, const char* product, int level)
+{
+	return prefix + "_" + product + "_L" + std::to_string(level) + ".lth";
+}
+
+// Interleave min and max for an RG raster
+static void PackMinMax(const HeightGrid& lo, const HeightGrid& hi, std::vector<float>& out)
+{
+	out.resize(lo.heights.size() * 2);
+	for (size_t i = 0; i < lo.heights.size(); i++)
+	{
+		out[2 * i] = lo.heights[i];
+		out[2 * i + 1] = hi.heights[i];
+	}
+}
+
+static unsigned char ToUNorm8(float value)
+{
+	return (unsigned char)std::min(std::max(int(value * 255.0f + 0.5f), 0), 255);
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!ParseOptions(argc, argv, options))
+	{
+		printf("Usage: HeightmapTool <height.bmp> <output prefix> [--tile 512] [--ridge 0.5] [--extent 100]\n"
+			"       [--no-horizon] [--directions 16] [--radius 32]\n");
+		return 1;
+	}
+
+	HeightmapSource source;
+	if (!source.Open(options.input))
+		return 1;
+
+	const int width = source.GetWidth();
+	const int height = source.GetHeight();
+	const float spacing = options.extent / float(width);
+
+	HorizonSettings horizonSettings;
+	horizonSettings.directions = options.directions;
+	horizonSettings.radius = options.radius;
+	horizonSettings.spacing = spacing;
+	HorizonKernel horizonKernel;
+	horizonKernel.Build(horizonSettings);
+	const int halo = options.horizon ? horizonKernel.apron : 1;
+
+	// Full pyramid down to 1x1, and the part of it each tile builds on its own
+	std::vector<int> levelWidth(1, width), levelHeight(1, height);
+	while (levelWidth.back() > 1 || levelHeight.back() > 1)
+	{
+		levelWidth.push_back(HalfSize(levelWidth.back()));
+		levelHeight.push_back(HalfSize(levelHeight.back()));
+	}
+	const int levelCount = (int)levelWidth.size();
+	int tileLevels = 0;
+	while ((1 << tileLevels) < options.tile)
+		tileLevels++;
+	tileLevels = std::min(tileLevels, levelCount - 1);
+
+	const int tilesX = (width + options.tile - 1) / options.tile;
+	const int tilesY = (height + options.tile - 1) / options.tile;
+
+	printf("%s: %d x %d, %d levels, %d x %d tiles of %d, %u workers\n", options.input, width, height, levelCount, tilesX, tilesY, options.tile, WorkerCount());
+	double workingSet = double(options.tile + 2 * halo) * (options.tile + 2 * halo) * 4.0 + double(options.tile) * options.tile * 4.0 * 4.0;
+	printf("Working set: %.1f MB per worker\n", workingSet / (1024.0 * 1024.0));
+
+	// Outputs
+	std::vector<std::unique_ptr<RasterWriter>> heightLevels, minMaxLevels;
+	bool ok = true;
+	for (int level = 0; level < levelCount; level++)
+	{
+		heightLevels.emplace_back(new RasterWriter());
+		ok = ok && heightLevels.back()->Open(LevelPath(options.output, "height", level), levelWidth[level], levelHeight[level], 1, RasterFormat::Float32);
+		minMaxLevels.emplace_back(new RasterWriter());
+		if (level > 0)
+			ok = ok && minMaxLevels.back()->Open(LevelPath(options.output, "minmax", level), levelWidth[level], levelHeight[level], 2, RasterFormat::Float32);
+	}
+	RasterWriter normalWriter, horizonWriter;
+	ok = ok && normalWriter.Open(options.output + "_normal.lth", width, height, 3, RasterFormat::UNorm8);
+	if (options.horizon)
+		ok = ok && horizonWriter.Open(options.output + "_horizon.lth", width, height, 1, RasterFormat::UNorm8);
+	if (!ok)
+		return 1;
+
+	// One texel per tile: where the in-memory part of the pyramid starts
+	HeightGrid coarseHeights, coarseMin, coarseMax;
+	coarseHeights.Resize(levelWidth[tileLevels], levelHeight[tileLevels]);
+	coarseMin.Resize(coarseHeights.width, coarseHeights.height);
+	coarseMax.Resize(coarseHeights.width, coarseHeights.height);
+
+	StageStats stats;
+	std::atomic<bool> failed(false);
+	auto start = std::chrono::high_resolution_clock::now();
+
+	ParallelFor(tilesX * tilesY, [&](int index)
+	{
+		const int tx = index % tilesX, ty = index / tilesX;
+		const int x0 = tx * options.tile, y0 = ty * options.tile;
+		const int tw = std::min(options.tile, width - x0), th = std::min(options.tile, height - y0);
+		StageTimer timer(stats);
+
+		// Tile and its apron: normals need one texel around, the horizon search its whole radius
+		HeightGrid padded;
+		if (!source.ReadRegion(x0 - halo, y0 - halo, tw + 2 * halo, th + 2 * halo, padded))
+		{
+			failed = true;
+			return;
+		}
+		HeightGrid level;
+		level.Resize(tw, th);
+		for (int y = 0; y < th; y++)
+			for (int x = 0; x < tw; x++)
+				level.At(x, y) = padded.At(x + halo, y + halo);
+		timer.Lap(StageDecode, int64_t(tw) * th);
+
+		std::vector<unsigned char> normals(size_t(tw) * th * 3);
+		for (int y = 0; y < th; y++)
+		{
+			for (int x = 0; x < tw; x++)
+			{
+				float n[3];
+				HeightNormal(padded, x + halo, y + halo, spacing, n);
+				unsigned char* texel = &normals[(size_t(y) * tw + x) * 3];
+				for (int c = 0; c < 3; c++)
+					texel[c] = ToUNorm8(n[c] * 0.5f + 0.5f);
+			}
+		}
+		timer.Lap(StageNormals, int64_t(tw) * th);
+
+		std::vector<unsigned char> visibility;
+		if (options.horizon)
+		{
+			visibility.resize(size_t(tw) * th);
+			std::vector<float> row(tw);
+			for (int y = 0; y < th; y++)
+			{
+				HorizonVisibilityRow(padded, halo, y + halo, tw, horizonKernel, row.data());
+				for (int x = 0; x < tw; x++)
+					visibility[size_t(y) * tw + x] = ToUNorm8(row[x]);
+			}
+			timer.Lap(StageHorizon, int64_t(tw) * th);
+		}
+
+		heightLevels[0]->WriteRegion(x0, y0, tw, th, level.heights.data());
+		normalWriter.WriteRegion(x0, y0, tw, th, normals.data());
+		if (options.horizon)
+			horizonWriter.WriteRegion(x0, y0, tw, th, visibility.data());
+		timer.Lap(StageWrite, int64_t(tw) * th);
+
+		// Local pyramid, down to one texel for the whole tile
+		HeightGrid lo = level, hi = level, next, nextLo, nextHi;
+		std::vector<float> packed;
+		for (int l = 1; l <= tileLevels; l++)
+		{
+			DownsampleHeights(level, options.ridge, next);
+			ReduceMinMax(lo, hi, nextLo, nextHi);
+			std::swap(level, next);
+			std::swap(lo, nextLo);
+			std::swap(hi, nextHi);
+			timer.Lap(StagePyramid, int64_t(level.width) * level.height);
+
+			heightLevels[l]->WriteRegion(x0 >> l, y0 >> l, level.width, level.height, level.heights.data());
+			PackMinMax(lo, hi, packed);
+			minMaxLevels[l]->WriteRegion(x0 >> l, y0 >> l, lo.width, lo.height, packed.data());
+			timer.Lap(StageWrite, int64_t(level.width) * level.height);
+		}
+
+		// Each tile owns one texel of the coarse level: no lock needed
+		coarseHeights.At(tx, ty) = level.At(0, 0);
+		coarseMin.At(tx, ty) = lo.At(0, 0);
+		coarseMax.At(tx, ty) = hi.At(0, 0);
+	});
+	if (failed)
+		return 1;
+
+	// The rest of the pyramid is small enough to stay in memory
+	{
+		StageTimer timer(stats);
+		HeightGrid next, nextLo, nextHi;
+		std::vector<float> packed;
+		for (int l = tileLevels + 1; l < levelCount; l++)
+		{
+			DownsampleHeights(coarseHeights, options.ridge, next);
+			ReduceMinMax(coarseMin, coarseMax, nextLo, nextHi);
+			std::swap(coarseHeights, next);
+			std::swap(coarseMin, nextLo);
+			std::swap(coarseMax, nextHi);
+			timer.Lap(StagePyramid, int64_t(coarseHeights.width) * coarseHeights.height);
+
+			heightLevels[l]->WriteRegion(0, 0, coarseHeights.width, coarseHeights.height, coarseHeights.heights.data());
+			PackMinMax(coarseMin, coarseMax, packed);
+			minMaxLevels[l]->WriteRegion(0, 0, coarseMin.width, coarseMin.height, packed.data());
+			timer.Lap(StageWrite, int64_t(coarseHeights.width) * coarseHeights.height);
+		}
+	}
+	heightLevels.clear();
+	minMaxLevels.clear();
+
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	printf("%-8s %12s %12s %16s\n", "stage", "MTexels", "thread s", "MTexels/s/thread");
+	for (int s = 0; s < StageCount; s++)
+	{
+		double stageSeconds = double(stats.nanoseconds[s].load()) * 1e-9;
+		double mtexels = double(stats.texels[s].load()) * 1e-6;
+		if (mtexels > 0.0)
+			printf("%-8s %12.2f %12.3f %16.1f\n", stage_names[s], mtexels, stageSeconds, stageSeconds > 0.0 ? mtexels / stageSeconds : 0.0);
+	}
+	printf("Total: %.3f s, %.1f MTexels/s\n", seconds, double(width) * height * 1e-6 / seconds);
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,171 @@
+/*
+	Horizon Baking Benchmark and Accuracy Check.
+	For growing height maps: bake time of the fast path (SSE2 + threads, and one thread), the scalar
+	reference on a band of rows, their difference, and the time of an incremental update after an edit.
+	Exits with 1 when the fast path is off by more than one unorm8 step, or the update differs from a full bake.
+
+	Build: g++ -O2 -std=c++17 -pthread -Isrc tools/HorizonBench.cpp -o HorizonBench
+	Usage: HorizonBench [--input height.bmp] [--max 2048] [--directions 16] [--radius 32]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmath>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+#include "HorizonBaker.hpp"
+
+using Clock = std::chrono::high_resolution_clock;
+
+static double SecondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Deterministic fractal value noise, roughly the relief of mountains_height.bmp
+static float Hash(int x, int y, int octave)
+{
+	uint32_t h = uint32_t(x) * 374761393u + uint32_t(y) * 668265263u + uint32_t(octave) * 2246822519u;
+	h = (h ^ (h >> 13)) * 1274126177u;
+	return float(h ^ (h >> 16)) / 4294967295.0f;
+}
+
+static void MakeTerrain(int size, HeightGrid& out)
+{
+	out.Resize(size, size);
+	for (int y = 0; y < size; y++)
+	{
+		for (int x = 0; x < size; x++)
+		{
+			float h = 0.0f, amplitude = 60.0f;
+			float period = float(size) / 4.0f;
+			for (int octave = 0; octave < 6 && period >= 1.0f; octave++)
+			{
+				float fx = float(x) / period, fy = float(y) / period;
+				int ix = (int)fx, iy = (int)fy;
+				float tx = fx - float(ix), ty = fy - float(iy);
+				tx = tx * tx * (3.0f - 2.0f * tx);
+				ty = ty * ty * (3.0f - 2.0f * ty);
+				float top = Hash(ix, iy, octave) + (Hash(ix + 1, iy, octave) - Hash(ix, iy, octave)) * tx;
+				float bottom = Hash(ix, iy + 1, octave) + (Hash(ix + 1, iy + 1, octave) - Hash(ix, iy + 1, octave)) * tx;
+				h += amplitude * (top + (bottom - top) * ty);
+				amplitude *= 0.45f;
+				period *= 0.5f;
+			}
+			out.At(x, y) = h - 40.0f;
+		}
+	}
+}
+
+// Resample to size x size, bilinear
+static void Resample(const HeightGrid& src, int size, HeightGrid& out)
+{
+	out.Resize(size, size);
+	for (int y = 0; y < size; y++)
+		for (int x = 0; x < size; x++)
+			out.At(x, y) = src.Bilinear((float(x) + 0.5f) * src.width / size - 0.5f, (float(y) + 0.5f) * src.height / size - 0.5f);
+}
+
+int main(int argc, char** argv)
+{
+	const char* input = nullptr;
+	int maxSize = 2048;
+	HorizonSettings settings;
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (!strcmp(argv[i], "--input") && hasValue) input = argv[++i];
+		else if (!strcmp(argv[i], "--max") && hasValue) maxSize = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--directions") && hasValue) settings.directions = std::max(atoi(argv[++i]), 1);
+		else if (!strcmp(argv[i], "--radius") && hasValue) settings.radius = std::max(atoi(argv[++i]), 1);
+		else
+		{
+			printf("Usage: HorizonBench [--input height.bmp] [--max 2048] [--directions 16] [--radius 32]\n");
+			return 1;
+		}
+	}
+
+	HeightGrid source;
+	if (input)
+	{
+		HeightmapSource bmp;
+		if (!bmp.Open(input) || !bmp.ReadRegion(0, 0, bmp.GetWidth(), bmp.GetHeight(), source))
+			return 1;
+	}
+
+	printf("%d directions, radius %d, %u workers\n", settings.directions, settings.radius, WorkerCount());
+	printf("%6s %10s %10s %12s %12s %10s %10s %10s\n", "size", "fast ms", "1 thr ms", "ref ms est.", "MTexels/s", "max err", "mean err", "update ms");
+
+	bool passed = true;
+	for (int size = 256; size <= maxSize; size *= 2)
+	{
+		HeightGrid heights;
+		if (input)
+			Resample(source, size, heights);
+		else
+			MakeTerrain(size, heights);
+
+		// Same world size at every resolution, like the renderer
+		settings.spacing = 100.0f / float(size);
+		HorizonMap map(settings);
+		const HorizonKernel& kernel = map.GetKernel();
+
+		auto start = Clock::now();
+		map.Bake(heights);
+		double fastSeconds = SecondsSince(start);
+
+		// Reference and fast path on one thread, on a band of rows in the middle
+		const int band = std::min(size, 32);
+		const int bandY = (size - band) / 2;
+		HeightGrid padded;
+		PadRegion(heights, { 0, bandY, size, bandY + band }, kernel.apron, padded);
+		std::vector<float> fast(size_t(size) * band), reference(size_t(size) * band);
+
+		start = Clock::now();
+		for (int y = 0; y < band; y++)
+			HorizonVisibilityRow(padded, kernel.apron, kernel.apron + y, size, kernel, &fast[size_t(y) * size]);
+		double singleSeconds = SecondsSince(start) * double(size) / double(band);
+
+		start = Clock::now();
+		for (int y = 0; y < band; y++)
+			for (int x = 0; x < size; x++)
+				reference[size_t(y) * size + x] = HorizonVisibility(heights, x, bandY + y, settings.spacing, settings.directions, settings.radius);
+		double referenceSeconds = SecondsSince(start) * double(size) / double(band);
+
+		double maxError = 0.0, sumError = 0.0;
+		for (size_t i = 0; i < fast.size(); i++)
+		{
+			double error = std::fabs(double(fast[i]) - double(reference[i]));
+			maxError = std::max(maxError, error);
+			sumError += error;
+		}
+		if (maxError > 1.0 / 255.0)
+			passed = false;
+
+		// Raise a hill, then check the incremental update against a full bake
+		TexelRect edit = { size / 3, size / 3, size / 3 + 32, size / 3 + 32 };
+		for (int y = edit.y0; y < edit.y1; y++)
+			for (int x = edit.x0; x < edit.x1; x++)
+				heights.At(x, y) += 10.0f;
+		start = Clock::now();
+		map.Update(heights, edit);
+		double updateSeconds = SecondsSince(start);
+
+		HorizonMap full(settings);
+		full.Bake(heights);
+		if (memcmp(full.GetData(), map.GetData(), size_t(size) * size) != 0)
+		{
+			printf("Incremental update differs from a full bake at %d x %d\n", size, size);
+			passed = false;
+		}
+
+		printf("%6d %10.1f %10.1f %12.1f %12.1f %10.6f %10.6f %10.2f\n", size, fastSeconds * 1e3, singleSeconds * 1e3, referenceSeconds * 1e3,
+			double(size) * size * 1e-6 / fastSeconds, maxError, sumError / double(fast.size()), updateSeconds * 1e3);
+	}
+
+	printf(passed ? "PASSED\n" : "FAILED\n");
+	return passed ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,168 @@
+/*
+	Image Comparison with Tolerances.
+	Diffs two 24 bit BMPs of the same size, typically a ReferenceRender frame and a GPU capture
+	(TERRAIN_CAPTURE in main.cpp) of the same camera. A pixel is off when a channel differs by more
+	than the tolerance: tessellation diagonals and texture filtering are not bit exact across GPUs.
+	Prints the error statistics and the worst block, optionally writes a heat map of the differences.
+	Exits with 1 when too many pixels are off, or the mean error is too high.
+
+	Build: g++ -O2 -std=c++17 -Isrc tools/ImageDiff.cpp -o ImageDiff
+	Usage: ImageDiff reference.bmp capture.bmp [--tolerance 8] [--max-bad 1.0] [--max-mean 2.0] [--block 32] [--diff diff.bmp]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "BMPReader.hpp"
+
+// BGR, bottom row first, rows tightly packed
+static bool ReadImage(const char* path, int& width, int& height, std::vector<unsigned char>& out)
+{
+	std::vector<unsigned char> data;
+	if (!readBMP_custom(path, width, height, data))
+		return false;
+
+	// Rows are padded to 4 bytes in the file
+	size_t stride = (size_t(width) * 3 + 3) & ~size_t(3);
+	if (data.size() < stride * height)
+		stride = size_t(width) * 3;
+	if (data.size() < stride * height)
+	{
+		printf("%s is truncated\n", path);
+		return false;
+	}
+
+	out.resize(size_t(width) * height * 3);
+	for (int y = 0; y < height; y++)
+		memcpy(&out[size_t(y) * width * 3], &data[y * stride], size_t(width) * 3);
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	const char* paths[2] = { nullptr, nullptr };
+	const char* diffPath = nullptr;
+	int tolerance = 8;
+	// Percent of the pixels
+	double maxBad = 1.0;
+	double maxMean = 2.0;
+	int block = 32;
+	int inputs = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (!strcmp(argv[i], "--tolerance") && hasValue) tolerance = std::max(atoi(argv[++i]), 0);
+		else if (!strcmp(argv[i], "--max-bad") && hasValue) maxBad = atof(argv[++i]);
+		else if (!strcmp(argv[i], "--max-mean") && hasValue) maxMean = atof(argv[++i]);
+		else if (!strcmp(argv[i], "--block") && hasValue) block = std::max(atoi(argv[++i]), 1);
+		else if (!strcmp(argv[i], "--diff") && hasValue) diffPath = argv[++i];
+		else if (argv[i][0] != '-' && inputs < 2) paths[inputs++] = argv[i];
+		else
+		{
+			inputs = 0;
+			break;
+		}
+	}
+	if (inputs != 2)
+	{
+		printf("Usage: ImageDiff reference.bmp capture.bmp [--tolerance 8] [--max-bad 1.0] [--max-mean 2.0] [--block 32] [--diff diff.bmp]\n");
+		return 1;
+	}
+
+	int width[2], height[2];
+	std::vector<unsigned char> images[2];
+	for (int i = 0; i < 2; i++)
+		if (!ReadImage(paths[i], width[i], height[i], images[i]))
+			return 1;
+	if (width[0] != width[1] || height[0] != height[1])
+	{
+		printf("Sizes differ: %d x %d and %d x %d\n", width[0], height[0], width[1], height[1]);
+		printf("FAILED\n");
+		return 1;
+	}
+	const int w = width[0], h = height[0];
+	const size_t pixels = size_t(w) * h;
+
+	// Per pixel: the largest channel difference
+	std::vector<int> errors(pixels);
+	double sum = 0.0, sumSquares = 0.0;
+	int maxError = 0;
+	size_t bad = 0;
+	int histogram[5] = { 0, 0, 0, 0, 0 };
+	for (size_t p = 0; p < pixels; p++)
+	{
+		int error = 0;
+		for (int c = 0; c < 3; c++)
+		{
+			int d = std::abs(int(images[0][p * 3 + c]) - int(images[1][p * 3 + c]));
+			sum += d;
+			sumSquares += double(d) * d;
+			error = std::max(error, d);
+		}
+		errors[p] = error;
+		maxError = std::max(maxError, error);
+		if (error > tolerance)
+			bad++;
+		histogram[error == 0 ? 0 : error <= 2 ? 1 : error <= 8 ? 2 : error <= 32 ? 3 : 4]++;
+	}
+	const double mean = sum / double(pixels * 3);
+	const double mse = sumSquares / double(pixels * 3);
+	const double psnr = mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : INFINITY;
+	const double badPercent = 100.0 * double(bad) / double(pixels);
+
+	// Worst block: where to look first. y counts from the bottom row, like the files.
+	double worstMean = -1.0;
+	int worstX = 0, worstY = 0;
+	for (int by = 0; by < h; by += block)
+	{
+		for (int bx = 0; bx < w; bx += block)
+		{
+			double blockSum = 0.0;
+			int count = 0;
+			for (int y = by; y < std::min(by + block, h); y++)
+				for (int x = bx; x < std::min(bx + block, w); x++, count++)
+					blockSum += errors[size_t(y) * w + x];
+			if (blockSum / count > worstMean)
+			{
+				worstMean = blockSum / count;
+				worstX = bx;
+				worstY = by;
+			}
+		}
+	}
+
+	printf("%d x %d, tolerance %d\n", w, h, tolerance);
+	printf("%12s %12s %12s %12s %12s\n", "mean error", "max error", "PSNR dB", "off %", "worst block");
+	printf("%12.3f %12d %12.2f %12.3f %5d,%-6d\n", mean, maxError, psnr, badPercent, worstX, worstY);
+	printf("Pixels by largest channel error: 0: %.2f%%, 1-2: %.2f%%, 3-8: %.2f%%, 9-32: %.2f%%, 33+: %.2f%%\n",
+		100.0 * histogram[0] / pixels, 100.0 * histogram[1] / pixels, 100.0 * histogram[2] / pixels, 100.0 * histogram[3] / pixels, 100.0 * histogram[4] / pixels);
+	printf("Worst %d x %d block at (%d, %d): mean error %.2f\n", block, block, worstX, worstY, worstMean);
+
+	// Heat map: the reference in dim grey, the differences in red, full red from the tolerance up
+	if (diffPath)
+	{
+		std::vector<unsigned char> diff(pixels * 3);
+		for (size_t p = 0; p < pixels; p++)
+		{
+			int grey = (int(images[0][p * 3]) + images[0][p * 3 + 1] + images[0][p * 3 + 2]) / 12;
+			int red = errors[p] == 0 ? 0 : std::min(255, 64 + errors[p] * 191 / std::max(tolerance, 1));
+			diff[p * 3 + 0] = (unsigned char)grey;
+			diff[p * 3 + 1] = (unsigned char)grey;
+			diff[p * 3 + 2] = (unsigned char)std::max(grey, red);
+		}
+		if (writeBMP_custom(diffPath, w, h, diff.data()))
+			printf("Written %s\n", diffPath);
+	}
+
+	bool passed = badPercent <= maxBad && mean <= maxMean;
+	if (badPercent > maxBad)
+		printf("%.3f%% of the pixels are off by more than %d, limit %.3f%%\n", badPercent, tolerance, maxBad);
+	if (mean > maxMean)
+		printf("Mean error %.3f over the limit %.3f\n", mean, maxMean);
+	printf(passed ? "PASSED\n" : "FAILED\n");
+	return passed ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,253 @@
+/*
+	Occlusion Culling Benchmark and Conservativeness Check.
+	Cameras in the valleys of a height map look across the terrain. For each one: the raster and
+	pyramid time, the time to test every chunk, and how many chunks inside the frustum are hidden.
+	Every hidden chunk is then checked by marching rays to its surface through the real heights:
+	exits with 1 when a chunk was hidden while a part of it can be seen.
+
+	Build: g++ -O2 -std=c++17 -pthread -Isrc tools/OcclusionBench.cpp -o OcclusionBench
+	Usage: OcclusionBench [--input height.bmp] [--size 512] [--raster 256x128] [--cell 2] [--cameras 16]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmath>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "OcclusionCulling.hpp"
+
+using Clock = std::chrono::high_resolution_clock;
+
+static double SecondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Same grid as main.cpp
+static constexpr int n_points = 200;
+static constexpr float m_scale = 0.5f;
+static constexpr int chunk_patches = 16;
+
+// Deterministic fractal value noise, roughly the relief of mountains_height.bmp
+static float Hash(int x, int y, int octave)
+{
+	uint32_t h = uint32_t(x) * 374761393u + uint32_t(y) * 668265263u + uint32_t(octave) * 2246822519u;
+	h = (h ^ (h >> 13)) * 1274126177u;
+	return float(h ^ (h >> 16)) / 4294967295.0f;
+}
+
+static void MakeTerrain(int size, HeightGrid& out)
+{
+	out.Resize(size, size);
+	for (int y = 0; y < size; y++)
+	{
+		for (int x = 0; x < size; x++)
+		{
+			float h = 0.0f, amplitude = 60.0f;
+			float period = float(size) / 4.0f;
+			for (int octave = 0; octave < 6 && period >= 1.0f; octave++)
+			{
+				float fx = float(x) / period, fy = float(y) / period;
+				int ix = (int)fx, iy = (int)fy;
+				float tx = fx - float(ix), ty = fy - float(iy);
+				tx = tx * tx * (3.0f - 2.0f * tx);
+				ty = ty * ty * (3.0f - 2.0f * ty);
+				float top = Hash(ix, iy, octave) + (Hash(ix + 1, iy, octave) - Hash(ix, iy, octave)) * tx;
+				float bottom = Hash(ix, iy + 1, octave) + (Hash(ix + 1, iy + 1, octave) - Hash(ix, iy + 1, octave)) * tx;
+				h += amplitude * (top + (bottom - top) * ty);
+				amplitude *= 0.45f;
+				period *= 0.5f;
+			}
+			out.At(x, y) = h - 40.0f;
+		}
+	}
+}
+
+struct Box
+{
+	glm::vec3 min, max;
+	TexelRect texels;
+};
+
+// Chunk bounds as BuildPatchChunks and FitChunkBounds make them
+static std::vector<Box> MakeChunks(const HeightGrid& heights, const TerrainMapping& mapping)
+{
+	std::vector<Box> boxes;
+	const int n_patches = n_points - 1;
+	for (int ci = 0; ci < n_patches; ci += chunk_patches)
+	{
+		for (int cj = 0; cj < n_patches; cj += chunk_patches)
+		{
+			Box box;
+			box.min = glm::vec3(m_scale * cj - m_scale * n_points / 2.0f, 0.0f, m_scale * ci - m_scale * n_points / 2.0f);
+			box.max = glm::vec3(m_scale * std::min(cj + chunk_patches, n_patches) - m_scale * n_points / 2.0f, 0.0f,
+				m_scale * std::min(ci + chunk_patches, n_patches) - m_scale * n_points / 2.0f);
+			box.texels = mapping.WorldToTexels(box.min.x, box.min.z, box.max.x, box.max.z).Grown(1).Clipped(heights.width, heights.height);
+			float lo = 1e30f, hi = -1e30f;
+			for (int y = box.texels.y0; y < box.texels.y1; y++)
+				for (int x = box.texels.x0; x < box.texels.x1; x++)
+				{
+					lo = std::min(lo, heights.At(x, y));
+					hi = std::max(hi, heights.At(x, y));
+				}
+			box.min.y = lo;
+			box.max.y = hi;
+			boxes.push_back(box);
+		}
+	}
+	return boxes;
+}
+
+static bool InFrustum(const glm::mat4& vp, const Box& box)
+{
+	for (int plane = 0; plane < 6; plane++)
+	{
+		bool allOutside = true;
+		for (int corner = 0; corner < 8 && allOutside; corner++)
+		{
+			glm::vec4 c = vp * glm::vec4(corner & 1 ? box.max.x : box.min.x, corner & 2 ? box.max.y : box.min.y, corner & 4 ? box.max.z : box.min.z, 1.0f);
+			float d = plane & 1 ? c.w - c[plane / 2] : c.w + c[plane / 2];
+			allOutside = d < 0.0f;
+		}
+		if (allOutside)
+			return false;
+	}
+	return true;
+}
+
+// The terrain between the eye and p never rises above the ray (beyond a small tolerance)
+static bool LineOfSight(const HeightGrid& heights, const TerrainMapping& mapping, const glm::vec3& eye, const glm::vec3& p)
+{
+	const float step = 0.5f * mapping.Spacing();
+	const float length = glm::length(p - eye);
+	// Stop short of the target: its own texels are not in the way
+	for (float t = step; t < length - 2.0f * mapping.Spacing(); t += step)
+	{
+		glm::vec3 q = eye + (p - eye) * (t / length);
+		float ground = heights.Bilinear(mapping.WorldToTexelX(q.x) - 0.5f, mapping.WorldToTexelY(q.z) - 0.5f);
+		if (ground > q.y + 0.05f)
+			return false;
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	const char* input = nullptr;
+	int size = 512;
+	int rasterWidth = 256, rasterHeight = 128;
+	float cell = 2.0f;
+	int cameras = 16;
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (!strcmp(argv[i], "--input") && hasValue) input = argv[++i];
+		else if (!strcmp(argv[i], "--size") && hasValue) size = std::max(atoi(argv[++i]), 16);
+		else if (!strcmp(argv[i], "--raster") && hasValue && sscanf(argv[i + 1], "%dx%d", &rasterWidth, &rasterHeight) == 2) i++;
+		else if (!strcmp(argv[i], "--cell") && hasValue) cell = std::max((float)atof(argv[++i]), 0.25f);
+		else if (!strcmp(argv[i], "--cameras") && hasValue) cameras = std::max(atoi(argv[++i]), 1);
+		else
+		{
+			printf("Usage: OcclusionBench [--input height.bmp] [--size 512] [--raster 256x128] [--cell 2] [--cameras 16]\n");
+			return 1;
+		}
+	}
+
+	HeightGrid heights;
+	if (input)
+	{
+		HeightmapSource bmp;
+		if (!bmp.Open(input) || !bmp.ReadRegion(0, 0, bmp.GetWidth(), bmp.GetHeight(), heights))
+			return 1;
+	}
+	else
+		MakeTerrain(size, heights);
+
+	TerrainMapping mapping(n_points, m_scale, heights.width, heights.height);
+	std::vector<Box> boxes = MakeChunks(heights, mapping);
+	const float x0 = -m_scale * n_points / 2.0f;
+	const float x1 = m_scale * (n_points - 1) - m_scale * n_points / 2.0f;
+
+	OcclusionCuller culler(rasterWidth, rasterHeight, cell);
+	auto start = Clock::now();
+	culler.Build(heights, mapping, x0, x0, x1, x1);
+	double buildSeconds = SecondsSince(start);
+
+	printf("%d x %d heights, %zu chunks, %d occluder triangles built in %.2f ms, %d x %d raster, %u workers\n",
+		heights.width, heights.height, boxes.size(), culler.GetTriangleCount(), buildSeconds * 1e3, rasterWidth, rasterHeight, WorkerCount());
+	printf("%6s %10s %10s %10s %10s %12s\n", "camera", "raster ms", "test us", "in view", "hidden", "false hides");
+
+	bool passed = true;
+	int totalInView = 0, totalHidden = 0;
+	double totalRaster = 0.0;
+	const glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 500.0f);
+	for (int c = 0; c < cameras; c++)
+	{
+		// Just above the ground on a ring around the center, looking across it
+		float angle = 6.2831853f * float(c) / float(cameras);
+		float radius = 15.0f + 25.0f * float(c % 3) / 2.0f;
+		glm::vec3 eye(radius * std::cos(angle), 0.0f, radius * std::sin(angle));
+		eye.y = heights.Bilinear(mapping.WorldToTexelX(eye.x) - 0.5f, mapping.WorldToTexelY(eye.z) - 0.5f) + 2.0f;
+		glm::vec3 target(-eye.x * 0.5f + 10.0f * std::sin(angle * 3.0f), eye.y - 3.0f, -eye.z * 0.5f);
+		const glm::mat4 viewProjection = projection * glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f));
+
+		start = Clock::now();
+		culler.Render(viewProjection);
+		double rasterSeconds = SecondsSince(start);
+
+		std::vector<bool> hidden(boxes.size(), false);
+		std::vector<bool> inView(boxes.size(), false);
+		start = Clock::now();
+		for (size_t b = 0; b < boxes.size(); b++)
+		{
+			inView[b] = InFrustum(viewProjection, boxes[b]);
+			hidden[b] = inView[b] && !culler.IsVisible(boxes[b].min, boxes[b].max);
+		}
+		double testSeconds = SecondsSince(start);
+
+		// Every texel of a hidden chunk that lies in the frustum must be out of sight
+		int inViewCount = 0, hiddenCount = 0, falseHides = 0;
+		for (size_t b = 0; b < boxes.size(); b++)
+		{
+			inViewCount += inView[b] ? 1 : 0;
+			if (!hidden[b])
+				continue;
+			hiddenCount++;
+			bool seen = false;
+			const TexelRect& r = boxes[b].texels;
+			for (int y = r.y0; y < r.y1 && !seen; y++)
+			{
+				for (int x = r.x0; x < r.x1 && !seen; x++)
+				{
+					glm::vec3 p(mapping.TexelToWorldX(x + 0.5f), heights.At(x, y), mapping.TexelToWorldZ(y + 0.5f));
+					if (p.x < boxes[b].min.x || p.x > boxes[b].max.x || p.z < boxes[b].min.z || p.z > boxes[b].max.z)
+						continue;
+					glm::vec4 clip = viewProjection * glm::vec4(p, 1.0f);
+					if (clip.w <= 0.0f || std::abs(clip.x) > clip.w || std::abs(clip.y) > clip.w)
+						continue;
+					seen = LineOfSight(heights, mapping, eye, p);
+				}
+			}
+			if (seen)
+				falseHides++;
+		}
+		if (falseHides > 0)
+			passed = false;
+
+		totalInView += inViewCount;
+		totalHidden += hiddenCount;
+		totalRaster += rasterSeconds;
+		printf("%6d %10.3f %10.1f %10d %10d %12d\n", c, rasterSeconds * 1e3, testSeconds * 1e6, inViewCount, hiddenCount, falseHides);
+	}
+
+	printf("Hidden: %d of %d chunks in view (%.1f%%), raster %.3f ms on average\n", totalHidden, totalInView,
+		100.0 * totalHidden / std::max(totalInView, 1), totalRaster * 1e3 / cameras);
+	printf(passed ? "PASSED\n" : "FAILED\n");
+	return passed ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,136 @@
+/*
+	CPU Reference Frame of the Terrain.
+	Loads the same height map and materials as the renderer, bakes the same horizon occlusion, and renders
+	one frame on all cores with ReferenceRenderer.hpp. No GPU needed: CI renders this and diffs it against
+	a GPU capture of the same camera (TERRAIN_CAPTURE in main.cpp) with ImageDiff.
+	The frame is rendered twice and compared byte for byte: exits with 1 when the two differ.
+
+	Build: g++ -O2 -std=c++17 -pthread -Isrc tools/ReferenceRender.cpp -o ReferenceRender
+	Usage: ReferenceRender [--output reference.bmp] [--camera x,y,z,tx,ty,tz] [--size 1920x1080] [--dir assets/]
+	       [--uncompressed] [--no-ao] [--tile 32] [--runs 2]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include "ReferenceRenderer.hpp"
+
+using Clock = std::chrono::high_resolution_clock;
+
+static double MillisecondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Diffuse and specular of a layer, as main.cpp uploads them: BC1 and BC4, or RGB with mips
+static bool LoadLayer(const std::string& dir, const char* name, bool compressed, ReferenceTexture& diffuse, ReferenceTexture& specular)
+{
+	const std::string diffusePath = dir + name + ".bmp";
+	const std::string specularPath = dir + name + "-s.bmp";
+	if (compressed)
+	{
+		BakedTexture baked;
+		if (!BakeTexture(diffusePath.c_str(), BlockFormat::BC1, baked))
+			return false;
+		diffuse.FromBaked(baked);
+		if (!BakeTexture(specularPath.c_str(), BlockFormat::BC4, baked))
+			return false;
+		specular.FromBaked(baked);
+		return true;
+	}
+
+	Image image;
+	if (!LoadBMPImage(diffusePath.c_str(), BlockFormat::BC1, image))
+		return false;
+	diffuse.FromImage(image);
+	if (!LoadBMPImage(specularPath.c_str(), BlockFormat::BC1, image))
+		return false;
+	specular.FromImage(image);
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	const char* output = "reference.bmp";
+	std::string dir;
+	ReferenceCamera camera;
+	ReferenceSettings settings;
+	bool compressed = true;
+	int runs = 2;
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (!strcmp(argv[i], "--output") && hasValue) output = argv[++i];
+		else if (!strcmp(argv[i], "--camera") && hasValue && camera.Parse(argv[i + 1])) i++;
+		else if (!strcmp(argv[i], "--size") && hasValue && camera.ParseSize(argv[i + 1])) i++;
+		else if (!strcmp(argv[i], "--dir") && hasValue) dir = argv[++i];
+		else if (!strcmp(argv[i], "--uncompressed")) compressed = false;
+		else if (!strcmp(argv[i], "--no-ao")) settings.ambientOcclusion = false;
+		else if (!strcmp(argv[i], "--tile") && hasValue) settings.tileSize = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--runs") && hasValue) runs = std::max(atoi(argv[++i]), 1);
+		else
+		{
+			printf("Usage: ReferenceRender [--output reference.bmp] [--camera x,y,z,tx,ty,tz] [--size 1920x1080] [--dir assets/]\n"
+				"       [--uncompressed] [--no-ao] [--tile 32] [--runs 2]\n");
+			return 1;
+		}
+	}
+	if (!dir.empty() && dir.back() != '/' && dir.back() != '\\')
+		dir += '/';
+
+	// Inputs, as RunTerrain loads them
+	auto start = Clock::now();
+	HeightGrid heights;
+	HeightmapSource source;
+	const std::string heightPath = dir + "mountains_height.bmp";
+	if (!source.Open(heightPath.c_str()) || !source.ReadRegion(0, 0, source.GetWidth(), source.GetHeight(), heights))
+		return 1;
+
+	TerrainMapping mapping(settings.points, settings.scale, heights.width, heights.height);
+	HorizonSettings horizonSettings;
+	horizonSettings.spacing = mapping.Spacing();
+	HorizonMap horizon(horizonSettings);
+	horizon.Bake(heights);
+
+	ReferenceRenderer renderer(settings);
+	renderer.SetHeights(heights);
+	renderer.SetHorizon(&horizon);
+	static const char* layer_names[int(ReferenceLayer::Count)] = { "grass", "rocks", "snow" };
+	for (int layer = 0; layer < int(ReferenceLayer::Count); layer++)
+		if (!LoadLayer(dir, layer_names[layer], compressed, renderer.GetDiffuse(ReferenceLayer(layer)), renderer.GetSpecular(ReferenceLayer(layer))))
+			return 1;
+	printf("Inputs: %d x %d height map, %s materials, loaded and baked in %.1f ms\n", heights.width, heights.height,
+		compressed ? "BC1/BC4" : "RGB8", MillisecondsSince(start));
+
+	printf("Camera (%.2f, %.2f, %.2f) -> (%.2f, %.2f, %.2f), %d x %d, %u workers\n", camera.position.x, camera.position.y, camera.position.z,
+		camera.target.x, camera.target.y, camera.target.z, camera.width, camera.height, WorkerCount());
+	printf("%4s %10s %10s %10s %10s %12s %10s %10s\n", "run", "vertex ms", "bin ms", "raster ms", "total ms", "vertices", "patches", "covered %");
+
+	std::vector<unsigned char> first, frame;
+	bool passed = true;
+	for (int run = 0; run < runs; run++)
+	{
+		if (!renderer.Render(camera, run == 0 ? first : frame))
+			return 1;
+		const ReferenceStats& stats = renderer.GetStats();
+		printf("%4d %10.1f %10.1f %10.1f %10.1f %12zu %10zu %10.2f\n", run, stats.vertexMs, stats.binMs, stats.rasterMs,
+			stats.vertexMs + stats.binMs + stats.rasterMs, stats.vertices, stats.binnedPatches,
+			100.0 * double(stats.coveredPixels) / (double(camera.width) * camera.height));
+		if (run > 0 && frame != first)
+		{
+			printf("Run %d differs from run 0\n", run);
+			passed = false;
+		}
+	}
+
+	if (!writeBMP_custom(output, camera.width, camera.height, first.data()))
+		return 1;
+	printf("Written %s\n", output);
+
+	printf(passed ? "PASSED\n" : "FAILED\n");
+	return passed ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,198 @@
+/*
+	Block Compression Benchmark and Quality Check.
+	Encodes a color image to BC1, a one channel image to BC4 and a normal map to BC5 with TextureCompressor.hpp,
+	from generated images (or the channels of a BMP), whole mip chains on one thread up to every core.
+	Prints the PSNR of the base level and of the worst level, and MPixels/s per format and thread count.
+	Exits with 1 when a PSNR is under the threshold of its format, or the blocks change with the thread count.
+
+	Build: g++ -O2 -std=c++17 -pthread -Isrc tools/TextureBench.cpp -o TextureBench
+	Usage: TextureBench [--input texture.bmp] [--size 1024] [--runs 3]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmath>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+
+#include "TextureBaker.hpp"
+
+using Clock = std::chrono::high_resolution_clock;
+
+static double SecondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static float Hash(int x, int y, int octave)
+{
+	uint32_t h = uint32_t(x) * 374761393u + uint32_t(y) * 668265263u + uint32_t(octave) * 2246822519u;
+	h = (h ^ (h >> 13)) * 1274126177u;
+	return float(h ^ (h >> 16)) / 4294967295.0f;
+}
+
+// Fractal value noise in [0, 1], tiling like a material: wide patches, then finer and finer detail
+static float Noise(int x, int y, int size, int seed)
+{
+	float value = 0.0f, amplitude = 0.5f;
+	float period = float(size) / 8.0f;
+	for (int octave = 0; octave < 7 && period >= 1.0f; octave++)
+	{
+		float fx = float(x) / period, fy = float(y) / period;
+		int ix = (int)fx, iy = (int)fy;
+		float tx = fx - float(ix), ty = fy - float(iy);
+		tx = tx * tx * (3.0f - 2.0f * tx);
+		ty = ty * ty * (3.0f - 2.0f * ty);
+		int o = octave + seed * 16;
+		float top = Hash(ix, iy, o) + (Hash(ix + 1, iy, o) - Hash(ix, iy, o)) * tx;
+		float bottom = Hash(ix, iy + 1, o) + (Hash(ix + 1, iy + 1, o) - Hash(ix, iy + 1, o)) * tx;
+		value += amplitude * (top + (bottom - top) * ty);
+		amplitude *= 0.5f;
+		period *= 0.5f;
+	}
+	return std::min(std::max(value, 0.0f), 1.0f);
+}
+
+// What the terrain materials look like: BC1 a grass and earth color map, BC4 a specular mask,
+// BC5 the X and Y of the normals of a bumpy height
+static Image MakeImage(BlockFormat format, int size)
+{
+	Image image;
+	image.width = size;
+	image.height = size;
+	image.channels = BlockChannels(format);
+	image.pixels.resize(size_t(size) * size * image.channels);
+	std::vector<float> height;
+	if (format == BlockFormat::BC5)
+	{
+		height.resize(size_t(size) * size);
+		for (int y = 0; y < size; y++)
+			for (int x = 0; x < size; x++)
+				height[size_t(y) * size + x] = Noise(x, y, size, 2);
+	}
+
+	for (int y = 0; y < size; y++)
+	{
+		for (int x = 0; x < size; x++)
+		{
+			unsigned char* out = &image.pixels[(size_t(y) * size + x) * image.channels];
+			if (format == BlockFormat::BC1)
+			{
+				float mix = Noise(x, y, size, 0), detail = Noise(x, y, size, 1);
+				const float grass[3] = { 70.0f, 120.0f, 40.0f }, earth[3] = { 120.0f, 95.0f, 60.0f };
+				for (int c = 0; c < 3; c++)
+					out[c] = (unsigned char)std::min(255.0f, (grass[c] + (earth[c] - grass[c]) * mix) * (0.6f + 0.8f * detail));
+			}
+			else if (format == BlockFormat::BC4)
+				out[0] = (unsigned char)(255.0f * Noise(x, y, size, 3));
+			else
+			{
+				float dx = height[size_t(y) * size + (x + 1) % size] - height[size_t(y) * size + (x + size - 1) % size];
+				float dy = height[size_t((y + 1) % size) * size + x] - height[size_t((y + size - 1) % size) * size + x];
+				// Same slopes at every size
+				float nx = -dx * float(size) / 64.0f, ny = -dy * float(size) / 64.0f;
+				float length = std::sqrt(nx * nx + ny * ny + 1.0f);
+				out[0] = (unsigned char)std::lround(127.5f + 127.5f * nx / length);
+				out[1] = (unsigned char)std::lround(127.5f + 127.5f * ny / length);
+			}
+		}
+	}
+	return image;
+}
+
+int main(int argc, char** argv)
+{
+	const char* input = nullptr;
+	int size = 1024;
+	int runs = 3;
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (!strcmp(argv[i], "--input") && hasValue) input = argv[++i];
+		else if (!strcmp(argv[i], "--size") && hasValue) size = std::max(atoi(argv[++i]), 4);
+		else if (!strcmp(argv[i], "--runs") && hasValue) runs = std::max(atoi(argv[++i]), 1);
+		else
+		{
+			printf("Usage: TextureBench [--input texture.bmp] [--size 1024] [--runs 3]\n");
+			return 1;
+		}
+	}
+
+	// 1, 2, 4... threads, then every core
+	std::vector<unsigned int> threadCounts;
+	for (unsigned int t = 1; t < WorkerCount(); t *= 2)
+		threadCounts.push_back(t);
+	threadCounts.push_back(WorkerCount());
+
+	// Lowest PSNR of the base level that passes: low enough for real photographs, far above a broken encoder
+	const BlockFormat formats[3] = { BlockFormat::BC1, BlockFormat::BC4, BlockFormat::BC5 };
+	const double minPSNR[3] = { 32.0, 40.0, 40.0 };
+
+	printf("%u workers, best of %d runs\n", WorkerCount(), runs);
+	printf("%6s %12s %8s %10s %10s %10s %12s\n", "format", "size", "threads", "ms", "MPixels/s", "PSNR dB", "worst mip dB");
+
+	bool passed = true;
+	for (int f = 0; f < 3; f++)
+	{
+		const BlockFormat format = formats[f];
+		Image base;
+		if (input)
+		{
+			if (!LoadBMPImage(input, format, base))
+				return 1;
+		}
+		else
+			base = MakeImage(format, size);
+
+		// The mips are built once, only the encoding is timed
+		const std::vector<Image> chain = BuildMipChain(base);
+		size_t pixels = 0;
+		for (const Image& mip : chain)
+			pixels += size_t(mip.width) * mip.height;
+
+		std::vector<CompressedLevel> first;
+		for (unsigned int threads : threadCounts)
+		{
+			std::vector<CompressedLevel> levels;
+			double best = 1e30;
+			for (int run = 0; run < runs; run++)
+			{
+				levels.clear();
+				auto start = Clock::now();
+				for (const Image& mip : chain)
+					levels.push_back(CompressImage(mip, format, threads));
+				best = std::min(best, SecondsSince(start));
+			}
+
+			// Rows of blocks are independent: the thread count must not change a byte
+			if (first.empty())
+				first = levels;
+			for (size_t l = 0; l < levels.size(); l++)
+			{
+				if (levels[l].blocks != first[l].blocks)
+				{
+					printf("BC%d level %zu: %u threads encode other blocks than one\n", int(format), l, threads);
+					passed = false;
+					break;
+				}
+			}
+
+			// Mips under a block are mostly padding
+			const double psnr = ComputePSNR(chain[0], levels[0], format);
+			double worst = psnr;
+			for (size_t l = 1; l < levels.size() && chain[l].width >= 4 && chain[l].height >= 4; l++)
+				worst = std::min(worst, ComputePSNR(chain[l], levels[l], format));
+			printf("   BC%d %5d x %-5d %8u %10.2f %10.1f %10.2f %12.2f\n", int(format), base.width, base.height, threads,
+				best * 1e3, double(pixels) / (best * 1e6), psnr, worst);
+			if (psnr < minPSNR[f])
+				passed = false;
+		}
+		printf("BC%d: PSNR limit %.1f dB\n", int(format), minPSNR[f]);
+	}
+
+	printf(passed ? "PASSED\n" : "FAILED\n");
+	return passed ? 0 : 1;
+}
\ No newline at end of file